@@ -1,99 +1,584 @@
 /**
  * @file mqtt_pub.c
- * @brief Simple MQTT publish example using Eclipse Paho (Synchronous)
+ * @brief MQTT publish/subscribe load generator using Eclipse Paho (Synchronous)
  *
  * This program:
- * 1. Connects to a public broker.
- * 2. Publishes a message to a topic.
- * 3. Disconnects.
+ * 1. Connects N publisher clients, one thread each, and M subscriber clients
+ *    that subscribe to every topic the publishers use.
+ * 2. Publishes at a fixed rate per publisher (or as fast as the broker takes
+ *    the messages) for a fixed time, spreading the messages over a number of
+ *    topics per publisher.
+ * 3. Reports the publish rate, the broker acknowledgement latency (QoS 1/2),
+ *    and the messages delivered to the subscribers with their end-to-end
+ *    latency percentiles, lost and out-of-order messages.
  *
- * Compile with: gcc mqtt_pub.c -o mqtt_pub -lpaho-mqtt3c
+ * Every payload starts with the publisher, a sequence number and the send
+ * time, padded to the requested size:
+ *
+ *   {"pub":3,"seq":1234,"ts_ns":1760812345123456789,"pad":"xxxx..."}
+ *
+ * ts_ns is CLOCK_REALTIME, so a subscriber on another host with a
+ * synchronized clock can compute the latency too (e.g. mosquitto_sub -t
+ * 'bench/#' piped to a script).
+ *
+ * Usage:
+ *   $ ./mqtt_pub [-b broker] [-c publishers] [-S subscribers] [-r rate]
+ *                [-q qos] [-s payload_bytes] [-t topics] [-T prefix]
+ *                [-d seconds] [-w max_inflight]
+ *   Defaults: tcp://localhost:1883, 1 publisher at 10 msg/s, 1 subscriber,
+ *             QoS 1, 128 bytes, 1 topic, prefix "bench", 10 s, 64 in flight.
+ *
+ * Compile with: gcc -O2 mqtt_pub.c -o mqtt_pub -lpaho-mqtt3c -lpthread
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 #include "MQTTClient.h" // Header principal de Paho
 
 // ==== Configuration ====
-// We use a public broker for testing.
-// Change this to your local broker IP if you have one (e.g. "tcp://localhost:1883")
-#define ADDRESS "tcp://192.168.1.110:1883"
-#define CLIENTID "MiClienteRadxa_001" // Must be unique in the broker
-#define TOPIC "vdf/telemetry/current"
-#define QOS 1
-#define TIMEOUT 10000L
+#define DEFAULT_ADDRESS "tcp://localhost:1883"
+#define CLIENTID_PREFIX "MiClienteRadxa" // Client ids get a role, an index and the PID appended
+#define MAX_CLIENTS 256
+#define MIN_PAYLOAD 64                  // Room for the header and the "pad" field
+#define MAX_PAYLOAD (256 * 1024)
+#define DRAIN_MS 2000                   // Wait this long without progress for the last acks and deliveries
+#define TOKEN_SLOTS 65536               // Paho tokens are MQTT packet ids, 1..65535
 
-int main(int argc, char *argv[])
+typedef struct
+{
+    uint32_t *lat_us;
+    size_t n;
+    size_t cap;
+} samples_t;
+
+typedef struct
 {
-    // 1. Define client structures
+    int index;
+    pthread_t thread;
     MQTTClient client;
+    bool connected;
+    volatile bool lost;         // Set by the connection-lost callback
+    pthread_mutex_t lock;       // Orders a publish before the callback of its acknowledgement
+    unsigned long sent;         // Updated with __atomic builtins, read by the progress line
+    unsigned long failed;
+    unsigned long stalls;       // Publishes refused because max_inflight messages were unacknowledged
+    unsigned long acked;
+    int64_t *sent_ns;           // Send time by token, for the acknowledgement latency
+    samples_t acks;
+} publisher_t;
+
+typedef struct
+{
+    int index;
+    MQTTClient client;
+    bool connected;
+    volatile bool lost;
+    unsigned long received;
+    unsigned long reordered;    // Sequence number not above the last one from that publisher
+    unsigned long foreign;      // Payloads without our header
+    long *last_seq;             // By publisher
+    samples_t e2e;
+} subscriber_t;
+
+static const char *address = DEFAULT_ADDRESS;
+static const char *prefix = "bench";
+static int n_pubs = 1;
+static int n_subs = 1;
+static double rate = 10;
+static int qos = 1;
+static int payload_len = 128;
+static int n_topics = 1;
+static int seconds = 10;
+static int max_inflight = 64;
+
+static pthread_barrier_t start_barrier;
+static int64_t start_ns;
+static int64_t deadline_ns;
+
+static int64_t now_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_until(int64_t ns)
+{
+    struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        continue;
+}
+
+static void record(samples_t *s, int64_t lat_ns)
+{
+    if (s->n == s->cap)
+    {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint32_t *p = realloc(s->lat_us, cap * sizeof(*p));
+        if (p == NULL)
+            return;
+        s->lat_us = p;
+        s->cap = cap;
+    }
+    s->lat_us[s->n++] = lat_ns > 0 ? (uint32_t)(lat_ns / 1000) : 0;
+}
+
+static unsigned long load(const unsigned long *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static void bump(unsigned long *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// ==== Callbacks (run on the Paho client threads) ====
+
+static void pub_lost(void *context, char *cause)
+{
+    publisher_t *p = (publisher_t *)context;
+    (void)cause;
+    p->lost = true;
+}
+
+static void sub_lost(void *context, char *cause)
+{
+    subscriber_t *s = (subscriber_t *)context;
+    (void)cause;
+    s->lost = true;
+}
+
+static int pub_arrived(void *context, char *topicName, int topicLen, MQTTClient_message *message)
+{
+    // Publishers subscribe to nothing
+    (void)context;
+    (void)topicLen;
+    MQTTClient_freeMessage(&message);
+    MQTTClient_free(topicName);
+    return 1;
+}
+
+static void pub_delivered(void *context, MQTTClient_deliveryToken dt)
+{
+    publisher_t *p = (publisher_t *)context;
+    int64_t now = now_ns(CLOCK_MONOTONIC);
+
+    pthread_mutex_lock(&p->lock);
+    record(&p->acks, now - p->sent_ns[dt % TOKEN_SLOTS]);
+    pthread_mutex_unlock(&p->lock);
+    bump(&p->acked);
+}
+
+static int sub_arrived(void *context, char *topicName, int topicLen, MQTTClient_message *message)
+{
+    subscriber_t *s = (subscriber_t *)context;
+    int64_t now = now_ns(CLOCK_REALTIME);
+    char head[96];
+    int len = message->payloadlen < (int)sizeof(head) - 1 ? message->payloadlen : (int)sizeof(head) - 1;
+    int pub;
+    long seq;
+    int64_t ts;
+
+    (void)topicLen;
+    memcpy(head, message->payload, len);
+    head[len] = '\0';
+
+    if (sscanf(head, "{\"pub\":%d,\"seq\":%ld,\"ts_ns\":%" SCNd64, &pub, &seq, &ts) == 3 && pub >= 0 && pub < n_pubs)
+    {
+        record(&s->e2e, now - ts);
+        if (seq <= s->last_seq[pub])
+            s->reordered++;
+        else
+            s->last_seq[pub] = seq;
+        bump(&s->received);
+    }
+    else
+    {
+        s->foreign++;
+    }
+
+    MQTTClient_freeMessage(&message);
+    MQTTClient_free(topicName);
+    return 1;
+}
+
+// ==== Clients ====
+
+static int connect_client(MQTTClient *client, const char *role, int index, void *context,
+                          MQTTClient_connectionLost *cl, MQTTClient_messageArrived *ma,
+                          MQTTClient_deliveryComplete *dc)
+{
     MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
-    MQTTClient_message pubmsg = MQTTClient_message_initializer;
-    MQTTClient_deliveryToken token;
+    char client_id[64];
     int rc;
 
-    // 2. Create the client instance (but does not connect to the network yet)
+    snprintf(client_id, sizeof(client_id), "%s_%s%d_%d", CLIENTID_PREFIX, role, index, (int)getpid());
+
     // MQTTCLIENT_PERSISTENCE_NONE means if the program crashes, it does not save messages to disk.
-    if ((rc = MQTTClient_create(&client, ADDRESS, CLIENTID,
-                                MQTTCLIENT_PERSISTENCE_NONE, NULL)) != MQTTCLIENT_SUCCESS)
+    if ((rc = MQTTClient_create(client, address, client_id, MQTTCLIENT_PERSISTENCE_NONE, NULL)) != MQTTCLIENT_SUCCESS)
     {
-        printf("Error creating client, code: %d\n", rc);
-        return EXIT_FAILURE;
+        printf("Error creating client %s, code: %d\n", client_id, rc);
+        return -1;
     }
 
-    // 3. Set connection options
+    // With callbacks set, publish does not wait for the acknowledgement and
+    // messages arrive on the Paho thread of each client
+    MQTTClient_setCallbacks(*client, context, cl, ma, dc);
+
     conn_opts.keepAliveInterval = 20;
     conn_opts.cleansession = 1; // 1 = Clean previous session when connecting
+    conn_opts.maxInflightMessages = max_inflight;
 
-    // 4. Connect to the Broker
-    printf("Connecting to broker %s...\n", ADDRESS);
-    if ((rc = MQTTClient_connect(client, &conn_opts)) != MQTTCLIENT_SUCCESS)
+    if ((rc = MQTTClient_connect(*client, &conn_opts)) != MQTTCLIENT_SUCCESS)
     {
-        printf("Failed to connect, return code: %d\n", rc);
-        return EXIT_FAILURE;
+        printf("Client %s failed to connect to %s, return code: %d\n", client_id, address, rc);
+        MQTTClient_destroy(client);
+        return -1;
     }
-    printf("Connected!\n");
+    return 0;
+}
 
-    // 5. Prepare the message (Payload)
-    // Here you could send a JSON: "{\"freq\": 60.0, \"amp\": 5.5}"
-    // char payload[] = "Hello from C on Linux!";
-    char payload[] = "{\"current\": 60.0, \"voltage\": 230.0}";
+static void *publisher_main(void *arg)
+{
+    publisher_t *p = (publisher_t *)arg;
+    char *payload = malloc(payload_len + 1);
+    char topic[128];
+    int64_t period_ns = rate > 0 ? (int64_t)(1e9 / rate) : 0;
 
-    pubmsg.payload = payload;
-    pubmsg.payloadlen = (int)strlen(payload);
-    pubmsg.qos = QOS;
-    pubmsg.retained = 1; // 1 = Retain message in the broker
+    pthread_barrier_wait(&start_barrier);   // Every client is connected
+    pthread_barrier_wait(&start_barrier);   // The start time is set
+    if (!p->connected || payload == NULL)
+    {
+        free(payload);
+        return NULL;
+    }
 
-    // 6. Publish
-    printf("Publishing to topic: %s\n", TOPIC);
-    // This function is asynchronous for sending, it gives us a token to track it
-    if ((rc = MQTTClient_publishMessage(client, TOPIC, &pubmsg, &token)) != MQTTCLIENT_SUCCESS)
+    for (long seq = 0; !p->lost; seq++)
     {
-        printf("Failed to start publishing, code: %d\n", rc);
+        if (period_ns > 0)
+            sleep_until(start_ns + seq * period_ns);
+        if (now_ns(CLOCK_MONOTONIC) >= deadline_ns)
+            break;
+
+        snprintf(topic, sizeof(topic), "%s/%d/%ld", prefix, p->index, seq % n_topics);
+        int len = snprintf(payload, payload_len + 1, "{\"pub\":%d,\"seq\":%ld,\"ts_ns\":%" PRId64 ",\"pad\":\"",
+                           p->index, seq, now_ns(CLOCK_REALTIME));
+        memset(payload + len, 'x', payload_len - len - 2);
+        memcpy(payload + payload_len - 2, "\"}", 2);
+
+        int rc;
+        for (;;)
+        {
+            // The token is only known once published, and the acknowledgement can arrive before
+            // this thread runs again: hold the lock until the send time is stored
+            MQTTClient_deliveryToken token;
+            pthread_mutex_lock(&p->lock);
+            int64_t t0 = now_ns(CLOCK_MONOTONIC);
+            rc = MQTTClient_publish(p->client, topic, payload_len, payload, qos, 0, &token);
+            if (rc == MQTTCLIENT_SUCCESS && qos > 0)
+                p->sent_ns[token % TOKEN_SLOTS] = t0;
+            pthread_mutex_unlock(&p->lock);
+
+            if (rc != MQTTCLIENT_MAX_MESSAGES_INFLIGHT || p->lost)
+                break;
+            // The broker is behind: wait for acknowledgements instead of queueing more
+            p->stalls++;
+            usleep(100);
+        }
+
+        if (rc == MQTTCLIENT_SUCCESS)
+            bump(&p->sent);
+        else
+            p->failed++;
+    }
+
+    free(payload);
+    return NULL;
+}
+
+// ==== Report ====
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double q)
+{
+    return n == 0 ? 0 : sorted[(size_t)(q * (double)(n - 1))];
+}
+
+static void print_row(const char *name, samples_t *all, int n, unsigned long count, double elapsed)
+{
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+        total += all[i].n;
+
+    uint32_t *lat = malloc((total ? total : 1) * sizeof(uint32_t));
+    if (lat == NULL)
+        return;
+    size_t k = 0;
+    for (int i = 0; i < n; i++)
+    {
+        memcpy(lat + k, all[i].lat_us, all[i].n * sizeof(uint32_t));
+        k += all[i].n;
+    }
+    qsort(lat, total, sizeof(uint32_t), cmp_u32);
+
+    printf("%-9s %10lu %10.1f %8.2f", name, count, count / elapsed, count * (double)payload_len / elapsed / 1e6);
+    if (total > 0)
+        printf(" %8u %8u %8u %8u %8u\n", percentile(lat, total, 0.50), percentile(lat, total, 0.90),
+               percentile(lat, total, 0.99), percentile(lat, total, 0.999), lat[total - 1]);
+    else
+        printf(" %8s %8s %8s %8s %8s\n", "-", "-", "-", "-", "-");
+    free(lat);
+}
+
+static unsigned long total_sent(const publisher_t *pubs)
+{
+    unsigned long n = 0;
+    for (int i = 0; i < n_pubs; i++)
+        n += load(&pubs[i].sent);
+    return n;
+}
+
+static unsigned long total_acked(const publisher_t *pubs)
+{
+    unsigned long n = 0;
+    for (int i = 0; i < n_pubs; i++)
+        n += load(&pubs[i].acked);
+    return n;
+}
+
+static unsigned long total_received(const subscriber_t *subs)
+{
+    unsigned long n = 0;
+    for (int i = 0; i < n_subs; i++)
+        n += load(&subs[i].received);
+    return n;
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-b broker] [-c publishers] [-S subscribers] [-r rate] [-q qos]\n"
+           "       [-s payload_bytes] [-t topics] [-T prefix] [-d seconds] [-w max_inflight]\n"
+           "  -r  messages/s per publisher, 0 = as fast as the broker takes them\n"
+           "  -s  %d to %d bytes\n"
+           "  -t  topics per publisher: PREFIX/<publisher>/<0..topics-1>; subscribers take PREFIX/#\n",
+           prog, MIN_PAYLOAD, MAX_PAYLOAD);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:c:S:r:q:s:t:T:d:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': address = optarg; break;
+        case 'c': n_pubs = atoi(optarg); break;
+        case 'S': n_subs = atoi(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 'q': qos = atoi(optarg); break;
+        case 's': payload_len = atoi(optarg); break;
+        case 't': n_topics = atoi(optarg); break;
+        case 'T': prefix = optarg; break;
+        case 'd': seconds = atoi(optarg); break;
+        case 'w': max_inflight = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc || n_pubs < 1 || n_pubs > MAX_CLIENTS || n_subs < 0 || n_subs > MAX_CLIENTS ||
+        rate < 0 || qos < 0 || qos > 2 || payload_len < MIN_PAYLOAD || payload_len > MAX_PAYLOAD ||
+        n_topics < 1 || seconds < 1 || max_inflight < 1 || max_inflight >= TOKEN_SLOTS)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    publisher_t *pubs = calloc(n_pubs, sizeof(publisher_t));
+    subscriber_t *subs = calloc(n_subs ? n_subs : 1, sizeof(subscriber_t));
+    if (pubs == NULL || subs == NULL)
+    {
+        printf("Out of memory\n");
+        return EXIT_FAILURE;
     }
 
-    // 7. Wait for confirmation (ACK) from the broker
-    // We block the program until the message is delivered or TIMEOUT occurs
-    printf("Waiting for delivery confirmation...\n");
-    rc = MQTTClient_waitForCompletion(client, token, TIMEOUT);
+    // 1. Subscribers first, so they see the first message
+    char filter[128];
+    snprintf(filter, sizeof(filter), "%s/#", prefix);
+    int n_ready = 0;
+    for (int i = 0; i < n_subs; i++)
+    {
+        subscriber_t *s = &subs[i];
+        s->index = i;
+        s->last_seq = malloc(n_pubs * sizeof(long));
+        if (s->last_seq == NULL)
+            continue;
+        for (int k = 0; k < n_pubs; k++)
+            s->last_seq[k] = -1;
+        if (connect_client(&s->client, "sub", i, s, sub_lost, sub_arrived, NULL) == -1)
+            continue;
+        s->connected = true;
+        int rc = MQTTClient_subscribe(s->client, filter, qos);
+        if (rc != MQTTCLIENT_SUCCESS)
+            printf("Subscriber %d failed to subscribe to %s, code: %d\n", i, filter, rc);
+        else
+            n_ready++;
+    }
 
-    if (rc == MQTTCLIENT_SUCCESS)
+    // 2. Publishers, one thread each; the clock starts once every client is connected
+    pthread_barrier_init(&start_barrier, NULL, (unsigned int)n_pubs + 1);
+    for (int i = 0; i < n_pubs; i++)
     {
-        printf("Message delivered with token %d\n", token);
+        publisher_t *p = &pubs[i];
+        p->index = i;
+        pthread_mutex_init(&p->lock, NULL);
+        p->sent_ns = calloc(TOKEN_SLOTS, sizeof(int64_t));
+        if (p->sent_ns != NULL && connect_client(&p->client, "pub", i, p, pub_lost, pub_arrived, pub_delivered) == 0)
+            p->connected = true;
+        if (pthread_create(&p->thread, NULL, publisher_main, p) != 0)
+        {
+            printf("Cannot start publisher thread %d\n", i);
+            return EXIT_FAILURE;
+        }
     }
+    int n_pub_ready = 0;
+    for (int i = 0; i < n_pubs; i++)
+        n_pub_ready += pubs[i].connected;
+
+    printf("Broker %s: %d of %d publisher(s), %d of %d subscriber(s) to %s\n",
+           address, n_pub_ready, n_pubs, n_ready, n_subs, filter);
+    if (rate > 0)
+        printf("%.1f msg/s per publisher (%.1f total)", rate, rate * n_pub_ready);
     else
+        printf("Unpaced");
+    printf(", QoS %d, %d-byte payload, %d topic(s) per publisher, %d s\n\n", qos, payload_len, n_topics, seconds);
+
+    pthread_barrier_wait(&start_barrier);
+    start_ns = now_ns(CLOCK_MONOTONIC);
+    deadline_ns = start_ns + (int64_t)seconds * 1000000000;
+    pthread_barrier_wait(&start_barrier);
+
+    // 3. One progress line per second while the publishers run
+    unsigned long last_sent = 0, last_recv = 0;
+    for (int t = 1; t <= seconds; t++)
+    {
+        sleep_until(start_ns + (int64_t)t * 1000000000);
+        unsigned long sent = total_sent(pubs), recv = total_received(subs);
+        printf("%4d s  published %8lu msg/s  delivered %8lu msg/s", t, sent - last_sent, recv - last_recv);
+        if (qos > 0)
+            printf("  unacknowledged %6lu", sent - total_acked(pubs));
+        printf("\n");
+        fflush(stdout);
+        last_sent = sent;
+        last_recv = recv;
+    }
+    for (int i = 0; i < n_pubs; i++)
+        pthread_join(pubs[i].thread, NULL);
+    double elapsed = (now_ns(CLOCK_MONOTONIC) - start_ns) / 1e9;
+
+    // 4. Drain: wait for the last acknowledgements and deliveries
+    unsigned long sent = total_sent(pubs);
+    unsigned long expected = sent * n_ready;
+    int64_t idle_since = now_ns(CLOCK_MONOTONIC);
+    unsigned long progress = 0;
+    while (now_ns(CLOCK_MONOTONIC) - idle_since < (int64_t)DRAIN_MS * 1000000)
     {
-        printf("Delivery error or timeout.\n");
+        unsigned long acked = qos > 0 ? total_acked(pubs) : sent;
+        unsigned long recv = total_received(subs);
+        if (acked >= sent && recv >= expected)
+            break;
+        if (acked + recv != progress)
+        {
+            progress = acked + recv;
+            idle_since = now_ns(CLOCK_MONOTONIC);
+        }
+        usleep(10000);
     }
 
-    // 8. Disconnect and clean up memory
-    if ((rc = MQTTClient_disconnect(client, 10000)) != MQTTCLIENT_SUCCESS)
+    // 5. Disconnect and clean up memory
+    for (int i = 0; i < n_pubs; i++)
+    {
+        if (!pubs[i].connected)
+            continue;
+        MQTTClient_disconnect(pubs[i].client, 1000);
+        MQTTClient_destroy(&pubs[i].client);
+    }
+    for (int i = 0; i < n_subs; i++)
+    {
+        if (!subs[i].connected)
+            continue;
+        MQTTClient_disconnect(subs[i].client, 1000);
+        MQTTClient_destroy(&subs[i].client);
+    }
+    pthread_barrier_destroy(&start_barrier);
+
+    // 6. Report: acknowledgement latency per publish, end-to-end latency per delivery
+    samples_t *acks = calloc(n_pubs, sizeof(samples_t));
+    samples_t *e2e = calloc(n_subs ? n_subs : 1, sizeof(samples_t));
+    unsigned long failed = 0, stalls = 0, lost_pubs = 0;
+    unsigned long received = 0, reordered = 0, foreign = 0, lost_subs = 0;
+    for (int i = 0; i < n_pubs; i++)
+    {
+        acks[i] = pubs[i].acks;
+        failed += pubs[i].failed;
+        stalls += pubs[i].stalls;
+        lost_pubs += pubs[i].lost;
+    }
+    for (int i = 0; i < n_subs; i++)
     {
-        printf("Error disconnecting, code: %d\n", rc);
+        e2e[i] = subs[i].e2e;
+        received += subs[i].received;
+        reordered += subs[i].reordered;
+        foreign += subs[i].foreign;
+        lost_subs += subs[i].lost;
     }
 
-    MQTTClient_destroy(&client);
+    printf("\n%-9s %10s %10s %8s %8s %8s %8s %8s %8s\n",
+           "", "msgs", "msg/s", "MB/s", "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+    print_row("publish", acks, qos > 0 ? n_pubs : 0, sent, elapsed);
+    print_row("deliver", e2e, n_subs, received, elapsed);
+
+    printf("\nPublish: %lu sent, %lu failed, %lu in-flight stalls", sent, failed, stalls);
+    if (qos > 0)
+        printf(", %lu never acknowledged", sent - total_acked(pubs));
+    printf("\nDelivery: %lu of %lu expected (%lu lost), %lu out of order", received, expected,
+           expected > received ? expected - received : 0, reordered);
+    if (foreign > 0)
+        printf(", %lu foreign message(s) on %s", foreign, filter);
+    printf("\n");
+    if (lost_pubs + lost_subs > 0)
+        printf("Connection lost: %lu publisher(s), %lu subscriber(s)\n", lost_pubs, lost_subs);
+
+    for (int i = 0; i < n_pubs; i++)
+    {
+        free(pubs[i].acks.lat_us);
+        free(pubs[i].sent_ns);
+        pthread_mutex_destroy(&pubs[i].lock);
+    }
+    for (int i = 0; i < n_subs; i++)
+    {
+        free(subs[i].e2e.lat_us);
+        free(subs[i].last_seq);
+    }
+    free(acks);
+    free(e2e);
+    free(pubs);
+    free(subs);
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return (n_pub_ready == n_pubs && n_ready == n_subs) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
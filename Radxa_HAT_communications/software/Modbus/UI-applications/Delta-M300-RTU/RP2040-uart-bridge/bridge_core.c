@@ -0,0 +1,164 @@
+/**
+ * @file bridge_core.c
+ * @brief Ring buffers and Modbus RTU frame boundaries of the UART bridge
+ *        (see bridge_core.h).
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <string.h>
+#include "bridge_core.h"
+
+#define RING_MASK   (BRIDGE_RING_SIZE - 1)
+#define STARTS_MASK (BRIDGE_MAX_FRAMES - 1)
+
+uint32_t bridge_gap_us(uint32_t baud)
+{
+    if (baud > 19200)
+    {
+        return 1750;
+    }
+    return (uint32_t)((3.5 * 11 * 1000000.0) / baud + 0.5);
+}
+
+void bridge_dir_init(bridge_dir_t *d, uint32_t in_baud, uint32_t out_baud)
+{
+    memset(d, 0, sizeof(*d));
+    d->in_char_us = (BRIDGE_CHAR_BITS * 1000000 + in_baud - 1) / in_baud;
+    d->in_gap_us = bridge_gap_us(in_baud);
+    d->out_gap_us = bridge_gap_us(out_baud);
+    d->tx_quiet = true;
+}
+
+/**
+ * @brief Ends the frame being received and starts a new one.
+ */
+static void start_frame(bridge_dir_t *d)
+{
+    if (d->frame_len > d->stats.max_frame)
+    {
+        d->stats.max_frame = d->frame_len;
+    }
+    d->frame_len = 0;
+    d->frame_head = d->head;
+    d->dropping = false;
+    d->stats.frames++;
+
+    // Remember where the frame starts, so the transmitter leaves a gap before it.
+    // A previous frame that queued nothing (all dropped) shares its start
+    if (d->start_head != d->start_tail && d->starts[(d->start_head - 1) & STARTS_MASK] == d->head)
+    {
+        return;
+    }
+    if (d->start_head - d->start_tail < BRIDGE_MAX_FRAMES)
+    {
+        d->starts[d->start_head & STARTS_MASK] = d->head;
+        d->start_head++;
+    }
+    else
+    {
+        d->stats.merged_frames++;
+    }
+}
+
+void bridge_rx(bridge_dir_t *d, const uint8_t *data, uint32_t n, uint32_t last_us)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    // The first byte of the batch arrived n - 1 characters before the last one
+    uint32_t first_us = last_us - (n - 1) * d->in_char_us;
+    if (!d->rx_seen || (int32_t)(first_us - d->rx_last_us) >= (int32_t)d->in_gap_us)
+    {
+        start_frame(d);
+    }
+    d->rx_seen = true;
+    d->rx_last_us = last_us;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        d->stats.bytes_in++;
+        d->frame_len++;
+        if (d->dropping)
+        {
+            d->stats.overflow_bytes++;
+            continue;
+        }
+        if (d->head - d->tail == BRIDGE_RING_SIZE)
+        {
+            // A frame with a hole is useless: drop its remaining bytes too,
+            // and its queued bytes if the transmitter has not reached them
+            d->dropping = true;
+            d->stats.overflow_frames++;
+            d->stats.overflow_bytes++;
+            if ((int32_t)(d->frame_head - d->tail) >= 0)
+            {
+                d->stats.overflow_bytes += d->head - d->frame_head;
+                d->head = d->frame_head;
+            }
+            continue;
+        }
+        d->buf[d->head & RING_MASK] = data[i];
+        d->head++;
+    }
+
+    uint32_t fill = d->head - d->tail;
+    if (fill > d->stats.max_fill)
+    {
+        d->stats.max_fill = fill;
+    }
+}
+
+bridge_tx_t bridge_tx_next(bridge_dir_t *d, uint8_t *byte)
+{
+    if (d->tail == d->head)
+    {
+        return BRIDGE_TX_EMPTY;
+    }
+
+    if (d->start_tail != d->start_head && d->starts[d->start_tail & STARTS_MASK] == d->tail)
+    {
+        if (!d->tx_quiet)
+        {
+            return BRIDGE_TX_GAP;
+        }
+        d->start_tail++;
+    }
+
+    *byte = d->buf[d->tail & RING_MASK];
+    d->tail++;
+    d->stats.bytes_out++;
+    d->tx_quiet = false;
+    d->tx_sent = true;
+    return BRIDGE_TX_BYTE;
+}
+
+bool bridge_tx_service(bridge_dir_t *d, bool line_busy, uint32_t now_us)
+{
+    // A byte sent since the last call counts as busy, even if it is already out
+    if (line_busy || d->tx_sent)
+    {
+        d->tx_sent = false;
+        d->tx_quiet = false;
+        d->tx_busy_us = now_us;
+        return false;
+    }
+    if (d->tx_quiet || now_us - d->tx_busy_us < d->out_gap_us)
+    {
+        return false;
+    }
+
+    d->tx_quiet = true;
+
+    // Something waited for this silence
+    if (d->tail != d->head && d->start_tail != d->start_head &&
+        d->starts[d->start_tail & STARTS_MASK] == d->tail)
+    {
+        d->stats.gaps_waited++;
+        return true;
+    }
+    return false;
+}
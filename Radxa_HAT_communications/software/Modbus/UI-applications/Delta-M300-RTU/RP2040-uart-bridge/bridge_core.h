@@ -0,0 +1,129 @@
+/**
+ * @file bridge_core.h
+ * @brief Frame-aware forwarding core of the UART to RS485 bridge.
+ *
+ * One bridge_dir_t carries one direction (host to bus, or bus to host):
+ * a ring buffer filled from the RX interrupt of one UART and drained into
+ * the TX FIFO of the other, so a full TX FIFO delays bytes instead of
+ * dropping them.
+ *
+ * The core also finds the Modbus RTU frame boundaries: a silence of at
+ * least 3.5 characters (t3.5) on the input starts a new frame. Queued
+ * frames are sent with the same silence between them, so two frames that
+ * waited in the ring never reach the other side as one.
+ *
+ * The core is plain C with no Pico SDK dependency. Times are microsecond
+ * counters that may wrap (time_us_32() on the RP2040), so the same code
+ * runs in the firmware and in the host benchmark (host/bridge_bench.c).
+ *
+ * Concurrency: bridge_rx() is the only producer, but on overflow it takes
+ * back the queued part of the frame, so none of the three functions may
+ * run concurrently with another; the firmware calls them from interrupts
+ * of the same priority, or with interrupts disabled.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef BRIDGE_CORE_H
+#define BRIDGE_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BRIDGE_RING_SIZE   1024     // Bytes per direction (power of two), four maximal RTU frames
+#define BRIDGE_MAX_FRAMES  32       // Frame starts remembered per direction (power of two)
+#define BRIDGE_CHAR_BITS   10       // 8N1: start + 8 data + stop
+
+/** @brief Result of bridge_tx_next(). */
+typedef enum {
+    BRIDGE_TX_EMPTY,    ///< Nothing to send
+    BRIDGE_TX_BYTE,     ///< *byte is the next byte to send
+    BRIDGE_TX_GAP       ///< Next frame waits for t3.5 of silence on the output (see bridge_tx_service())
+} bridge_tx_t;
+
+/** @brief Counters of one direction. */
+typedef struct {
+    uint32_t bytes_in;          ///< Bytes received
+    uint32_t bytes_out;         ///< Bytes handed to the TX FIFO
+    uint32_t frames;            ///< Frames received
+    uint32_t overflow_bytes;    ///< Bytes dropped because the ring was full
+    uint32_t overflow_frames;   ///< Frames that lost bytes (the rest of such a frame is dropped, and so is its queued part if none of it was sent)
+    uint32_t merged_frames;     ///< Frames sent without a gap before them (frame list full)
+    uint32_t gaps_waited;       ///< Frames held back until the output was silent for t3.5
+    uint32_t max_fill;          ///< Highest ring fill in bytes
+    uint32_t max_frame;         ///< Longest frame received in bytes
+} bridge_stats_t;
+
+/** @brief State of one direction. */
+typedef struct {
+    uint8_t buf[BRIDGE_RING_SIZE];
+    volatile uint32_t head;                     // Free-running write count
+    volatile uint32_t tail;                     // Free-running read count
+    uint32_t starts[BRIDGE_MAX_FRAMES];         // Values of head where a queued frame starts
+    volatile uint32_t start_head;
+    volatile uint32_t start_tail;
+
+    uint32_t in_char_us;        // One character on the input
+    uint32_t in_gap_us;         // t3.5 on the input
+    uint32_t out_gap_us;        // t3.5 on the output
+
+    // Receiver
+    bool rx_seen;               // A byte has been received
+    uint32_t rx_last_us;        // Arrival of the last byte
+    uint32_t frame_len;
+    uint32_t frame_head;        // Value of head where the current frame starts
+    bool dropping;              // Rest of the current frame is dropped
+
+    // Transmitter
+    bool tx_quiet;              // Output silent for at least t3.5
+    bool tx_sent;               // A byte was sent since the last bridge_tx_service()
+    uint32_t tx_busy_us;        // Last time the output was seen busy
+
+    bridge_stats_t stats;
+} bridge_dir_t;
+
+/**
+ * @brief Modbus RTU inter-frame silence t3.5 for a baud rate: 3.5
+ * characters of 11 bits, fixed at 1750 us above 19200 baud.
+ */
+uint32_t bridge_gap_us(uint32_t baud);
+
+/**
+ * @brief Initializes a direction.
+ * @param in_baud Baud rate of the UART the bytes come from.
+ * @param out_baud Baud rate of the UART they are sent to.
+ */
+void bridge_dir_init(bridge_dir_t *d, uint32_t in_baud, uint32_t out_baud);
+
+/**
+ * @brief Queues bytes read from the RX FIFO in one interrupt.
+ *
+ * The bytes are assumed back to back, the last one received at last_us.
+ * A batch never spans two frames: the RX timeout interrupt (32 bit times)
+ * fires before t3.5 has elapsed.
+ */
+void bridge_rx(bridge_dir_t *d, const uint8_t *data, uint32_t n, uint32_t last_us);
+
+/**
+ * @brief Takes the next byte to send.
+ * @return BRIDGE_TX_BYTE with *byte set, BRIDGE_TX_EMPTY, or BRIDGE_TX_GAP
+ *         when the next frame must wait for silence on the output.
+ */
+bridge_tx_t bridge_tx_next(bridge_dir_t *d, uint8_t *byte);
+
+/**
+ * @brief Tracks the silence on the output. Call it often, at least once
+ * per character, with the state of the TX line (FIFO or shift register
+ * not empty).
+ * @return true if a frame held by BRIDGE_TX_GAP may now be sent.
+ */
+bool bridge_tx_service(bridge_dir_t *d, bool line_busy, uint32_t now_us);
+
+/** @brief Bytes waiting in the ring. */
+static inline uint32_t bridge_pending(const bridge_dir_t *d)
+{
+    return d->head - d->tail;
+}
+
+#endif // BRIDGE_CORE_H
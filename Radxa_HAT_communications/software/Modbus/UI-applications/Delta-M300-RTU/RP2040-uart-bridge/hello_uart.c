@@ -6,6 +6,12 @@
  * to act as a bridge, forwarding data between a host (Intel N100) and
  * an RS485 bus with auto-direction transceiver.
  *
+ * Each direction goes through a ring buffer (bridge_core.c): the RX
+ * interrupt of one UART queues the bytes, and the TX interrupt of the
+ * other drains them, so nothing is lost when a TX FIFO is full. Modbus
+ * RTU frames are kept apart on the output by the same 3.5 character
+ * silence that separated them on the input.
+ *
  * @author Adrián Silva Palafox
  * @date October 2025
  */
@@ -13,9 +19,13 @@
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "bridge_core.h"
 
 // UART configuration
 #define BAUD_RATE 38400
+#define HOST_BAUD_RATE BAUD_RATE    // Intel N100 side, may be faster than the bus
+#define BUS_BAUD_RATE BAUD_RATE     // RS485 side
 #define DATA_BITS 8
 #define STOP_BITS 1
 #define PARITY UART_PARITY_NONE
@@ -30,16 +40,104 @@
 #define RS485_TX_PIN 20
 #define RS485_RX_PIN 21
 
+// Counters are printed on USB stdio when they change, at most this often
+#define STATS_PERIOD_MS 5000
+
+// Forwarding state, one per direction
+static bridge_dir_t to_bus;     // Intel N100 -> RS485
+static bridge_dir_t to_host;    // RS485 -> Intel N100
+
+// RX timeout of each UART: 32 bit times without a new byte
+static uint32_t host_rx_timeout_us;
+static uint32_t bus_rx_timeout_us;
+
 // Function prototypes
-void on_RS485_rx(void);
-void on_INTEL_N100_rx(void);
+void on_RS485_irq(void);
+void on_INTEL_N100_irq(void);
+
+/**
+ * @brief Moves queued bytes into the TX FIFO of a UART.
+ *
+ * The TX interrupt is enabled only while the FIFO is full, so it fires
+ * when there is room again. At the end of the queue, or before a frame
+ * that must wait for the inter-frame silence, it is disabled: the next
+ * RX interrupt or the main loop resumes.
+ */
+static void pump(bridge_dir_t *d, uart_inst_t *out)
+{
+    uint8_t ch;
+
+    while (uart_is_writable(out))
+    {
+        if (bridge_tx_next(d, &ch) != BRIDGE_TX_BYTE)
+        {
+            hw_clear_bits(&uart_get_hw(out)->imsc, UART_UARTIMSC_TXIM_BITS);
+            return;
+        }
+        uart_putc_raw(out, ch);
+    }
+    hw_set_bits(&uart_get_hw(out)->imsc, UART_UARTIMSC_TXIM_BITS);
+}
+
+/**
+ * @brief Queues everything in the RX FIFO of a UART.
+ *
+ * On the RX timeout interrupt the last byte arrived 32 bit times before
+ * the interrupt; otherwise it has just arrived.
+ */
+static void receive(bridge_dir_t *d, uart_inst_t *in, uint32_t timeout_us)
+{
+    uint8_t buf[32];
+    uint32_t n = 0;
+    uint32_t now = time_us_32();
+
+    if (uart_get_hw(in)->mis & UART_UARTMIS_RTMIS_BITS)
+    {
+        now -= timeout_us;
+    }
+    while (uart_is_readable(in) && n < sizeof(buf))
+    {
+        buf[n++] = uart_getc(in);
+    }
+    bridge_rx(d, buf, n, now);
+}
+
+/**
+ * @brief Sends a frame held for the inter-frame silence once the output
+ * has been silent long enough. Called from the main loop.
+ */
+static void service(bridge_dir_t *d, uart_inst_t *out)
+{
+    bool busy = uart_get_hw(out)->fr & UART_UARTFR_BUSY_BITS;
+    uint32_t irq = save_and_disable_interrupts();
+
+    if (bridge_tx_service(d, busy, time_us_32()))
+    {
+        pump(d, out);
+    }
+    restore_interrupts(irq);
+}
+
+/**
+ * @brief Prints the counters of one direction.
+ */
+static void print_stats(const char *name, const bridge_stats_t *s)
+{
+    printf("%s: %lu bytes in, %lu out, %lu frames (longest %lu), %lu bytes lost in %lu frames, "
+           "%lu merged, %lu gaps waited, ring max %lu/%d\n",
+           name, (unsigned long)s->bytes_in, (unsigned long)s->bytes_out,
+           (unsigned long)s->frames, (unsigned long)s->max_frame,
+           (unsigned long)s->overflow_bytes, (unsigned long)s->overflow_frames,
+           (unsigned long)s->merged_frames, (unsigned long)s->gaps_waited,
+           (unsigned long)s->max_fill, BRIDGE_RING_SIZE);
+}
 
 /**
  * @brief Main function of the program.
  *
  * Initializes two UART peripherals, sets up their GPIOs, and configures
- * interrupts to handle byte reception. The main loop blinks an LED to
- * show the system is running.
+ * interrupts to handle reception and transmission. The main loop releases
+ * frames that wait for the inter-frame silence and prints the counters.
  */
 int main()
 {
@@ -48,8 +146,13 @@ int main()
     sleep_ms(2000); // Wait for USB to enumerate
 
     // Initialize both UART instances
-    uart_init(RS485, BAUD_RATE);
-    uart_init(INTEL_N100, BAUD_RATE);
+    uint32_t bus_baud = uart_init(RS485, BUS_BAUD_RATE);
+    uint32_t host_baud = uart_init(INTEL_N100, HOST_BAUD_RATE);
+
+    bridge_dir_init(&to_bus, host_baud, bus_baud);
+    bridge_dir_init(&to_host, bus_baud, host_baud);
+    bus_rx_timeout_us = 32 * 1000000 / bus_baud;
+    host_rx_timeout_us = 32 * 1000000 / host_baud;
 
     // Set the GPIO pins to their UART function
     gpio_set_function(RS485_TX_PIN, GPIO_FUNC_UART);
@@ -70,65 +173,77 @@ int main()
     uart_set_fifo_enabled(RS485, true);
     uart_set_fifo_enabled(INTEL_N100, true);
 
+    // RX interrupt at 1/8 full (4 bytes) instead of the reset value of 1/2,
+    // so a frame starts going out after 4 bytes. TX stays at 1/2
+    hw_write_masked(&uart_get_hw(RS485)->ifls, 0 << UART_UARTIFLS_RXIFLSEL_LSB,
+                    UART_UARTIFLS_RXIFLSEL_BITS);
+    hw_write_masked(&uart_get_hw(INTEL_N100)->ifls, 0 << UART_UARTIFLS_RXIFLSEL_LSB,
+                    UART_UARTIFLS_RXIFLSEL_BITS);
+
     // Set up the interrupt handlers
-    irq_set_exclusive_handler(UART0_IRQ, on_INTEL_N100_rx);
-    irq_set_exclusive_handler(UART1_IRQ, on_RS485_rx);
+    irq_set_exclusive_handler(UART0_IRQ, on_INTEL_N100_irq);
+    irq_set_exclusive_handler(UART1_IRQ, on_RS485_irq);
 
     // Enable the IRQs
     irq_set_enabled(UART0_IRQ, true);
     irq_set_enabled(UART1_IRQ, true);
 
-    // Enable UART RX interrupts only
+    // Enable UART RX interrupts; TX interrupts are enabled by pump() when needed
     uart_set_irq_enables(RS485, true, false);
     uart_set_irq_enables(INTEL_N100, true, false);
 
+    bridge_stats_t last_bus = {0}, last_host = {0};
+    absolute_time_t next_stats = make_timeout_time_ms(STATS_PERIOD_MS);
+
     while (1)
     {
+        service(&to_bus, RS485);
+        service(&to_host, INTEL_N100);
+
+        if (time_reached(next_stats))
+        {
+            uint32_t irq = save_and_disable_interrupts();
+            bridge_stats_t bus = to_bus.stats, host = to_host.stats;
+            restore_interrupts(irq);
+
+            if (bus.bytes_in != last_bus.bytes_in || host.bytes_in != last_host.bytes_in)
+            {
+                print_stats("host->bus", &bus);
+                print_stats("bus->host", &host);
+                last_bus = bus;
+                last_host = host;
+            }
+            next_stats = make_timeout_time_ms(STATS_PERIOD_MS);
+        }
         tight_loop_contents();
     }
     return 0;
 }
 
 /**
- * @brief ISR for RS485 (uart1) RX.
+ * @brief ISR for RS485 (uart1).
  *
- * This function is called whenever data is received on the RS485 UART.
- * It reads all available characters and forwards them to the Intel N100.
+ * Queues the bytes received from the bus and starts sending them to the
+ * Intel N100. When the TX FIFO of uart1 has room again, sends more of the
+ * bytes queued from the Intel N100.
  */
-void on_RS485_rx()
+void on_RS485_irq()
 {
-    while (uart_is_readable(RS485))
-    {
-        uint8_t ch = uart_getc(RS485);
-
-        // Forward to Intel N100
-        if (uart_is_writable(INTEL_N100))
-        {
-            uart_putc_raw(INTEL_N100, ch);
-        }
-        // Note: If FIFO is full, data will be lost. This should be rare
-        // with proper Modbus timing and the 32-byte FIFO depth.
-    }
+    receive(&to_host, RS485, bus_rx_timeout_us);
+    pump(&to_host, INTEL_N100);
+    pump(&to_bus, RS485);
 }
 
 /**
- * @brief ISR for INTEL_N100 (uart0) RX.
+ * @brief ISR for INTEL_N100 (uart0).
  *
- * This function is called whenever data is received on the Intel N100 UART.
- * It reads all available characters and forwards them to the RS485 bus.
+ * Queues the bytes received from the Intel N100 and starts sending them
+ * to the RS485 bus. When the TX FIFO of uart0 has room again, sends more
+ * of the bytes queued from the bus.
  */
-void on_INTEL_N100_rx()
+void on_INTEL_N100_irq()
 {
-    while (uart_is_readable(INTEL_N100))
-    {
-        uint8_t ch = uart_getc(INTEL_N100);
-
-        // Forward to RS485
-        if (uart_is_writable(RS485))
-        {
-            uart_putc_raw(RS485, ch);
-        }
-        // Note: If FIFO is full, data will be lost. This should be rare
-        // with proper Modbus timing and the 32-byte FIFO depth.
-    }
-}
\ No newline at end of file
+    receive(&to_bus, INTEL_N100, host_rx_timeout_us);
+    pump(&to_bus, RS485);
+    pump(&to_host, INTEL_N100);
+}
@@ -0,0 +1,449 @@
+/**
+ * @file bridge_bench.c
+ * @brief Host benchmark of the bridge forwarding core (../bridge_core.c).
+ *
+ * Simulates one direction of the RP2040 bridge in 1 us steps: Modbus RTU
+ * frames arrive on the input UART, go through a 32-byte RX FIFO with the
+ * PL011 interrupt rules (4 bytes, or 32 bit times of silence), the core,
+ * and a 32-byte TX FIFO, and are split into frames again on the output
+ * wire by the t3.5 silence. Every output frame is compared with the frame
+ * sent, so lost bytes, missing frames and merged or split frames show up.
+ *
+ * With -l the old forwarding is simulated instead: each byte is written
+ * to the TX FIFO from the RX interrupt, or dropped if the FIFO is full.
+ *
+ * Finally the cost of the core itself is measured in ns per byte.
+ *
+ * With the ring and equal baud rates every frame must arrive intact; the
+ * exit status is non-zero otherwise.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include "bridge_core.h"
+
+#define FIFO_LEN        32
+#define RX_IRQ_LEVEL    4       // RX FIFO level interrupt (1/8, set by hello_uart.c)
+#define TX_IRQ_LEVEL    16      // TX FIFO level interrupt (1/2, the reset value)
+#define MAX_FRAME       256
+
+typedef struct {
+    uint8_t data[FIFO_LEN];
+    int head, count;
+} fifo_t;
+
+static void fifo_put(fifo_t *f, uint8_t b)
+{
+    f->data[(f->head + f->count) % FIFO_LEN] = b;
+    f->count++;
+}
+
+static uint8_t fifo_get(fifo_t *f)
+{
+    uint8_t b = f->data[f->head];
+    f->head = (f->head + 1) % FIFO_LEN;
+    f->count--;
+    return b;
+}
+
+// Simulated peripherals
+static fifo_t rx_fifo, tx_fifo;
+static bool tx_irq_enabled;
+static bool legacy;
+static bridge_dir_t dir;
+static unsigned long rx_overruns, legacy_drops;
+
+// Frames sent, and the frame being received on the output wire
+static uint8_t (*frames)[MAX_FRAME];
+static int *lens;
+static uint64_t *in_end;                // End of each frame on the input (ns)
+static int n_frames = 1000;
+static uint8_t out_frame[MAX_FRAME];
+static int out_len;                     // Bytes of the frame, stored up to MAX_FRAME
+static int expected;                    // Next frame expected on the output
+static int out_frames, intact, merged, damaged, missing;
+static uint64_t latency_sum, latency_max;
+
+/** @brief The frame received on the output wire is sent frame k. */
+static bool same_frame(int k)
+{
+    return out_len == lens[k] && memcmp(out_frame, frames[k], (size_t)out_len) == 0;
+}
+
+/**
+ * @brief Compares the frame received on the output wire with the frames
+ * sent. out_end is the end of its last byte.
+ */
+static void check_frame(uint64_t out_end)
+{
+    if (out_len == 0)
+    {
+        return;
+    }
+    out_frames++;
+
+    // Frames dropped whole on a full ring never reach the output
+    int next = expected;
+    while (next < n_frames && !same_frame(next))
+    {
+        next++;
+    }
+    if (next < n_frames)
+    {
+        missing += next - expected;
+        expected = next;
+    }
+
+    if (expected < n_frames && same_frame(expected))
+    {
+        uint64_t latency = out_end - in_end[expected];
+        intact++;
+        latency_sum += latency;
+        if (latency > latency_max)
+        {
+            latency_max = latency;
+        }
+    }
+    else
+    {
+        // Several frames sent without enough silence between them?
+        int len = 0, k = expected;
+        while (k < n_frames && len < out_len)
+        {
+            len += lens[k++];
+        }
+        if (len == out_len && k - expected > 1)
+        {
+            merged++;
+            expected = k - 1;
+        }
+        else
+        {
+            damaged++;
+        }
+    }
+    expected++;
+    out_len = 0;
+}
+
+/** @brief pump() of the firmware, on the simulated TX FIFO. */
+static void pump(void)
+{
+    uint8_t ch;
+
+    while (tx_fifo.count < FIFO_LEN)
+    {
+        if (bridge_tx_next(&dir, &ch) != BRIDGE_TX_BYTE)
+        {
+            tx_irq_enabled = false;
+            return;
+        }
+        fifo_put(&tx_fifo, ch);
+    }
+    tx_irq_enabled = true;
+}
+
+/** @brief RX interrupt of the firmware, on the simulated RX FIFO. */
+static void rx_irq(uint32_t now_us, bool timeout, uint32_t timeout_us)
+{
+    uint8_t buf[FIFO_LEN];
+    uint32_t n = 0;
+
+    while (rx_fifo.count > 0)
+    {
+        buf[n++] = fifo_get(&rx_fifo);
+    }
+    if (legacy)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (tx_fifo.count < FIFO_LEN)
+            {
+                fifo_put(&tx_fifo, buf[i]);
+            }
+            else
+            {
+                legacy_drops++;
+            }
+        }
+        return;
+    }
+    bridge_rx(&dir, buf, n, timeout ? now_us - timeout_us : now_us);
+    pump();
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Cost of the core: bytes through bridge_rx() in FIFO-sized
+ * batches and out through bridge_tx_next().
+ */
+static void bench_core(void)
+{
+    static bridge_dir_t d;
+    uint8_t batch[RX_IRQ_LEVEL] = { 0x02, 0x03, 0x21, 0x03 };
+    uint8_t ch;
+    uint32_t t = 0;
+    unsigned long bytes = 0;
+    const unsigned long total = 200000000UL;
+
+    bridge_dir_init(&d, 115200, 115200);
+    double start = now_ns();
+    while (bytes < total)
+    {
+        // 64-byte frames, 3.5 characters apart
+        for (int i = 0; i < 64 / RX_IRQ_LEVEL; i++)
+        {
+            t += RX_IRQ_LEVEL * d.in_char_us;
+            bridge_rx(&d, batch, RX_IRQ_LEVEL, t);
+            while (bridge_tx_next(&d, &ch) == BRIDGE_TX_BYTE)
+            {
+                bytes++;
+            }
+        }
+        t += d.in_gap_us + 1;
+        bridge_tx_service(&d, false, t);
+        bridge_tx_service(&d, false, t + d.out_gap_us);
+    }
+    double ns = now_ns() - start;
+    printf("Core: %.1f ns/byte (%.0f Mbyte/s)\n", ns / bytes, bytes / ns * 1e3);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-i IN_BAUD] [-o OUT_BAUD] [-n FRAMES] [-s MIN-MAX] [-g MS] [-r SEED] [-l]\n"
+            "  -i  Input baud rate (default 38400)\n"
+            "  -o  Output baud rate (default: input baud rate)\n"
+            "  -n  Frames to send (default 1000)\n"
+            "  -s  Frame length range in bytes (default 8-256)\n"
+            "  -g  Extra silence between frames in ms, on top of t3.5 (default 0)\n"
+            "  -r  Random seed (default 1)\n"
+            "  -l  Simulate the old forwarding (drop when the TX FIFO is full)\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t in_baud = 38400, out_baud = 0;
+    int min_len = 8, max_len = 256;
+    double extra_ms = 0;
+    unsigned seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:o:n:s:g:r:l")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i': in_baud = (uint32_t)atoi(optarg); break;
+        case 'o': out_baud = (uint32_t)atoi(optarg); break;
+        case 'n': n_frames = atoi(optarg); break;
+        case 's':
+            if (sscanf(optarg, "%d-%d", &min_len, &max_len) != 2)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'g': extra_ms = atof(optarg); break;
+        case 'r': seed = (unsigned)atoi(optarg); break;
+        case 'l': legacy = true; break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (out_baud == 0)
+    {
+        out_baud = in_baud;
+    }
+    if (in_baud < 1200 || out_baud < 1200 || n_frames < 1 ||
+        min_len < 1 || max_len > MAX_FRAME || min_len > max_len)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    srand(seed);
+    bridge_dir_init(&dir, in_baud, out_baud);
+
+    // Frames to send, kept to check the output
+    frames = malloc((size_t)n_frames * MAX_FRAME);
+    lens = malloc((size_t)n_frames * sizeof(int));
+    in_end = malloc((size_t)n_frames * sizeof(uint64_t));
+    if (!frames || !lens || !in_end)
+    {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (int f = 0; f < n_frames; f++)
+    {
+        lens[f] = min_len + rand() % (max_len - min_len + 1);
+        for (int i = 0; i < lens[f]; i++)
+        {
+            frames[f][i] = (uint8_t)rand();
+        }
+    }
+
+    // Wire timing in ns
+    const uint64_t in_char = BRIDGE_CHAR_BITS * 1000000000ULL / in_baud;
+    const uint64_t out_char = BRIDGE_CHAR_BITS * 1000000000ULL / out_baud;
+    const uint64_t in_timeout = 32 * 1000000000ULL / in_baud;
+    const uint64_t gap = bridge_gap_us(in_baud) * 1000ULL + (uint64_t)(extra_ms * 1e6);
+    const uint64_t out_gap = bridge_gap_us(out_baud) * 1000ULL;
+
+    // Sender
+    int send_frame = 0, send_pos = 0;
+    uint64_t next_rx = in_char;         // End of the next byte on the input
+    uint64_t last_rx = 0;
+
+    // Transmitter on the output wire
+    bool shifting = false;
+    uint8_t shift_byte = 0;
+    uint64_t shift_end = 0, last_out = 0;
+
+    uint64_t t = 0;
+    while (send_frame < n_frames || rx_fifo.count > 0 || tx_fifo.count > 0 ||
+           shifting || bridge_pending(&dir) > 0)
+    {
+        t += 1000;
+        uint32_t now_us = (uint32_t)(t / 1000);
+
+        // Input wire -> RX FIFO
+        while (send_frame < n_frames && next_rx <= t)
+        {
+            if (rx_fifo.count < FIFO_LEN)
+            {
+                fifo_put(&rx_fifo, frames[send_frame][send_pos]);
+            }
+            else
+            {
+                rx_overruns++;
+            }
+            last_rx = next_rx;
+            if (++send_pos == lens[send_frame])
+            {
+                in_end[send_frame] = next_rx;
+                send_frame++;
+                send_pos = 0;
+                next_rx += gap + in_char;
+            }
+            else
+            {
+                next_rx += in_char;
+            }
+        }
+
+        // RX interrupt: FIFO level, or 32 bit times without a new byte
+        if (rx_fifo.count >= RX_IRQ_LEVEL)
+        {
+            rx_irq(now_us, false, 0);
+        }
+        else if (rx_fifo.count > 0 && t - last_rx >= in_timeout)
+        {
+            rx_irq(now_us, true, (uint32_t)(in_timeout / 1000));
+        }
+
+        // TX shift register -> output wire, split into frames by t3.5
+        if (shifting && shift_end <= t)
+        {
+            if (shift_end - out_char - last_out >= out_gap)
+            {
+                check_frame(last_out);
+            }
+            // Only single frames are compared byte by byte
+            if (out_len < MAX_FRAME)
+            {
+                out_frame[out_len] = shift_byte;
+            }
+            out_len++;
+            last_out = shift_end;
+            shifting = false;
+        }
+        if (!shifting && tx_fifo.count > 0)
+        {
+            int before = tx_fifo.count;
+            shift_byte = fifo_get(&tx_fifo);
+            shifting = true;
+            // Back to back with a byte that ended during this step
+            shift_end = (last_out + 1000 > t ? last_out : t) + out_char;
+
+            // TX interrupt when the level drops to the threshold
+            if (tx_irq_enabled && before > TX_IRQ_LEVEL && tx_fifo.count <= TX_IRQ_LEVEL)
+            {
+                pump();
+            }
+        }
+
+        // Main loop of the firmware
+        if (!legacy && bridge_tx_service(&dir, shifting || tx_fifo.count > 0, now_us))
+        {
+            pump();
+        }
+    }
+    check_frame(last_out);
+    if (expected < n_frames)
+    {
+        missing += n_frames - expected;
+    }
+
+    uint64_t sent_bytes = 0;
+    for (int f = 0; f < n_frames; f++)
+    {
+        sent_bytes += (uint64_t)lens[f];
+    }
+
+    printf("%s forwarding, %u -> %u baud, %d frames of %d-%d bytes, t3.5 %u/%u us, extra silence %.1f ms\n",
+           legacy ? "Old" : "Ring", in_baud, out_baud, n_frames, min_len, max_len,
+           bridge_gap_us(in_baud), bridge_gap_us(out_baud), extra_ms);
+    printf("Output: %d frames, %d intact, %d made of several frames, %d damaged, %d missing; simulated %.2f s\n",
+           out_frames, intact, merged, damaged, missing, t / 1e9);
+    if (intact > 0)
+    {
+        printf("Delay from the end of a frame on the input to its end on the output: avg %.0f us, max %.0f us\n",
+               latency_sum / 1e3 / intact, latency_max / 1e3);
+    }
+    printf("Lost: %lu RX FIFO overruns", rx_overruns);
+    if (legacy)
+    {
+        printf(", %lu bytes dropped on a full TX FIFO of %llu sent\n",
+               legacy_drops, (unsigned long long)sent_bytes);
+    }
+    else
+    {
+        const bridge_stats_t *s = &dir.stats;
+        printf(", %lu bytes dropped on a full ring in %lu frames of %llu sent\n",
+               (unsigned long)s->overflow_bytes, (unsigned long)s->overflow_frames,
+               (unsigned long long)sent_bytes);
+        printf("Core: %lu frames detected (longest %lu), %lu gaps waited, %lu merged, ring max %lu/%d\n",
+               (unsigned long)s->frames, (unsigned long)s->max_frame, (unsigned long)s->gaps_waited,
+               (unsigned long)s->merged_frames, (unsigned long)s->max_fill, BRIDGE_RING_SIZE);
+    }
+
+    // The output keeps up with the input: any frame not intact is a bug
+    int rc = EXIT_SUCCESS;
+    if (!legacy && in_baud == out_baud && intact != n_frames)
+    {
+        fprintf(stderr, "FAIL: %d of %d frames intact at equal baud rates\n", intact, n_frames);
+        rc = EXIT_FAILURE;
+    }
+
+    free(frames);
+    free(lens);
+    free(in_end);
+
+    bench_core();
+    return rc;
+}
@@ -10,12 +10,17 @@
 #include <stdint.h>
 #include <modbus.h>
 #include <MQTTClient.h>
+#include "reg_cache.h"
+#include "ramp.h"
 
 // ==== MQTT Configuration ====
 #define ADDRESS         "tcp://localhost:1883"      ///< MQTT Broker Address (use 'tcp://' for Eclipse Paho)
 #define CLIENTID        "VFD_Control_Client_001"        ///< Unique Client ID
 #define TOPIC_TELEMETRY "vdf/telemetry"                 ///< Telemetry Topic
 #define TOPIC_COMMUNICATION   "vdf/communication"       ///< Communication  Topic
+#define TOPIC_BIRTH     "vdf/birth"                     ///< Compact session: metric aliases (retained)
+#define TOPIC_DATA      "vdf/d"                         ///< Compact session: binary alias/value samples
+#define TOPIC_DEATH     "vdf/death"                     ///< Compact session: drive offline (retained, also the last will)
 #define QOS             1                               ///< Quality of Service Level
 #define TIMEOUT         10000L                          ///< Timeout in milliseconds
 
@@ -25,6 +30,12 @@
 #define REG_MONITOR_START 0x2103    ///< Start Address for Monitor Registers
 #define MONITOR_LEN       10        ///< Number of registers to read for telemetry
 
+// ==== Frequency Ramps ====
+#define RAMP_PERIOD_MS    50        ///< Time between two frequency writes of a ramp
+#define RAMP_RATE_HZ_S    10.0      ///< Average rate of setpoint ramps (Hz/s)
+#define TELEMETRY_MS      200       ///< Telemetry read period
+#define MONITOR_TTL_MS    (TELEMETRY_MS / 2) ///< Monitor block cache TTL, below TELEMETRY_MS so every poll is a fresh sample
+
 // ==== Binary Commands for Register 0x2000 ====
 #define CMD_STOP          0x01      ///< Stop Command (0000 0001)
 #define CMD_RUN           0x02      ///< Run Command (0000 0010)
@@ -36,6 +47,7 @@
  */
 typedef struct {
     modbus_t *ctx;      ///< Libmodbus context pointer
+    reg_cache_t *cache; ///< Read cache in front of ctx (all bus access goes through it)
     const char *device; ///< Serial device path (e.g., /dev/ttyUSB0)
     int baud;           ///< Baud rate
     char parity;        ///< Parity ('N', 'E', 'O')
@@ -54,6 +66,21 @@ typedef struct {
     int target_freq;    ///< Target frequency (Hz * 100)
 } setpoint_t;
 
+/**
+ * @brief Frequency Ramp State.
+ * In ramp mode a new target frequency is reached with a profiled ramp
+ * from the frequency last written, one write every RAMP_PERIOD_MS.
+ */
+typedef struct {
+    bool enabled;               ///< Ramp mode ('r')
+    ramp_shape_t shape;         ///< Shape of setpoint ramps ('p')
+    bool active;                ///< A ramp is being played
+    int written_freq;           ///< Last frequency written (Hz * 100)
+    ramp_t ramp;                ///< Schedule and timing statistics of the current or last ramp
+    const char *script;         ///< Profile played with 'g' (2nd argument), NULL if none
+    ramp_profile_t script_profile;
+} ramp_ctl_t;
+
 /**
  * @brief Received Telemetry (Feedback).
  * Stores data read from the VFD.
@@ -72,6 +99,8 @@ typedef struct {
     bool comm_error;                  ///< Flag indicating Modbus communication failure
     uint8_t last_msg_code;            ///< Last message code (for UI display)
     char last_msg[64];                ///< Last status/error message for the UI
+    unsigned long cache_hits;         ///< Monitor reads answered from the cache
+    unsigned long cache_misses;       ///< Monitor reads that went to the bus
 } telemetry_t;
 
 #endif // COMMON_H
@@ -12,13 +12,18 @@
  * @brief Initializes the MQTT client and connects to the broker.
  * @param client Pointer to MQTTClient instance.
  * @param conn_opts Pointer to MQTTClient_connectOptions structure.
+ * @param compact true for the compact session (birth message, binary
+ *        alias/value samples and a death certificate as last will),
+ *        false for JSON telemetry on TOPIC_TELEMETRY.
  * @return int EXIT_SUCCESS on success, EXIT_FAILURE on error.
  */
-int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts);
+int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts, bool compact);
 
 /**
  * @brief Publishes telemetry data to the MQTT broker.
- * Formats telemetry as JSON and sends to the telemetry topic.
+ * Formats telemetry as JSON and sends to the telemetry topic. In compact
+ * mode the first call publishes the birth message, and every call sends
+ * the alias/value pairs in binary on TOPIC_DATA.
  * @param client Pointer to MQTTClient instance.
  * @param pubmsg Pointer to MQTTClient_message structure.
  * @param token Pointer to MQTTClient_deliveryToken for tracking delivery.
@@ -29,6 +34,7 @@ int publish_telemetry(MQTTClient *client, MQTTClient_message *pubmsg, MQTTClient
 
 /**
  * @brief Disconnects the MQTT client and cleans up resources.
+ * In compact mode the death certificate is published first.
  * @param client Pointer to MQTTClient instance.
  * @return int EXIT_SUCCESS always.
  */
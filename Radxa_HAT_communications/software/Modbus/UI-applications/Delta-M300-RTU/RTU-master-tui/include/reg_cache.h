@@ -0,0 +1,94 @@
+/**
+ * @file reg_cache.h
+ * @brief TTL read cache for holding registers in front of a libmodbus context.
+ *
+ * Every read of a register block costs bus time (about 10 ms for the MS300
+ * monitor block at 38400 baud), even when several consumers ask for the same
+ * block within a few milliseconds. The cache keeps a copy of configured
+ * register ranges for a per-range time-to-live:
+ *   - A read inside a fresh range is answered from memory.
+ *   - A read that arrives while another thread is already fetching the same
+ *     range waits for that fetch instead of starting a second one.
+ *   - Writes made through the cache invalidate the ranges they affect: the
+ *     range itself and any range linked to the written registers (e.g. the
+ *     monitor block is linked to the control and frequency registers).
+ *
+ * All bus access made through the cache is serialized, so one context can be
+ * shared by several threads as long as they all go through the cache.
+ */
+
+#ifndef REG_CACHE_H
+#define REG_CACHE_H
+
+#include <stdint.h>
+#include <modbus.h>
+
+#define REG_CACHE_MAX_RANGES  8     ///< Cached ranges per cache
+#define REG_CACHE_MAX_LINKS   4     ///< Invalidating register blocks per range
+
+typedef struct reg_cache reg_cache_t;
+
+/**
+ * @brief Cache counters.
+ */
+typedef struct {
+    unsigned long hits;             ///< Reads answered from a fresh copy
+    unsigned long misses;           ///< Reads that went to the bus
+    unsigned long collapsed;        ///< Reads that shared a fetch already in flight
+    unsigned long uncached;         ///< Reads outside any range, passed through
+    unsigned long invalidations;    ///< Ranges dropped because of a write
+} reg_cache_stats_t;
+
+/**
+ * @brief Creates a cache for a connected context. The context stays owned by the caller.
+ * @return The cache, or NULL if allocation fails.
+ */
+reg_cache_t *reg_cache_new(modbus_t *ctx);
+
+/**
+ * @brief Frees the cache (not the context).
+ */
+void reg_cache_free(reg_cache_t *cache);
+
+/**
+ * @brief Declares a cached register range.
+ * @param ttl_ms How long a fetched copy may be served.
+ * @return Range id, or -1 if the arguments are invalid or the table is full.
+ */
+int reg_cache_add_range(reg_cache_t *cache, int addr, int count, int ttl_ms);
+
+/**
+ * @brief Makes writes to [addr, addr + count) invalidate a range.
+ * @return 0 on success, -1 if the range id is invalid or has too many links.
+ */
+int reg_cache_link(reg_cache_t *cache, int range_id, int addr, int count);
+
+/**
+ * @brief Reads holding registers, from the cache when possible.
+ * @return Number of registers read, or -1 with errno set (as modbus_read_registers()).
+ */
+int reg_cache_read(reg_cache_t *cache, int addr, int count, uint16_t *dest);
+
+/**
+ * @brief Writes one holding register and invalidates the ranges it affects.
+ * @return 1 on success, -1 with errno set (as modbus_write_register()).
+ */
+int reg_cache_write_register(reg_cache_t *cache, int addr, uint16_t value);
+
+/**
+ * @brief Writes a block of holding registers and invalidates the ranges it affects.
+ * @return Number of registers written, or -1 with errno set.
+ */
+int reg_cache_write_registers(reg_cache_t *cache, int addr, int count, const uint16_t *values);
+
+/**
+ * @brief Drops every range overlapping, or linked to, [addr, addr + count).
+ */
+void reg_cache_invalidate(reg_cache_t *cache, int addr, int count);
+
+/**
+ * @brief Copies the current counters.
+ */
+void reg_cache_get_stats(reg_cache_t *cache, reg_cache_stats_t *stats);
+
+#endif // REG_CACHE_H
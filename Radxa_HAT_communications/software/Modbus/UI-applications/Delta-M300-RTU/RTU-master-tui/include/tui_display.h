@@ -23,20 +23,23 @@ void cleanup_tui(void);
 
 /**
  * @brief Draws the user interface.
- * Renders setpoints, telemetry, system status, and instructions.
+ * Renders setpoints, telemetry, ramp timing, system status, and instructions.
  * * @param sp Pointer to current setpoints.
  * @param tlm Pointer to current telemetry.
+ * @param rc Pointer to the ramp state.
  */
-void draw_ui(const setpoint_t *sp, const telemetry_t *tlm);
+void draw_ui(const setpoint_t *sp, const telemetry_t *tlm, const ramp_ctl_t *rc);
 
 /**
  * @brief Processes keyboard input.
- * Handles 'q', '1', '2', and Arrow keys.
- * * @param ctx Modbus context (needed to send commands immediately).
+ * Handles 'q', '1', '2', Arrow keys and the ramp keys 'r', 'p' and 'g'.
+ * * @param cache Register cache (needed to send commands immediately).
  * @param sp Pointer to setpoints (to update desired state).
  * @param tlm Pointer to telemetry (to update status messages).
+ * @param rc Pointer to the ramp state (arrow keys start ramps in ramp mode).
  * @param keep_running Pointer to the main loop control flag.
  */
-void process_input(modbus_t *ctx, setpoint_t *sp, telemetry_t *tlm, volatile int *keep_running);
+void process_input(reg_cache_t *cache, setpoint_t *sp, telemetry_t *tlm, ramp_ctl_t *rc,
+                   volatile int *keep_running);
 
 #endif // TUI_DISPLAY_H
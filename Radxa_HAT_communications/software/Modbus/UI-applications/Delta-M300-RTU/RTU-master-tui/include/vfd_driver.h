@@ -10,6 +10,8 @@
 
 /**
  * @brief Initializes the Modbus RTU connection.
+ * * Also creates the read cache: the monitor block is cached for MONITOR_TTL_MS
+ * and dropped whenever the control word or the frequency command is written.
  * * @param conf Pointer to the configuration structure.
  * @return int 0 on success, -1 on failure.
  */
@@ -18,28 +20,54 @@ int init_modbus_connection(modbus_config_t *conf);
 /**
  * @brief Reads telemetry data from the VFD.
  * * Reads a block of registers starting at REG_MONITOR_START.
- * Updates the telemetry_t structure with parsed values.
- * * @param ctx Modbus context.
+ * Updates the telemetry_t structure with parsed values and the cache counters.
+ * * @param cache Register cache wrapping the Modbus context.
  * @param tlm Pointer to the telemetry structure to update.
  */
-void update_telemetry(modbus_t *ctx, telemetry_t *tlm);
+void update_telemetry(reg_cache_t *cache, telemetry_t *tlm);
 
 /**
  * @brief Sends the control word (Run/Stop/Direction) to the VFD.
  * * Constructs the bitmask based on setpoint state and writes to REG_CONTROL_WORD.
- * * @param ctx Modbus context.
+ * * @param cache Register cache wrapping the Modbus context.
  * @param sp Pointer to current setpoints.
  * @param tlm Pointer to telemetry (to update error/status messages).
  */
-void send_control_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm);
+void send_control_command(reg_cache_t *cache, const setpoint_t *sp, telemetry_t *tlm);
 
 /**
  * @brief Sends the frequency command to the VFD.
  * * Writes the target frequency to REG_FREQ_CMD.
- * * @param ctx Modbus context.
+ * * @param cache Register cache wrapping the Modbus context.
  * @param sp Pointer to current setpoints.
  * @param tlm Pointer to telemetry (to update error/status messages).
  */
-void send_freq_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm);
+void send_freq_command(reg_cache_t *cache, const setpoint_t *sp, telemetry_t *tlm);
+
+/**
+ * @brief Starts playing a frequency profile (in Hz).
+ * * Steps are written by service_freq_ramp(); a running ramp is replaced.
+ * @param rc Ramp state.
+ * @param profile Profile to play, every value within 0-60 Hz.
+ */
+void start_freq_ramp(ramp_ctl_t *rc, const ramp_profile_t *profile);
+
+/**
+ * @brief Starts a ramp from the last written frequency to the target frequency.
+ * * Uses the shape selected in rc at an average rate of RAMP_RATE_HZ_S.
+ * @param rc Ramp state.
+ * @param sp Pointer to current setpoints.
+ */
+void ramp_to_target(ramp_ctl_t *rc, const setpoint_t *sp);
+
+/**
+ * @brief Writes the ramp step that is due, if any.
+ * * Call it at least once per RAMP_PERIOD_MS; a call that comes later than
+ * one period skips the overrun steps (counted as missed in rc->ramp).
+ * @param cache Register cache wrapping the Modbus context.
+ * @param rc Ramp state.
+ * @param tlm Pointer to telemetry (to update error/status messages).
+ */
+void service_freq_ramp(reg_cache_t *cache, ramp_ctl_t *rc, telemetry_t *tlm);
 
 #endif // VFD_DRIVER_H
@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <signal.h>
 #include <ncurses.h>
+#include <time.h>
 
 #include "common.h"
 #include "mqtt_driver.h"
@@ -30,7 +31,7 @@ void handle_shutdown(int signum) {
     keep_running = 0;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     modbus_config_t modbus_conf;
 
     MQTTClient client;
@@ -41,62 +42,99 @@ int main() {
     // State instances
     setpoint_t sp = { .run_state = false, .direction = false, .target_freq = 0 };
     telemetry_t tlm = {0};
+    ramp_ctl_t rc = { .shape = RAMP_SCURVE };
+    bool compact = false;
+    int opt;
+
+    // -c: compact MQTT session (birth/death certificates, binary samples)
+    while ((opt = getopt(argc, argv, "c")) != -1) {
+        if (opt == 'c') {
+            compact = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-c] [DEVICE] [PROFILE]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
 
     // Register Signals
     signal(SIGINT, handle_shutdown);
     signal(SIGTERM, handle_shutdown);
 
     // Modbus Configuration 
-    modbus_conf.device = "/dev/ttyS4";
+    modbus_conf.device = (argc > 1) ? argv[1] : "/dev/ttyS4";
     modbus_conf.baud = 38400;
     modbus_conf.parity = 'N';
     modbus_conf.data_bit = 8;
     modbus_conf.stop_bit = 1;
     modbus_conf.slave_id = 2;   
 
+    // Optional frequency profile played with 'g' (see ramp.h)
+    if (argc > 2) {
+        double min_hz, max_hz;
+        rc.script = argv[2];
+        if (ramp_parse(&rc.script_profile, rc.script) == -1) {
+            fprintf(stderr, "Invalid profile '%s'\n", rc.script);
+            return EXIT_FAILURE;
+        }
+        ramp_bounds(&rc.script_profile, &min_hz, &max_hz);
+        if (min_hz < 0 || max_hz > 60) {
+            fprintf(stderr, "Profile frequencies must be within 0-60 Hz\n");
+            return EXIT_FAILURE;
+        }
+    }
+
     // Initialize Modbus
     if (init_modbus_connection(&modbus_conf) != 0) {
         return EXIT_FAILURE;
     }
     
     // Initialize MQTT
-    if (init_mqtt_client(&client, &conn_opts) != EXIT_SUCCESS) {
+    if (init_mqtt_client(&client, &conn_opts, compact) != EXIT_SUCCESS) {
         return EXIT_FAILURE;
     }
     
     // Initialize UI
     init_tui();
 
-    uint8_t cycle_count = 0;
+    int64_t next_telemetry = ramp_now_ns();
 
     // Main Loop
     while (keep_running) {
         // 1. Process User Input
         // Note: Cast keep_running to non-atomic int pointer or handle inside carefully.
         // Here we pass the address of the volatile variable.
-        process_input(modbus_conf.ctx, &sp, &tlm, (int *)&keep_running);
+        process_input(modbus_conf.cache, &sp, &tlm, &rc, (int *)&keep_running);
+
+        // 2. Write the ramp step that is due
+        service_freq_ramp(modbus_conf.cache, &rc, &tlm);
 
-        // 2. Read Telemetry (approx every 200ms)
-        if (cycle_count++ > 10) {
-            update_telemetry(modbus_conf.ctx, &tlm);
+        // 3. Read Telemetry (every TELEMETRY_MS)
+        int64_t now = ramp_now_ns();
+        if (now >= next_telemetry) {
+            update_telemetry(modbus_conf.cache, &tlm);
             publish_telemetry(&client, &pubmsg, &token, &tlm);
-            cycle_count = 0;
+            next_telemetry = now + (int64_t)TELEMETRY_MS * 1000000;
         }
 
-        // 3. Draw Interface
-        draw_ui(&sp, &tlm);
+        // 4. Draw Interface
+        draw_ui(&sp, &tlm, &rc);
 
-        // 4. Sleep to save CPU
-        napms(20); // 20ms
+        // 5. Sleep 20 ms to save CPU, or until the next ramp step is due
+        int64_t wake = ramp_now_ns() + 20000000;
+        if (rc.active && ramp_due_ns(&rc.ramp) < wake) wake = ramp_due_ns(&rc.ramp);
+        ramp_sleep_until(wake);
     }
 
     // Cleanup UI
     cleanup_tui();
     
     // Safety: Stop motor on exit
-    modbus_write_register(modbus_conf.ctx, REG_CONTROL_WORD, CMD_STOP);
+    reg_cache_write_register(modbus_conf.cache, REG_CONTROL_WORD, CMD_STOP);
     
     // Cleanup Modbus
+    reg_cache_free(modbus_conf.cache);
     modbus_close(modbus_conf.ctx);
     modbus_free(modbus_conf.ctx);
 
@@ -6,15 +6,161 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "mqtt_driver.h"
 
+/**
+ * @brief Value types of the compact session, as named in the birth message.
+ */
+typedef enum {
+    METRIC_FLOAT,   ///< IEEE 754 float32, big-endian (4 bytes)
+    METRIC_UINT16,  ///< Big-endian (2 bytes)
+    METRIC_UINT8,   ///< 1 byte
+    METRIC_BOOL     ///< 1 byte, 0 or 1
+} metric_type_t;
+
+/**
+ * @brief Metric published in compact mode. The alias replaces the name
+ * in the data messages.
+ */
+typedef struct {
+    const char *name;
+    uint8_t alias;
+    metric_type_t type;
+} metric_def_t;
+
+static const metric_def_t metrics[] = {
+    { "current_amp",   1, METRIC_FLOAT  },
+    { "voltage_v",     2, METRIC_FLOAT  },
+    { "rpm",           3, METRIC_UINT16 },
+    { "freq_out",      4, METRIC_FLOAT  },
+    { "comm_error",    5, METRIC_BOOL   },
+    { "last_msg_code", 6, METRIC_UINT8  },
+};
+#define N_METRICS (sizeof(metrics) / sizeof(metrics[0]))
+
+static const char *const type_names[] = { "float", "uint16", "uint8", "bool" };
+
+// Compact session state
+static bool compact_mode = false;
+static unsigned long session_id;        ///< Connect time, shared by the birth and death messages
+static uint8_t data_seq;                ///< Sequence of the last message, 0 is the birth
+static char death_payload[64];          ///< Will and clean-disconnect payload
+
+/**
+ * @brief Value of a metric as a double (for the birth message).
+ */
+static double metric_value(const metric_def_t *m, const telemetry_t *tlm) {
+    switch (m->alias) {
+    case 1: return tlm->current_amp;
+    case 2: return tlm->voltage_v;
+    case 3: return tlm->rpm;
+    case 4: return tlm->freq_out;
+    case 5: return tlm->comm_error ? 1 : 0;
+    default: return tlm->last_msg_code;
+    }
+}
+
+/**
+ * @brief Appends the alias and value of a metric to a data message.
+ * @return Number of bytes written.
+ */
+static int encode_metric(uint8_t *p, const metric_def_t *m, const telemetry_t *tlm) {
+    double v = metric_value(m, tlm);
+    uint32_t bits;
+    float f;
+    int n = 0;
+
+    p[n++] = m->alias;
+    switch (m->type) {
+    case METRIC_FLOAT:
+        f = (float)v;
+        memcpy(&bits, &f, sizeof(bits));
+        p[n++] = bits >> 24;
+        p[n++] = bits >> 16;
+        p[n++] = bits >> 8;
+        p[n++] = bits;
+        break;
+    case METRIC_UINT16:
+        p[n++] = (uint16_t)v >> 8;
+        p[n++] = (uint16_t)v & 0xFF;
+        break;
+    case METRIC_UINT8:
+    case METRIC_BOOL:
+        p[n++] = (uint8_t)v;
+        break;
+    }
+    return n;
+}
+
+/**
+ * @brief Publishes a message and waits until the broker has it.
+ * @return int EXIT_SUCCESS on success, EXIT_FAILURE on error.
+ */
+static int publish_and_wait(MQTTClient *client, MQTTClient_message *pubmsg, MQTTClient_deliveryToken *token,
+                            const char *topic, void *payload, int len, int retained) {
+    int rc;
+
+    pubmsg->payload = payload;
+    pubmsg->payloadlen = len;
+    pubmsg->qos = QOS;
+    pubmsg->retained = retained;
+
+    if ((rc = MQTTClient_publishMessage(*client, topic, pubmsg, token)) != MQTTCLIENT_SUCCESS)
+    {
+        printf("Failed to start publishing, code: %d\n", rc);
+        return EXIT_FAILURE;
+    }
+
+    // Wait for confirmation from broker
+    rc = MQTTClient_waitForCompletion(*client, *token, TIMEOUT);
+    if (rc != MQTTCLIENT_SUCCESS) {
+        printf("Failed to complete publishing, code: %d\n", rc);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Publishes the birth certificate of a compact session: the alias,
+ * type and current value of every metric, retained on TOPIC_BIRTH.
+ */
+static int publish_birth(MQTTClient *client, MQTTClient_message *pubmsg, MQTTClient_deliveryToken *token,
+                         const telemetry_t *tlm) {
+    static char payload[512];
+    size_t len;
+
+    len = (size_t)snprintf(payload, sizeof(payload), "{\"session\":%lu,\"seq\":0,\"metrics\":[", session_id);
+    for (size_t i = 0; i < N_METRICS && len < sizeof(payload); i++) {
+        len += (size_t)snprintf(payload + len, sizeof(payload) - len,
+                                "%s{\"name\":\"%s\",\"alias\":%u,\"type\":\"%s\",\"value\":%g}",
+                                i ? "," : "", metrics[i].name, metrics[i].alias,
+                                type_names[metrics[i].type], metric_value(&metrics[i], tlm));
+    }
+    if (len < sizeof(payload)) {
+        len += (size_t)snprintf(payload + len, sizeof(payload) - len, "]}");
+    }
+    if (len >= sizeof(payload)) {
+        printf("Birth message too long\n");
+        return EXIT_FAILURE;
+    }
+
+    data_seq = 0;
+    return publish_and_wait(client, pubmsg, token, TOPIC_BIRTH, payload, (int)len, 1);
+}
+
 /**
  * @brief Initializes the MQTT client and connects to the broker.
+ * In compact mode the death certificate is registered as the last will,
+ * so the broker marks the drive offline if the connection is lost.
  * @param client Pointer to MQTTClient instance.
  * @param conn_opts Pointer to MQTTClient_connectOptions structure.
+ * @param compact true for the compact session, false for JSON telemetry.
  * @return int EXIT_SUCCESS on success, EXIT_FAILURE on error.
  */
-int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts){
+int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts, bool compact){
+    static MQTTClient_willOptions will_opts = MQTTClient_willOptions_initializer;
     int rc;
 
     // Create the client instance
@@ -31,6 +177,19 @@ int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts){
     conn_opts->reliable = 1;
     conn_opts->connectTimeout = 10;
 
+    compact_mode = compact;
+    if (compact_mode) {
+        // The birth and death of one session carry the same id: the drive is
+        // online while the retained birth is newer than the retained death
+        session_id = (unsigned long)time(NULL);
+        snprintf(death_payload, sizeof(death_payload), "{\"session\":%lu}", session_id);
+        will_opts.topicName = TOPIC_DEATH;
+        will_opts.message = death_payload;
+        will_opts.retained = 1;
+        will_opts.qos = QOS;
+        conn_opts->will = &will_opts;
+    }
+
     // Connect to the Broker (client is already MQTTClient*, dereference it)
     if ((rc = MQTTClient_connect(*client, conn_opts)) != MQTTCLIENT_SUCCESS)
     {
@@ -45,7 +204,9 @@ int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts){
 
 /**
  * @brief Publishes telemetry data to the MQTT broker.
- * Formats telemetry as JSON and sends to the telemetry topic.
+ * Formats telemetry as JSON and sends to the telemetry topic. In compact
+ * mode the first call publishes the birth message, and every call sends
+ * the sequence number and the alias/value pairs in binary on TOPIC_DATA.
  * @param client Pointer to MQTTClient instance.
  * @param pubmsg Pointer to MQTTClient_message structure.
  * @param token Pointer to MQTTClient_deliveryToken for tracking delivery.
@@ -53,10 +214,30 @@ int init_mqtt_client(MQTTClient *client, MQTTClient_connectOptions *conn_opts){
  * @return int EXIT_SUCCESS on success, EXIT_FAILURE on error.
  */
 int publish_telemetry(MQTTClient *client, MQTTClient_message *pubmsg, MQTTClient_deliveryToken *token, telemetry_t *tlm) {
-    int rc;
-    
     // Prepare the message (Payload) - use static to persist beyond function scope
     static char payload0[254];
+    static uint8_t data[1 + N_METRICS * 5];
+    static bool born = false;
+
+    if (compact_mode) {
+        int len = 0;
+
+        if (!born) {
+            if (publish_birth(client, pubmsg, token, tlm) != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+            born = true;
+        }
+
+        // Sequence 0 belongs to the birth, so data messages wrap from 255 to 1
+        data_seq = (data_seq == 255) ? 1 : data_seq + 1;
+        data[len++] = data_seq;
+        for (size_t i = 0; i < N_METRICS; i++) {
+            len += encode_metric(data + len, &metrics[i], tlm);
+        }
+        return publish_and_wait(client, pubmsg, token, TOPIC_DATA, data, len, 0);
+    }
+
     snprintf(payload0, sizeof(payload0),
              "{\"current_amp\": %.2f, \"voltage_v\": %.2f, \"rpm\": %d, \"freq_out\": %.2f, \"comm_error\": %d, \"last_msg_code\": %d}",
              tlm->current_amp,
@@ -66,36 +247,25 @@ int publish_telemetry(MQTTClient *client, MQTTClient_message *pubmsg, MQTTClient
              tlm->comm_error ? 1 : 0,
              tlm->last_msg_code);
 
-    pubmsg->payload = payload0;
-    pubmsg->payloadlen = (int)strlen(payload0);
-    pubmsg->qos = QOS;
-    pubmsg->retained = 0;
-
-    // Publish (dereference client pointer)
-    if ((rc = MQTTClient_publishMessage(*client, TOPIC_TELEMETRY, pubmsg, token)) != MQTTCLIENT_SUCCESS)
-    {
-        printf("Failed to start publishing, code: %d\n", rc);
-        return EXIT_FAILURE;
-    }
-    
-    // Wait for confirmation from broker
-    rc = MQTTClient_waitForCompletion(*client, *token, TIMEOUT);
-    if (rc != MQTTCLIENT_SUCCESS) {
-        printf("Failed to complete publishing, code: %d\n", rc);
-        return EXIT_FAILURE;
-    }
-
-    return EXIT_SUCCESS;
+    return publish_and_wait(client, pubmsg, token, TOPIC_TELEMETRY, payload0, (int)strlen(payload0), 0);
 }
 
 /**
  * @brief Disconnects the MQTT client and cleans up resources.
+ * In compact mode the death certificate is published first, since the
+ * broker discards the last will on a clean disconnect.
  * @param client Pointer to MQTTClient instance.
  * @return int EXIT_SUCCESS always.
  */
 int mqtt_disconnect(MQTTClient *client){
     int rc;
 
+    if (compact_mode) {
+        MQTTClient_message msg = MQTTClient_message_initializer;
+        MQTTClient_deliveryToken token;
+        publish_and_wait(client, &msg, &token, TOPIC_DEATH, death_payload, (int)strlen(death_payload), 1);
+    }
+
     // Disconnect (dereference client pointer)
     if ((rc = MQTTClient_disconnect(*client, 10000)) != MQTTCLIENT_SUCCESS)
     {
@@ -0,0 +1,242 @@
+/**
+ * @file reg_cache.c
+ * @brief Implementation of the holding register TTL cache.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "reg_cache.h"
+
+typedef struct {
+    int addr;
+    int count;
+} reg_block_t;
+
+typedef struct {
+    reg_block_t block;
+    int ttl_ms;
+    uint16_t data[MODBUS_MAX_READ_REGISTERS];
+    bool valid;                     ///< data may be served until fetched_ms + ttl_ms
+    uint64_t fetched_ms;
+    bool inflight;                  ///< A thread is reading this range from the bus
+    bool stale;                     ///< Invalidated while in flight, don't keep the result
+    unsigned int fetch_gen;         ///< Bumped when a fetch completes
+    int fetch_rc;                   ///< Result of the last fetch, for collapsed readers
+    int fetch_errno;
+    reg_block_t links[REG_CACHE_MAX_LINKS];
+    int n_links;
+} cache_range_t;
+
+struct reg_cache {
+    modbus_t *ctx;
+    pthread_mutex_t lock;           ///< Protects ranges and stats
+    pthread_cond_t fetched;         ///< Signalled when a fetch completes
+    pthread_mutex_t bus_lock;       ///< Serializes use of ctx
+    cache_range_t ranges[REG_CACHE_MAX_RANGES];
+    int n_ranges;
+    reg_cache_stats_t stats;
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static bool overlaps(const reg_block_t *b, int addr, int count) {
+    return addr < b->addr + b->count && b->addr < addr + count;
+}
+
+reg_cache_t *reg_cache_new(modbus_t *ctx) {
+    reg_cache_t *cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) return NULL;
+
+    cache->ctx = ctx;
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_mutex_init(&cache->bus_lock, NULL);
+    pthread_cond_init(&cache->fetched, NULL);
+    return cache;
+}
+
+void reg_cache_free(reg_cache_t *cache) {
+    if (cache == NULL) return;
+    pthread_cond_destroy(&cache->fetched);
+    pthread_mutex_destroy(&cache->bus_lock);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+int reg_cache_add_range(reg_cache_t *cache, int addr, int count, int ttl_ms) {
+    if (addr < 0 || count < 1 || count > MODBUS_MAX_READ_REGISTERS || addr + count > 65536 ||
+        ttl_ms < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    int id = cache->n_ranges;
+    if (id < REG_CACHE_MAX_RANGES) {
+        cache_range_t *r = &cache->ranges[id];
+        memset(r, 0, sizeof(*r));
+        r->block.addr = addr;
+        r->block.count = count;
+        r->ttl_ms = ttl_ms;
+        cache->n_ranges++;
+    } else {
+        id = -1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return id;
+}
+
+int reg_cache_link(reg_cache_t *cache, int range_id, int addr, int count) {
+    int rc = -1;
+
+    pthread_mutex_lock(&cache->lock);
+    if (range_id >= 0 && range_id < cache->n_ranges && count > 0) {
+        cache_range_t *r = &cache->ranges[range_id];
+        if (r->n_links < REG_CACHE_MAX_LINKS) {
+            r->links[r->n_links].addr = addr;
+            r->links[r->n_links].count = count;
+            r->n_links++;
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return rc;
+}
+
+/**
+ * @brief Finds the first range that fully contains [addr, addr + count).
+ * Caller holds the cache lock.
+ */
+static cache_range_t *find_range(reg_cache_t *cache, int addr, int count) {
+    for (int i = 0; i < cache->n_ranges; i++) {
+        const reg_block_t *b = &cache->ranges[i].block;
+        if (addr >= b->addr && addr + count <= b->addr + b->count) return &cache->ranges[i];
+    }
+    return NULL;
+}
+
+int reg_cache_read(reg_cache_t *cache, int addr, int count, uint16_t *dest) {
+    pthread_mutex_lock(&cache->lock);
+    cache_range_t *r = find_range(cache, addr, count);
+
+    if (r == NULL) {
+        cache->stats.uncached++;
+        pthread_mutex_unlock(&cache->lock);
+
+        pthread_mutex_lock(&cache->bus_lock);
+        int rc = modbus_read_registers(cache->ctx, addr, count, dest);
+        pthread_mutex_unlock(&cache->bus_lock);
+        return rc;
+    }
+
+    int offset = addr - r->block.addr;
+
+    if (r->valid && now_ms() - r->fetched_ms < (uint64_t)r->ttl_ms) {
+        memcpy(dest, &r->data[offset], (size_t)count * sizeof(uint16_t));
+        cache->stats.hits++;
+        pthread_mutex_unlock(&cache->lock);
+        return count;
+    }
+
+    if (r->inflight) {
+        // Share the fetch that is already on the bus
+        unsigned int gen = r->fetch_gen;
+        while (r->inflight && r->fetch_gen == gen) {
+            pthread_cond_wait(&cache->fetched, &cache->lock);
+        }
+        cache->stats.collapsed++;
+        int rc = r->fetch_rc;
+        if (rc == -1) {
+            errno = r->fetch_errno;
+        } else {
+            memcpy(dest, &r->data[offset], (size_t)count * sizeof(uint16_t));
+            rc = count;
+        }
+        pthread_mutex_unlock(&cache->lock);
+        return rc;
+    }
+
+    r->inflight = true;
+    r->stale = false;
+    cache->stats.misses++;
+    pthread_mutex_unlock(&cache->lock);
+
+    uint16_t buf[MODBUS_MAX_READ_REGISTERS];
+    pthread_mutex_lock(&cache->bus_lock);
+    int rc = modbus_read_registers(cache->ctx, r->block.addr, r->block.count, buf);
+    int err = errno;
+    pthread_mutex_unlock(&cache->bus_lock);
+
+    pthread_mutex_lock(&cache->lock);
+    r->inflight = false;
+    r->fetch_gen++;
+    r->fetch_rc = rc;
+    r->fetch_errno = err;
+    if (rc != -1) {
+        memcpy(r->data, buf, (size_t)r->block.count * sizeof(uint16_t));
+        // A write that raced with this read may not be reflected in buf
+        r->valid = !r->stale;
+        r->fetched_ms = now_ms();
+        memcpy(dest, &buf[offset], (size_t)count * sizeof(uint16_t));
+        rc = count;
+    } else {
+        r->valid = false;
+    }
+    pthread_cond_broadcast(&cache->fetched);
+    pthread_mutex_unlock(&cache->lock);
+
+    errno = err;
+    return rc;
+}
+
+void reg_cache_invalidate(reg_cache_t *cache, int addr, int count) {
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->n_ranges; i++) {
+        cache_range_t *r = &cache->ranges[i];
+        bool hit = overlaps(&r->block, addr, count);
+        for (int l = 0; l < r->n_links && !hit; l++) {
+            hit = overlaps(&r->links[l], addr, count);
+        }
+        if (!hit) continue;
+
+        if (r->valid || r->inflight) cache->stats.invalidations++;
+        r->valid = false;
+        if (r->inflight) r->stale = true;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int reg_cache_write_register(reg_cache_t *cache, int addr, uint16_t value) {
+    pthread_mutex_lock(&cache->bus_lock);
+    int rc = modbus_write_register(cache->ctx, addr, value);
+    int err = errno;
+    pthread_mutex_unlock(&cache->bus_lock);
+
+    // Even a failed write may have reached the drive
+    reg_cache_invalidate(cache, addr, 1);
+    errno = err;
+    return rc;
+}
+
+int reg_cache_write_registers(reg_cache_t *cache, int addr, int count, const uint16_t *values) {
+    pthread_mutex_lock(&cache->bus_lock);
+    int rc = modbus_write_registers(cache->ctx, addr, count, values);
+    int err = errno;
+    pthread_mutex_unlock(&cache->bus_lock);
+
+    reg_cache_invalidate(cache, addr, count);
+    errno = err;
+    return rc;
+}
+
+void reg_cache_get_stats(reg_cache_t *cache, reg_cache_stats_t *stats) {
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
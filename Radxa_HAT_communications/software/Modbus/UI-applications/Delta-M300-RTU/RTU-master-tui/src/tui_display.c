@@ -21,7 +21,7 @@ void cleanup_tui(void) {
     endwin(); // Restore terminal settings
 }
 
-void draw_ui(const setpoint_t *sp, const telemetry_t *tlm) {
+void draw_ui(const setpoint_t *sp, const telemetry_t *tlm, const ramp_ctl_t *rc) {
     clear();
     box(stdscr, 0, 0);
 
@@ -54,17 +54,32 @@ void draw_ui(const setpoint_t *sp, const telemetry_t *tlm) {
     } else {
         mvprintw(10, 4, "Modbus Link: OK");
     }
+    mvprintw(10, 42, "Cache      : %lu hit / %lu miss", tlm->cache_hits, tlm->cache_misses);
     mvprintw(11, 4, "Log: %s", tlm->last_msg);
 
+    // Section: Ramp (timing of the current or last ramp)
+    const ramp_stats_t *st = &rc->ramp.stats;
+    mvprintw(13, 2, "---- RAMP ----");
+    mvprintw(14, 4, "Mode: %s  Shape: %s  %s", rc->enabled ? "ON " : "OFF",
+             rc->shape == RAMP_SCURVE ? "S-CURVE" : "LINEAR",
+             rc->active ? "RUNNING" : rc->ramp.n_steps > 0 ? "DONE" : "");
+    if (st->steps > 0) {
+        mvprintw(15, 4, "Steps %lu/%ld  Late avg %.2f / max %.2f ms  Missed %lu  Err %lu",
+                 st->steps, rc->ramp.n_steps, st->late_sum_ms / st->steps, st->late_max_ms,
+                 st->missed, st->errors);
+    }
+
     // Section: Footer / Instructions
     attron(A_REVERSE);
-    mvprintw(13, 2, " [1] Start/Stop | [2] Fwd/Rev | [ARROWS] Adjust Freq | [q] Quit ");
+    mvprintw(17, 2, " [1] Start/Stop | [2] Fwd/Rev | [ARROWS] Adjust Freq | [q] Quit ");
+    mvprintw(18, 2, " [r] Ramp Mode | [p] Ramp Shape | [g] Play Profile ");
     attroff(A_REVERSE);
 
     refresh();
 }
 
-void process_input(modbus_t *ctx, setpoint_t *sp, telemetry_t *tlm, volatile int *keep_running) {
+void process_input(reg_cache_t *cache, setpoint_t *sp, telemetry_t *tlm, ramp_ctl_t *rc,
+                   volatile int *keep_running) {
     int ch = getch();
 
     if (ch == ERR) return; // No key pressed
@@ -107,9 +122,40 @@ void process_input(modbus_t *ctx, setpoint_t *sp, telemetry_t *tlm, volatile int
              if (sp->target_freq < 0) sp->target_freq = 0;
              freq_changed = true;
              break;
+        case 'r': // Toggle ramp mode (leaving it stops a running ramp)
+        case 'R':
+            rc->enabled = !rc->enabled;
+            if (!rc->enabled && rc->active) {
+                ramp_stop(&rc->ramp);
+                rc->active = false;
+            }
+            snprintf(tlm->last_msg, 64, "Ramp mode %s", rc->enabled ? "ON" : "OFF");
+            break;
+        case 'p': // Toggle ramp shape
+        case 'P':
+            rc->shape = rc->shape == RAMP_LINEAR ? RAMP_SCURVE : RAMP_LINEAR;
+            break;
+        case 'g': // Play the profile given on the command line
+        case 'G':
+            if (rc->script == NULL) {
+                snprintf(tlm->last_msg, 64, "No profile given (2nd argument)");
+            } else {
+                start_freq_ramp(rc, &rc->script_profile);
+                snprintf(tlm->last_msg, 64, "Playing %.50s", rc->script);
+            }
+            break;
     }
 
     // Only write to Modbus if state changed (reduces traffic)
-    if (cmd_changed) send_control_command(ctx, sp, tlm);
-    if (freq_changed) send_freq_command(ctx, sp, tlm);
+    if (cmd_changed) send_control_command(cache, sp, tlm);
+    if (freq_changed && rc->enabled) {
+        ramp_to_target(rc, sp);
+    } else if (freq_changed) {
+        if (rc->active) {
+            ramp_stop(&rc->ramp);
+            rc->active = false;
+        }
+        send_freq_command(cache, sp, tlm);
+        if (tlm->last_msg_code == SET_FREQ) rc->written_freq = sp->target_freq;
+    }
 }
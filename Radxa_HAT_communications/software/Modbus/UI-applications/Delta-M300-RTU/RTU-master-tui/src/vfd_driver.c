@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
 #include "vfd_driver.h"
 
 int init_modbus_connection(modbus_config_t *conf) {
@@ -30,12 +31,28 @@ int init_modbus_connection(modbus_config_t *conf) {
         return -1;
     }
 
+    // Cache the monitor block; any write to 0x2000-0x2001 changes what it reports
+    conf->cache = reg_cache_new(conf->ctx);
+    int monitor = conf->cache ? reg_cache_add_range(conf->cache, REG_MONITOR_START, MONITOR_LEN, MONITOR_TTL_MS) : -1;
+    if (monitor == -1 || reg_cache_link(conf->cache, monitor, REG_CONTROL_WORD, 2) == -1) {
+        fprintf(stderr, "Unable to create register cache\n");
+        reg_cache_free(conf->cache);
+        modbus_close(conf->ctx);
+        modbus_free(conf->ctx);
+        return -1;
+    }
+
     return 0;
 }
 
-void update_telemetry(modbus_t *ctx, telemetry_t *tlm) {
-    int rc = modbus_read_registers(ctx, REG_MONITOR_START, MONITOR_LEN, tlm->raw_buffer);
-    
+void update_telemetry(reg_cache_t *cache, telemetry_t *tlm) {
+    int rc = reg_cache_read(cache, REG_MONITOR_START, MONITOR_LEN, tlm->raw_buffer);
+
+    reg_cache_stats_t stats;
+    reg_cache_get_stats(cache, &stats);
+    tlm->cache_hits = stats.hits + stats.collapsed;
+    tlm->cache_misses = stats.misses;
+
     if (rc == -1) {
         tlm->comm_error = true;
         snprintf(tlm->last_msg, 64, "ERR: Read Timeout/Fail");
@@ -55,7 +72,7 @@ void update_telemetry(modbus_t *ctx, telemetry_t *tlm) {
     tlm->rpm         = tlm->raw_buffer[9];         
 }
 
-void send_control_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm) {
+void send_control_command(reg_cache_t *cache, const setpoint_t *sp, telemetry_t *tlm) {
     // Construct Control Byte for MS300
     // Bits 0-1: 10 (2) Run, 01 (1) Stop
     uint16_t cmd_val = 0;
@@ -73,7 +90,7 @@ void send_control_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm)
         cmd_val |= (1 << 5); 
     }
     
-    if (modbus_write_register(ctx, REG_CONTROL_WORD, cmd_val) == -1) {
+    if (reg_cache_write_register(cache, REG_CONTROL_WORD, cmd_val) == -1) {
         tlm->comm_error = true;
         tlm->last_msg_code = COMM_FAIL;
         snprintf(tlm->last_msg, 64, "ERR: Write CMD Fail");
@@ -86,8 +103,8 @@ void send_control_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm)
     }
 }
 
-void send_freq_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm) {
-    if (modbus_write_register(ctx, REG_FREQ_CMD, sp->target_freq) == -1) {
+void send_freq_command(reg_cache_t *cache, const setpoint_t *sp, telemetry_t *tlm) {
+    if (reg_cache_write_register(cache, REG_FREQ_CMD, sp->target_freq) == -1) {
         tlm->comm_error = true;
         tlm->last_msg_code = COMM_FREQ_FAIL;
         snprintf(tlm->last_msg, 64, "ERR: Write Freq Fail");
@@ -97,3 +114,44 @@ void send_freq_command(modbus_t *ctx, const setpoint_t *sp, telemetry_t *tlm) {
         snprintf(tlm->last_msg, 64, "Set Freq: %.2f Hz", sp->target_freq / 100.0);
     }
 }
+
+void start_freq_ramp(ramp_ctl_t *rc, const ramp_profile_t *profile) {
+    ramp_start(&rc->ramp, profile, RAMP_PERIOD_MS, ramp_now_ns());
+    rc->active = true;
+}
+
+void ramp_to_target(ramp_ctl_t *rc, const setpoint_t *sp) {
+    ramp_profile_t profile = { .shape = rc->shape, .n_points = 2 };
+
+    profile.v[0] = rc->written_freq / 100.0;
+    profile.v[1] = sp->target_freq / 100.0;
+    profile.t[1] = fabs(profile.v[1] - profile.v[0]) / RAMP_RATE_HZ_S;
+    start_freq_ramp(rc, &profile);
+}
+
+void service_freq_ramp(reg_cache_t *cache, ramp_ctl_t *rc, telemetry_t *tlm) {
+    double hz;
+
+    if (!rc->active) return;
+
+    int64_t now = ramp_now_ns();
+    if (ramp_next(&rc->ramp, now, &hz, NULL) != 1) return;
+
+    int freq = (int)lround(hz * 100);
+    bool ok = reg_cache_write_register(cache, REG_FREQ_CMD, freq) != -1;
+    ramp_done(&rc->ramp, ok, now, ramp_now_ns());
+
+    if (ok) {
+        rc->written_freq = freq;
+        tlm->comm_error = false;
+        tlm->last_msg_code = SET_FREQ;
+        snprintf(tlm->last_msg, 64, "Ramp Freq: %.2f Hz", freq / 100.0);
+    } else {
+        tlm->comm_error = true;
+        tlm->last_msg_code = COMM_FREQ_FAIL;
+        snprintf(tlm->last_msg, 64, "ERR: Write Freq Fail");
+    }
+
+    // Last step written
+    if (ramp_due_ns(&rc->ramp) == -1) rc->active = false;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file faults.c
+ * @brief Parsing and evaluation of fault injection rules.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "faults.h"
+
+void fault_seed(fault_table_t *table, long seed) {
+    table->rng[0] = 0x330E;
+    table->rng[1] = (unsigned short)seed;
+    table->rng[2] = (unsigned short)(seed >> 16);
+}
+
+/**
+ * @brief Parses a probability in [0, 1].
+ */
+static int parse_probability(const char *val, double *out) {
+    char *end;
+    double p = strtod(val, &end);
+    if (end == val || *end != '\0' || p < 0.0 || p > 1.0) return -1;
+    *out = p;
+    return 0;
+}
+
+/**
+ * @brief Parses "N", "A-B" or "expM" into a delay distribution.
+ */
+static int parse_delay(const char *val, fault_rule_t *rule) {
+    char *end;
+
+    if (strncmp(val, "exp", 3) == 0) {
+        rule->delay_dist = DELAY_EXP;
+        rule->delay_a = strtod(val + 3, &end);
+        return (end == val + 3 || *end != '\0' || rule->delay_a < 0) ? -1 : 0;
+    }
+
+    rule->delay_a = strtod(val, &end);
+    if (end == val || rule->delay_a < 0) return -1;
+    if (*end == '\0') {
+        rule->delay_dist = DELAY_FIXED;
+        return 0;
+    }
+    if (*end != '-') return -1;
+
+    const char *b = end + 1;
+    rule->delay_b = strtod(b, &end);
+    if (end == b || *end != '\0' || rule->delay_b < rule->delay_a) return -1;
+    rule->delay_dist = DELAY_UNIFORM;
+    return 0;
+}
+
+/**
+ * @brief Applies one KEY=VALUE setting to a rule.
+ */
+static int parse_setting(char *setting, fault_rule_t *rule) {
+    char *val = strchr(setting, '=');
+    char *end;
+    if (val == NULL) return -1;
+    *val++ = '\0';
+
+    if (strcmp(setting, "delay") == 0) return parse_delay(val, rule);
+    if (strcmp(setting, "drop") == 0) return parse_probability(val, &rule->p_drop);
+    if (strcmp(setting, "exc") == 0) return parse_probability(val, &rule->p_exception);
+    if (strcmp(setting, "crc") == 0) return parse_probability(val, &rule->p_bad_crc);
+    if (strcmp(setting, "code") == 0) {
+        rule->exception_code = (int)strtol(val, &end, 0);
+        return (end == val || *end != '\0' || rule->exception_code < 1 || rule->exception_code > 0x0B) ? -1 : 0;
+    }
+    if (strcmp(setting, "brownout") == 0) {
+        rule->brownout_period_ms = (int)strtol(val, &end, 10);
+        if (end == val || *end != '/') return -1;
+        const char *d = end + 1;
+        rule->brownout_ms = (int)strtol(d, &end, 10);
+        return (end == d || *end != '\0' || rule->brownout_ms <= 0 ||
+                rule->brownout_ms >= rule->brownout_period_ms) ? -1 : 0;
+    }
+    return -1;
+}
+
+int fault_parse_rule(fault_table_t *table, const char *spec) {
+    char buf[256];
+    char *end;
+
+    if (table->n_rules == MAX_FAULT_RULES || strlen(spec) >= sizeof(buf)) return -1;
+    strcpy(buf, spec);
+
+    fault_rule_t rule = {0};
+    rule.first_addr = -1;
+    rule.exception_code = 6;   // MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY
+
+    char *settings = strchr(buf, ':');
+    if (settings == NULL) return -1;
+    *settings++ = '\0';
+
+    // Target: id or '*', then an optional @first[-last] register range
+    char *range = strchr(buf, '@');
+    if (range != NULL) *range++ = '\0';
+
+    if (strcmp(buf, "*") == 0) {
+        rule.slave_id = 0;
+    } else {
+        rule.slave_id = (int)strtol(buf, &end, 10);
+        if (end == buf || *end != '\0' || rule.slave_id < 1 || rule.slave_id > 247) return -1;
+    }
+
+    if (range != NULL) {
+        rule.first_addr = (int)strtol(range, &end, 0);
+        rule.last_addr = rule.first_addr;
+        if (end == range || rule.first_addr < 0) return -1;
+        if (*end == '-') {
+            const char *last = end + 1;
+            rule.last_addr = (int)strtol(last, &end, 0);
+            if (end == last) return -1;
+        }
+        if (*end != '\0' || rule.last_addr < rule.first_addr || rule.last_addr > 0xFFFF) return -1;
+    }
+
+    for (char *tok = strtok(settings, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (parse_setting(tok, &rule) == -1) return -1;
+    }
+    if (rule.p_drop + rule.p_exception + rule.p_bad_crc > 1.0) return -1;
+
+    table->rules[table->n_rules++] = rule;
+    return 0;
+}
+
+/**
+ * @brief Registers touched by a request, for matching register ranges.
+ * @return 0 if the function code carries no address.
+ */
+static int request_range(const uint8_t *frame, int *addr, int *count) {
+    *addr = frame[2] << 8 | frame[3];
+
+    switch (frame[1]) {
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x0F: case 0x10: case 0x17:
+            *count = frame[4] << 8 | frame[5];
+            return 1;
+        case 0x05: case 0x06: case 0x16:
+            *count = 1;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Finds the first rule for a drive whose range overlaps the request.
+ */
+static const fault_rule_t *match_rule(const fault_table_t *table, int slave_id, const uint8_t *frame) {
+    int addr = 0, count = 0;
+    int has_range = request_range(frame, &addr, &count);
+
+    for (int i = 0; i < table->n_rules; i++) {
+        const fault_rule_t *rule = &table->rules[i];
+        if (rule->slave_id != 0 && rule->slave_id != slave_id) continue;
+        if (rule->p_drop == 0 && rule->p_exception == 0 && rule->p_bad_crc == 0 &&
+            rule->delay_dist == DELAY_NONE) {
+            continue;   // Brown-out only
+        }
+        if (rule->first_addr == -1) return rule;
+        if (has_range && addr <= rule->last_addr && rule->first_addr < addr + count) return rule;
+    }
+    return NULL;
+}
+
+void fault_decide(fault_table_t *table, int slave_id, const uint8_t *frame, fault_decision_t *out) {
+    const fault_rule_t *rule = match_rule(table, slave_id, frame);
+
+    out->action = FAULT_NONE;
+    out->exception_code = 0;
+    out->extra_delay_ms = 0;
+    if (rule == NULL) return;
+
+    // One draw picks at most one fault, so the probabilities add up
+    double u = erand48(table->rng);
+    if (u < rule->p_drop) {
+        out->action = FAULT_DROP;
+    } else if (u < rule->p_drop + rule->p_exception) {
+        out->action = FAULT_EXCEPTION;
+        out->exception_code = rule->exception_code;
+    } else if (u < rule->p_drop + rule->p_exception + rule->p_bad_crc) {
+        out->action = FAULT_BAD_CRC;
+    }
+
+    switch (rule->delay_dist) {
+        case DELAY_FIXED:
+            out->extra_delay_ms = (int)rule->delay_a;
+            break;
+        case DELAY_UNIFORM:
+            out->extra_delay_ms = (int)(rule->delay_a + erand48(table->rng) * (rule->delay_b - rule->delay_a) + 0.5);
+            break;
+        case DELAY_EXP:
+            out->extra_delay_ms = (int)(-rule->delay_a * log(1.0 - erand48(table->rng)) + 0.5);
+            break;
+        case DELAY_NONE:
+            break;
+    }
+}
+
+const fault_rule_t *fault_brownout_rule(const fault_table_t *table, int slave_id) {
+    for (int i = 0; i < table->n_rules; i++) {
+        const fault_rule_t *rule = &table->rules[i];
+        if ((rule->slave_id == 0 || rule->slave_id == slave_id) && rule->brownout_period_ms > 0) {
+            return rule;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file faults.h
+ * @brief Fault and latency injection profiles for the RTU slave simulator.
+ *
+ * A profile is a list of rules given on the command line, each one
+ * targeting a drive (or every drive) and optionally a register range:
+ *
+ *   TARGET[@FIRST[-LAST]]:KEY=VALUE[,KEY=VALUE...]
+ *
+ *   TARGET    slave id, or '*' for every drive
+ *   FIRST-LAST register addresses (decimal or 0x hex) the rule applies to
+ *
+ *   delay=N       extra response delay of N ms
+ *   delay=A-B     uniform between A and B ms
+ *   delay=expM    exponential with mean M ms (long tail)
+ *   drop=P        probability of not answering at all
+ *   exc=P         probability of answering with an exception...
+ *   code=N        ...with this exception code (default 6, slave busy)
+ *   crc=P         probability of answering with a corrupted CRC
+ *   brownout=T/D  every T ms the drive is dead for D ms and restarts
+ *                 with its registers cleared (per drive, range ignored)
+ *
+ * The first rule matching a request applies, so range-specific rules go
+ * before the general ones (rules with only a brown-out never match a
+ * request). All random draws come from one seedable generator, so a run
+ * can be repeated exactly.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef FAULTS_H
+#define FAULTS_H
+
+#include <stdint.h>
+
+#define MAX_FAULT_RULES   16
+
+typedef enum {
+    DELAY_NONE,
+    DELAY_FIXED,
+    DELAY_UNIFORM,
+    DELAY_EXP
+} delay_dist_t;
+
+typedef struct {
+    int slave_id;                 // 0 = every drive
+    int first_addr;               // -1 = every request
+    int last_addr;
+    delay_dist_t delay_dist;
+    double delay_a;               // Fixed value, lower bound or mean (ms)
+    double delay_b;               // Upper bound (ms)
+    double p_drop;
+    double p_exception;
+    double p_bad_crc;
+    int exception_code;
+    int brownout_period_ms;       // 0 = no brown-outs
+    int brownout_ms;
+} fault_rule_t;
+
+typedef struct {
+    fault_rule_t rules[MAX_FAULT_RULES];
+    int n_rules;
+    unsigned short rng[3];        // erand48() state
+} fault_table_t;
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_DROP,
+    FAULT_EXCEPTION,
+    FAULT_BAD_CRC
+} fault_action_t;
+
+typedef struct {
+    fault_action_t action;
+    int exception_code;
+    int extra_delay_ms;
+} fault_decision_t;
+
+/**
+ * @brief Seeds the generator; the same seed gives the same sequence of faults.
+ */
+void fault_seed(fault_table_t *table, long seed);
+
+/**
+ * @brief Parses one rule (see the file comment) and appends it to the table.
+ * @return 0 on success, -1 if the rule is malformed or the table is full.
+ */
+int fault_parse_rule(fault_table_t *table, const char *spec);
+
+/**
+ * @brief Decides what happens to one request addressed to a drive.
+ * @param frame The RTU request (slave id, PDU, CRC).
+ */
+void fault_decide(fault_table_t *table, int slave_id, const uint8_t *frame, fault_decision_t *out);
+
+/**
+ * @brief Returns the first rule giving a drive brown-outs, or NULL.
+ */
+const fault_rule_t *fault_brownout_rule(const fault_table_t *table, int slave_id);
+
+#endif // FAULTS_H
@@ -8,15 +8,40 @@
  * with master applications for testing and development.
  *
  * Features:
- *   - Slave ID: 2
+ *   - Slave ID: 2, or N independent drives with their own ids on one port
  *   - Responds to writes at 0x2000 (Control) and 0x2001 (Frequency)
  *   - Responds to reads at 0x2103 (Telemetry block)
  *   - Simulates motor ramp-up/ramp-down and telemetry values
- *   - Uses libmodbus for RTU protocol handling
+ *   - Physics runs on a fixed 10 ms step of a monotonic clock, independent of
+ *     how often the master polls; requests are answered from a poll() loop
+ *   - Requests for absent ids, and frames with a bad CRC, get no answer
+ *   - Configurable response delay per drive
+ *   - Fault injection (see faults.h): random delays, dropped replies, bad
+ *     CRCs, exception responses and periodic brown-outs, per drive and per
+ *     register range, from a seedable generator
+ *   - Optional Modbus TCP server (-t) on the same drives: RTU and TCP
+ *     requests are served from one epoll loop against the same registers
+ *     and motor model, so several masters can share one simulated drive
+ *   - Capacity figures: requests per second (-s), and the time spent in
+ *     modbus_reply() per function code, printed on exit
+ *   - Self-benchmark (-B): a client thread hammers the simulator over a
+ *     PTY, or over TCP loopback when -t is given, with frame dumps off
+ *   - Scenarios (-x, see scenario.h): time-indexed setpoints, load steps,
+ *     noise and trips replayed from a file, live or, with -G, offline into
+ *     a CSV sample stream much faster than real time
+ *   - Uses libmodbus for RTU and TCP protocol handling
  *
  * Usage:
- *   $ ./rtu-slave [serial_port]
- *   Default port: /dev/ttyUSB1
+ *   $ ./rtu-slave [-n drives] [-i id[:delay_ms],...] [-d delay_ms]
+ *                 [-f fault_rule]... [-r seed] [-t tcp_port]
+ *                 [-q] [-s report_s] [-B bench_s]
+ *                 [-x scenario [-G samples.csv]] [serial_port]
+ *   Default port: /dev/ttyUSB1 (replaced by a PTY with -B)
+ *
+ *   Over TCP the unit id selects the drive; 0 and 255 address the first
+ *   one. Fault rules only apply to the serial port, except brown-outs: a
+ *   drive without power is answered for with exception 0x0B (gateway
+ *   target failed to respond), unknown unit ids with 0x0A.
  *
  * Dependencies:
  *   - libmodbus (https://libmodbus.org/)
@@ -34,16 +59,28 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <pty.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <modbus.h>
 #include <time.h> 
 
+#include "faults.h"
+#include "scenario.h"
+
 // --- VFD Definitions ---
 #define SLAVE_ID          2
 #define BAUDRATE          38400
 #define PARITY            'N'
 #define DATA_BITS         8
 #define STOP_BITS         1
+#define MAX_DRIVES        32
+#define FRAME_TIMEOUT_MS  20      // Drop a partial frame after this much silence
+#define TCP_MAX_CLIENTS   64
 
 // --- Register Definitions ---
 #define REG_START_ADDR    0x2000
@@ -52,13 +89,22 @@
 // --- Offsets (Index 0 = REG_START_ADDR) ---
 #define OFF_CONTROL_WORD  0x0000  // 0x2000
 #define OFF_FREQ_CMD      0x0001  // 0x2001
+#define OFF_ERROR_CODE    0x0100  // 0x2100, non-zero = tripped
 #define OFF_MONITOR_START 0x0103  // 0x2103
 #define OFF_MON_CURRENT   0x0104  // 0x2104
 #define OFF_MON_VOLTAGE   0x0106  // 0x2106
 #define OFF_MON_RPM       0x010C  // 0x210C
 
+#define CMD_STOP          0x01
 #define CMD_RUN           0x02
 
+// --- Physics ---
+#define TICK_MS           10      // Fixed simulation step
+#define ACCEL_HZ_PER_S    5.0     // Ramp towards the target while running
+#define DECEL_HZ_PER_S    10.0    // Coast down when stopped
+#define NO_LOAD_CURRENT   0.4     // Share of the rated current drawn without load
+#define RATED_SLIP        0.03    // Speed lost between no load and rated load
+
 // --- Simulation State ---
 typedef struct {
     double freq;
@@ -67,6 +113,94 @@ typedef struct {
     double volts;
 } vfd_state_t;
 
+// --- Operating conditions, changed by scenarios (the defaults give the plain ramp) ---
+typedef struct {
+    double accel_hz_s;
+    double decel_hz_s;
+    double load_pct;              // 100 = rated load
+    double noise_pct;             // Amplitude of the noise on current, voltage and speed
+    unsigned short rng[3];        // erand48() state of the noise
+} vfd_env_t;
+
+// --- Per-drive counters, printed on exit ---
+typedef struct {
+    unsigned long requests;
+    unsigned long tcp_requests;   // Part of requests that came over TCP
+    unsigned long replies;
+    unsigned long dropped;
+    unsigned long exceptions;
+    unsigned long bad_crc;
+    unsigned long busy;           // Arrived while a reply was pending
+    unsigned long powered_off;    // Arrived during a brown-out
+} drive_stats_t;
+
+// --- One simulated drive on the bus ---
+typedef struct {
+    int slave_id;
+    int delay_ms;                 // Time between the end of a request and the reply
+    modbus_mapping_t *mapping;
+    vfd_state_t vfd;
+    vfd_env_t env;
+    int brownout_period_ms;       // 0 = always powered
+    int brownout_ms;
+    bool powered_off;
+    drive_stats_t stats;
+} drive_t;
+
+// --- Reply waiting for its drive's response delay ---
+typedef struct {
+    drive_t *drive;               // NULL when the slot is free
+    uint8_t adu[MODBUS_RTU_MAX_ADU_LENGTH];
+    int len;
+    int64_t due_ms;
+} pending_reply_t;
+
+// --- Builds replies with libmodbus into a pipe, so they can be delayed or damaged ---
+typedef struct {
+    modbus_t *ctx;
+    int pipe_rd;
+    int pipe_wr;
+} reply_builder_t;
+
+// --- Partial RTU request being received on the serial port ---
+typedef struct {
+    uint8_t buf[MODBUS_RTU_MAX_ADU_LENGTH];
+    int len;
+    int64_t last_rx_ms;
+} rtu_rx_t;
+
+// --- Modbus TCP client with its partial request ---
+typedef struct {
+    int fd;                       // -1 = free slot
+    uint8_t buf[MODBUS_TCP_MAX_ADU_LENGTH];
+    int len;
+} tcp_client_t;
+
+// --- Modbus TCP server; one context answers every client via modbus_set_socket() ---
+typedef struct {
+    modbus_t *ctx;
+    int listen_fd;                // -1 when TCP is disabled
+    tcp_client_t clients[TCP_MAX_CLIENTS];
+} tcp_server_t;
+
+// --- Time spent in modbus_reply() for one function code ---
+typedef struct {
+    unsigned long count;
+    int64_t total_ns;
+    int64_t max_ns;
+} fc_timing_t;
+
+static fc_timing_t fc_timing[128];   // Indexed by function code
+
+// --- Self-benchmark client, run in its own thread ---
+typedef struct {
+    modbus_t *ctx;
+    int seconds;
+    unsigned long requests;
+    unsigned long errors;
+    double elapsed_s;
+} bench_client_t;
+
 // Global control flag for signal handler
 volatile sig_atomic_t keep_running = 1;
 
@@ -80,15 +214,54 @@ void handle_shutdown(int sig) {
 }
 
 /**
- * @brief Simulates one tick of VFD operation.
+ * @brief Returns the monotonic clock in milliseconds.
+ */
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Default operating conditions; the noise generator is seeded per drive.
+ */
+static void init_env(vfd_env_t *env, long seed, int slave_id) {
+    env->accel_hz_s = ACCEL_HZ_PER_S;
+    env->decel_hz_s = DECEL_HZ_PER_S;
+    env->load_pct = 100.0;
+    env->noise_pct = 0.0;
+    env->rng[0] = (unsigned short)slave_id;
+    env->rng[1] = (unsigned short)seed;
+    env->rng[2] = (unsigned short)(seed >> 16);
+}
+
+/**
+ * @brief Adds the configured noise to a telemetry value.
+ */
+static double with_noise(vfd_env_t *env, double value) {
+    if (env->noise_pct == 0.0) return value;
+    value *= 1.0 + env->noise_pct / 100.0 * (2.0 * erand48(env->rng) - 1.0);
+    return value > 0.0 ? value : 0.0;
+}
+
+/**
+ * @brief Simulates one fixed step (TICK_MS) of VFD operation.
  * 
  * Reads control commands from Modbus mapping, updates VFD state,
- * and writes telemetry back to Modbus mapping.
+ * and writes telemetry back to Modbus mapping. A drive with an error
+ * code in 0x2100 is tripped and coasts down until the code is cleared.
  * 
  * @param mb_mapping Pointer to Modbus mapping structure.
  * @param vfd Pointer to VFD state structure.
+ * @param env Operating conditions (ramp rates, load, noise).
  */
-void run_simulation_tick(modbus_mapping_t *mb_mapping, vfd_state_t *vfd) {
+void run_simulation_tick(modbus_mapping_t *mb_mapping, vfd_state_t *vfd, vfd_env_t *env) {
     // Safety check to prevent segfaults if mapping failed
     if (!mb_mapping || !mb_mapping->tab_registers) return;
 
@@ -97,47 +270,596 @@ void run_simulation_tick(modbus_mapping_t *mb_mapping, vfd_state_t *vfd) {
     uint16_t target_freq_raw = mb_mapping->tab_registers[OFF_FREQ_CMD];
     double target_freq = target_freq_raw / 100.0;
 
-    int is_running = (control_word & CMD_RUN) == CMD_RUN;
+    int is_running = (control_word & CMD_RUN) == CMD_RUN &&
+                     mb_mapping->tab_registers[OFF_ERROR_CODE] == 0;
 
     // 2. Physics logic (ramp up/down) 
+    const double accel_step = env->accel_hz_s * TICK_MS / 1000.0;
+    const double decel_step = env->decel_hz_s * TICK_MS / 1000.0;
+
     if (is_running) {
         if (vfd->freq < target_freq) {
-            vfd->freq += 0.5; 
+            vfd->freq += accel_step; 
             if (vfd->freq > target_freq) vfd->freq = target_freq;
         } else if (vfd->freq > target_freq) {
-            vfd->freq -= 0.5;
+            vfd->freq -= accel_step;
             if (vfd->freq < target_freq) vfd->freq = target_freq;
         }
     } else {
         if (vfd->freq > 0) {
-            vfd->freq -= 1.0;
+            vfd->freq -= decel_step;
             if (vfd->freq < 0) vfd->freq = 0;
         }
     }
 
-    // 3. Derived values (calculate RPM, Amps, Volts based on frequency)
+    // 3. Derived values (calculate RPM, Amps, Volts based on frequency and load)
+    double load = env->load_pct / 100.0;
     if (vfd->freq == 0) {
         vfd->rpm = 0; vfd->amps = 0; vfd->volts = 0;
     } else {
-        vfd->rpm = vfd->freq * 30.0;
-        vfd->amps = vfd->freq / 10.0;
+        vfd->rpm = vfd->freq * 30.0 * (1.0 + RATED_SLIP * (1.0 - load));
+        vfd->amps = vfd->freq / 10.0 * (NO_LOAD_CURRENT + (1.0 - NO_LOAD_CURRENT) * load);
         vfd->volts = vfd->freq * 3.8;
     }
 
     // 4. Write telemetry (scaled for Modbus registers)
     mb_mapping->tab_registers[OFF_MONITOR_START] = (uint16_t)(vfd->freq * 100);
-    mb_mapping->tab_registers[OFF_MON_CURRENT] = (uint16_t)(vfd->amps * 10);
-    mb_mapping->tab_registers[OFF_MON_VOLTAGE] = (uint16_t)(vfd->volts * 10);
-    mb_mapping->tab_registers[OFF_MON_RPM] = (uint16_t)(vfd->rpm);
+    mb_mapping->tab_registers[OFF_MON_CURRENT] = (uint16_t)(with_noise(env, vfd->amps) * 10);
+    mb_mapping->tab_registers[OFF_MON_VOLTAGE] = (uint16_t)(with_noise(env, vfd->volts) * 10);
+    mb_mapping->tab_registers[OFF_MON_RPM] = (uint16_t)(with_noise(env, vfd->rpm));
+}
+
+/**
+ * @brief Applies one scenario step to a drive.
+ *
+ * Commands and trips are written to the registers only when they change
+ * from the previous step, so a master can still override them in between.
+ */
+static void apply_scenario(modbus_mapping_t *mb_mapping, vfd_env_t *env,
+                           const scenario_step_t *step, const scenario_step_t *prev) {
+    uint16_t *regs = mb_mapping->tab_registers;
+
+    if (step->run != prev->run) regs[OFF_CONTROL_WORD] = step->run ? CMD_RUN : CMD_STOP;
+    if (step->freq_cmd != prev->freq_cmd) regs[OFF_FREQ_CMD] = step->freq_cmd;
+    if (step->fault_code != prev->fault_code) regs[OFF_ERROR_CODE] = step->fault_code;
+
+    env->accel_hz_s = step->accel / 10.0;
+    env->decel_hz_s = step->decel / 10.0;
+    env->load_pct = step->load;
+    env->noise_pct = step->noise / 100.0;
+}
+
+/**
+ * @brief Plays one pass of a scenario through the motor model as fast as
+ *        possible and writes a CSV row per simulation step.
+ */
+static int generate_samples(const scenario_t *sc, const char *path, long seed) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    static char buf[1 << 16];
+    setvbuf(out, buf, _IOFBF, sizeof(buf));
+
+    modbus_mapping_t *mapping = modbus_mapping_new_start_address(0, 0, 0, 0, REG_START_ADDR, REG_BLOCK_SIZE, 0, 0);
+    if (mapping == NULL) {
+        fprintf(stderr, "Failed to allocate mapping: %s\n", modbus_strerror(errno));
+        fclose(out);
+        return -1;
+    }
+    vfd_state_t vfd = {0};
+    vfd_env_t env;
+    init_env(&env, seed, SLAVE_ID);
+    const uint16_t *regs = mapping->tab_registers;
+
+    int64_t t0 = now_ns();
+    fprintf(out, "time_s,freq_hz,current_a,voltage_v,rpm,error_code\n");
+    for (long k = 0; k < sc->n_steps; k++) {
+        apply_scenario(mapping, &env, scenario_step(sc, k), scenario_step(sc, k - 1));
+        run_simulation_tick(mapping, &vfd, &env);
+        fprintf(out, "%.2f,%.2f,%.1f,%.1f,%u,%u\n", (k + 1) * TICK_MS / 1000.0,
+                regs[OFF_MONITOR_START] / 100.0, regs[OFF_MON_CURRENT] / 10.0,
+                regs[OFF_MON_VOLTAGE] / 10.0, regs[OFF_MON_RPM], regs[OFF_ERROR_CODE]);
+    }
+    int rc = fclose(out) == 0 ? 0 : -1;
+    double elapsed_s = (now_ns() - t0) / 1e9;
+
+    double scenario_s = sc->n_steps * TICK_MS / 1000.0;
+    printf("%ld samples (%.1f s of scenario) in %.3f s, %.0fx real time\n",
+           sc->n_steps, scenario_s, elapsed_s, elapsed_s > 0 ? scenario_s / elapsed_s : 0.0);
+    modbus_mapping_free(mapping);
+    return rc;
+}
+
+/**
+ * @brief CRC-16/MODBUS of a buffer.
+ */
+static uint16_t crc16(const uint8_t *buf, int len) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Length of the RTU request starting at buf, as libmodbus computes it.
+ * @return Total frame length including CRC, or 0 if more bytes are needed to know.
+ */
+static int request_length(const uint8_t *buf, int len) {
+    if (len < 2) return 0;
+
+    switch (buf[1]) {
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x05: case 0x06:
+            return 8;
+        case 0x0F: case 0x10:
+            return len < 7 ? 0 : 9 + buf[6];
+        case 0x16:
+            return 10;
+        case 0x17:
+            return len < 11 ? 0 : 13 + buf[10];
+        default:
+            return 4;   // Function code only (e.g. 0x11 Report Slave ID)
+    }
+}
+
+/**
+ * @brief Finds the drive answering to a slave id.
+ */
+static drive_t *find_drive(drive_t *drives, int n_drives, int slave_id) {
+    for (int i = 0; i < n_drives; i++) {
+        if (drives[i].slave_id == slave_id) return &drives[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief modbus_reply(), or modbus_reply_exception() if exception_code is set,
+ *        timed per function code.
+ */
+static int timed_reply(modbus_t *ctx, const uint8_t *query, int len,
+                       modbus_mapping_t *mapping, int exception_code) {
+    int64_t t0 = now_ns();
+    int rc = (exception_code != 0) ? modbus_reply_exception(ctx, query, exception_code)
+                                   : modbus_reply(ctx, query, len, mapping);
+    int64_t dt = now_ns() - t0;
+
+    fc_timing_t *t = &fc_timing[query[modbus_get_header_length(ctx)] & 0x7F];
+    t->count++;
+    t->total_ns += dt;
+    if (dt > t->max_ns) t->max_ns = dt;
+    return rc;
+}
+
+/**
+ * @brief Processes a request on behalf of one drive and captures the reply.
+ *
+ * modbus_reply() applies writes to the drive's mapping and sends the
+ * response (with CRC) to the builder's pipe, where it is read back.
+ *
+ * @param exception_code 0 for a normal reply, or the exception to answer with.
+ * @return Reply length, 0 if there is none (broadcast), -1 on error.
+ */
+static int build_reply(reply_builder_t *rb, drive_t *drive, const uint8_t *frame, int len,
+                       int exception_code, uint8_t *adu) {
+    modbus_set_slave(rb->ctx, drive->slave_id);
+    int rc = timed_reply(rb->ctx, frame, len, drive->mapping, exception_code);
+    if (rc <= 0) return rc;
+
+    return (int)read(rb->pipe_rd, adu, MODBUS_RTU_MAX_ADU_LENGTH);
+}
+
+/**
+ * @brief Handles one complete request frame.
+ *
+ * Frames with a bad CRC or for an absent id are ignored, like a real bus
+ * where nobody answers. Broadcasts are applied to every drive without reply.
+ * Otherwise the drive's fault rules decide whether the reply is dropped,
+ * replaced by an exception, damaged or delayed.
+ */
+static void handle_frame(int fd, reply_builder_t *rb, fault_table_t *faults,
+                         drive_t *drives, int n_drives, pending_reply_t *pending,
+                         const uint8_t *frame, int len) {
+    uint8_t adu[MODBUS_RTU_MAX_ADU_LENGTH];
+
+    uint16_t crc = crc16(frame, len - 2);
+    if (frame[len - 2] != (crc & 0xFF) || frame[len - 1] != (crc >> 8)) return;
+
+    if (frame[0] == MODBUS_BROADCAST_ADDRESS) {
+        for (int i = 0; i < n_drives; i++) {
+            if (!drives[i].powered_off) build_reply(rb, &drives[i], frame, len, 0, adu);
+        }
+        return;
+    }
+
+    drive_t *drive = find_drive(drives, n_drives, frame[0]);
+    if (drive == NULL) return;
+    drive->stats.requests++;
+
+    if (drive->powered_off) {
+        drive->stats.powered_off++;
+        return;
+    }
+
+    // A real drive is deaf while it prepares a reply; the master will time out
+    if (pending->drive != NULL) {
+        drive->stats.busy++;
+        return;
+    }
+
+    fault_decision_t fault;
+    fault_decide(faults, drive->slave_id, frame, &fault);
+    if (fault.action == FAULT_DROP) {
+        drive->stats.dropped++;
+        return;
+    }
+
+    int adu_len = build_reply(rb, drive, frame, len,
+                              fault.action == FAULT_EXCEPTION ? fault.exception_code : 0, adu);
+    if (adu_len <= 0) return;
+
+    if (fault.action == FAULT_EXCEPTION) drive->stats.exceptions++;
+    if (fault.action == FAULT_BAD_CRC) {
+        adu[adu_len - 1] ^= 0xFF;
+        drive->stats.bad_crc++;
+    }
+
+    int delay = drive->delay_ms + fault.extra_delay_ms;
+    if (delay == 0) {
+        if (write(fd, adu, adu_len) == adu_len) drive->stats.replies++;
+        return;
+    }
+
+    pending->drive = drive;
+    memcpy(pending->adu, adu, adu_len);
+    pending->len = adu_len;
+    pending->due_ms = now_ms() + delay;
+}
+
+/**
+ * @brief Reads from the serial port and handles every complete request.
+ * @return 0, or -1 if the port is gone.
+ */
+static int serial_readable(int fd, rtu_rx_t *rx, reply_builder_t *rb, fault_table_t *faults,
+                           drive_t *drives, int n_drives, pending_reply_t *pending) {
+    ssize_t n = read(fd, rx->buf + rx->len, sizeof(rx->buf) - rx->len);
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) return 0;
+    if (n <= 0) {
+        // USB adapter unplugged or virtual bus gone
+        fprintf(stderr, "Serial port closed: %s\n", n == 0 ? "hang-up" : strerror(errno));
+        return -1;
+    }
+    rx->len += n;
+    rx->last_rx_ms = now_ms();
+
+    int need;
+    while ((need = request_length(rx->buf, rx->len)) > 0 && rx->len >= need) {
+        handle_frame(fd, rb, faults, drives, n_drives, pending, rx->buf, need);
+        memmove(rx->buf, rx->buf + need, rx->len - need);
+        rx->len -= need;
+    }
+    if (need > (int)sizeof(rx->buf)) rx->len = 0;   // Not a valid RTU request
+    return 0;
+}
+
+/**
+ * @brief Answers one Modbus TCP request on the client the context points at.
+ *
+ * The unit id selects the drive, with 0 and 255 meaning the first one. As a
+ * gateway would, unknown ids get exception 0x0A and drives in a brown-out 0x0B.
+ */
+static void handle_tcp_request(modbus_t *ctx, drive_t *drives, int n_drives,
+                               const uint8_t *query, int len) {
+    int unit = query[modbus_get_header_length(ctx) - 1];
+    drive_t *drive = (unit == 0 || unit == MODBUS_TCP_SLAVE) ? &drives[0]
+                                                             : find_drive(drives, n_drives, unit);
+    if (drive == NULL) {
+        timed_reply(ctx, query, len, NULL, MODBUS_EXCEPTION_GATEWAY_PATH);
+        return;
+    }
+
+    drive->stats.requests++;
+    drive->stats.tcp_requests++;
+    if (drive->powered_off) {
+        drive->stats.powered_off++;
+        timed_reply(ctx, query, len, NULL, MODBUS_EXCEPTION_GATEWAY_TARGET);
+        return;
+    }
+
+    if (timed_reply(ctx, query, len, drive->mapping, 0) > 0) drive->stats.replies++;
+}
+
+static void tcp_accept(tcp_server_t *tcp, int epfd) {
+    int fd = modbus_tcp_accept(tcp->ctx, &tcp->listen_fd);
+    if (fd == -1) return;
+
+    for (int i = 0; i < TCP_MAX_CLIENTS; i++) {
+        if (tcp->clients[i].fd == -1) {
+            struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+            tcp->clients[i].fd = fd;
+            tcp->clients[i].len = 0;
+            return;
+        }
+    }
+    fprintf(stderr, "Too many TCP clients (max %d), rejecting connection\n", TCP_MAX_CLIENTS);
+    close(fd);
+}
+
+/**
+ * @brief Closes a TCP client and frees its slot.
+ */
+static void tcp_drop(tcp_client_t *client, int epfd) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+}
+
+/**
+ * @brief Reads from a TCP client and answers every complete request, or
+ *        drops the client if it is gone or does not speak Modbus TCP.
+ *
+ * Like serial_readable(), it takes what the socket has without blocking and
+ * frames the requests itself, by the length field of the MBAP header, so a
+ * client that sends half a request cannot stall the loop. Epoll is
+ * level-triggered: bytes left in the socket buffer wake the loop again.
+ */
+static void tcp_readable(tcp_server_t *tcp, int epfd, int fd, drive_t *drives, int n_drives) {
+    tcp_client_t *client = NULL;
+    for (int i = 0; i < TCP_MAX_CLIENTS && client == NULL; i++) {
+        if (tcp->clients[i].fd == fd) client = &tcp->clients[i];
+    }
+    if (client == NULL) return;
+
+    ssize_t n = recv(fd, client->buf + client->len, sizeof(client->buf) - client->len, MSG_DONTWAIT);
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+    if (n <= 0) {
+        tcp_drop(client, epfd);
+        return;
+    }
+    client->len += n;
+
+    // MBAP header: transaction id, protocol id, length of the rest (unit id + PDU)
+    modbus_set_socket(tcp->ctx, fd);
+    while (client->len >= 6) {
+        int need = 6 + ((client->buf[4] << 8) | client->buf[5]);
+        if (need < 8 || need > (int)sizeof(client->buf)) {
+            tcp_drop(client, epfd);   // Not a valid Modbus TCP request
+            return;
+        }
+        if (client->len < need) break;
+
+        handle_tcp_request(tcp->ctx, drives, n_drives, client->buf, need);
+        memmove(client->buf, client->buf + need, client->len - need);
+        client->len -= need;
+    }
+}
+
+/**
+ * @brief Powers a drive off or on according to its brown-out cycle.
+ *
+ * The drive is dead during the last brownout_ms of every period. Losing
+ * power clears its registers and stops the motor model.
+ */
+static void update_power(drive_t *drive, int64_t elapsed_ms, pending_reply_t *pending) {
+    if (drive->brownout_period_ms == 0) return;
+
+    bool off = elapsed_ms % drive->brownout_period_ms >= drive->brownout_period_ms - drive->brownout_ms;
+    if (off && !drive->powered_off) {
+        memset(drive->mapping->tab_registers, 0, drive->mapping->nb_registers * sizeof(uint16_t));
+        memset(&drive->vfd, 0, sizeof(drive->vfd));
+        if (pending->drive == drive) pending->drive = NULL;
+    }
+    drive->powered_off = off;
+}
+
+/**
+ * @brief Self-benchmark client: polls like a master, back to back, for b->seconds.
+ *
+ * Nine in ten requests read the monitor block (FC 03); the rest alternate
+ * between a frequency write (FC 06) and a control block write (FC 16).
+ * Stops the server loop when done, and stops early on Ctrl+C.
+ */
+static void *bench_client(void *arg) {
+    bench_client_t *b = arg;
+    uint16_t regs[10];
+    uint16_t cmd[2] = { CMD_RUN, 5000 };
+    int64_t start = now_ms();
+    int64_t end = start + (int64_t)b->seconds * 1000;
+
+    for (unsigned long i = 0; keep_running && now_ms() < end; i++) {
+        int rc;
+        if (i % 20 == 9) {
+            rc = modbus_write_register(b->ctx, REG_START_ADDR + OFF_FREQ_CMD, (uint16_t)(i % 6000));
+        } else if (i % 20 == 19) {
+            rc = modbus_write_registers(b->ctx, REG_START_ADDR + OFF_CONTROL_WORD, 2, cmd);
+        } else {
+            rc = modbus_read_registers(b->ctx, REG_START_ADDR + OFF_MONITOR_START, 10, regs);
+        }
+        b->requests++;
+        if (rc == -1) b->errors++;
+    }
+
+    b->elapsed_s = (now_ms() - start) / 1000.0;
+    keep_running = 0;
+    return NULL;
+}
+
+static unsigned long total_requests(const drive_t *drives, int n_drives) {
+    unsigned long n = 0;
+    for (int i = 0; i < n_drives; i++) n += drives[i].stats.requests;
+    return n;
+}
+
+/**
+ * @brief Prints the modbus_reply() time of every function code seen.
+ */
+static void print_fc_timing(void) {
+    printf("FC    Requests   Avg us   Max us\n");
+    for (int fc = 0; fc < 128; fc++) {
+        const fc_timing_t *t = &fc_timing[fc];
+        if (t->count == 0) continue;
+        printf("0x%02X %9lu %8.2f %8.1f\n", fc, t->count,
+               t->total_ns / 1000.0 / t->count, t->max_ns / 1000.0);
+    }
+}
+
+/**
+ * @brief Parses "id[:delay_ms],..." into the drive table.
+ * @return Number of drives, or -1 on a malformed list.
+ */
+static int parse_drive_list(const char *list, drive_t *drives, int default_delay) {
+    int n = 0;
+    const char *p = list;
+
+    while (*p) {
+        char *end;
+        long id = strtol(p, &end, 10);
+        long delay = default_delay;
+        if (end == p || id < 1 || id > 247 || n == MAX_DRIVES) return -1;
+        if (*end == ':') {
+            p = end + 1;
+            delay = strtol(p, &end, 10);
+            if (end == p || delay < 0) return -1;
+        }
+        if (*end != ',' && *end != '\0') return -1;
+
+        drives[n].slave_id = (int)id;
+        drives[n].delay_ms = (int)delay;
+        n++;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-n drives] [-i id[:delay_ms],...] [-d delay_ms]\n"
+            "          [-f fault_rule]... [-r seed] [-t tcp_port]\n"
+            "          [-q] [-s report_s] [-B bench_s]\n"
+            "          [-x scenario [-G samples.csv]] [serial_port]\n"
+            "  -n  Number of drives, with consecutive ids from %d (default 1)\n"
+            "  -i  Explicit slave ids, each with an optional response delay in ms\n"
+            "  -d  Response delay of drives without their own (default 0 ms)\n"
+            "  -f  Fault rule: id|*[@first[-last]]:key=value,... with keys\n"
+            "      delay=N|A-B|expM, drop=P, exc=P, code=N, crc=P, brownout=T/D\n"
+            "  -r  Seed of the fault generator (default: time)\n"
+            "  -t  Also serve the drives over Modbus TCP on this port (e.g. 5020)\n"
+            "  -q  Quiet: do not print every frame\n"
+            "  -s  Print the requests served per second every report_s seconds\n"
+            "  -B  Benchmark for bench_s seconds over a PTY (or TCP with -t), then exit\n"
+            "  -x  Replay a scenario file on every drive\n"
+            "  -G  With -x: write the scenario's samples to a CSV file as fast as possible, then exit\n",
+            prog, SLAVE_ID);
 }
 
 int main(int argc, char *argv[]) {
     modbus_t *ctx = NULL;
-    modbus_mapping_t *mb_mapping = NULL;
-    uint8_t query[MODBUS_RTU_MAX_ADU_LENGTH];
-    int rc;
+    drive_t drives[MAX_DRIVES] = {0};
+    int n_drives = 1;
+    const char *id_list = NULL;
+    int default_delay = 0;
+    fault_table_t faults = {0};
+    long seed = (long)time(NULL);
+    int tcp_port = 0;
+    bool debug = true;
+    int report_s = 0;
+    int bench_s = 0;
+    const char *scenario_path = NULL;
+    const char *samples_path = NULL;
+    scenario_t scenario = {0};
+    int opt;
 
-    const char *port = (argc > 1) ? argv[1] : "/dev/ttyUSB1";
+    while ((opt = getopt(argc, argv, "n:i:d:f:r:t:qs:B:x:G:h")) != -1) {
+        switch (opt) {
+            case 'n': n_drives = atoi(optarg); break;
+            case 'i': id_list = optarg; break;
+            case 'd': default_delay = atoi(optarg); break;
+            case 'f':
+                if (fault_parse_rule(&faults, optarg) == -1) {
+                    fprintf(stderr, "Invalid fault rule: %s\n", optarg);
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'r': seed = strtol(optarg, NULL, 0); break;
+            case 't': tcp_port = atoi(optarg); break;
+            case 'q': debug = false; break;
+            case 's': report_s = atoi(optarg); break;
+            case 'B': bench_s = atoi(optarg); break;
+            case 'x': scenario_path = optarg; break;
+            case 'G': samples_path = optarg; break;
+            default: usage(argv[0]); return -1;
+        }
+    }
+    fault_seed(&faults, seed);
+
+    if (scenario_path != NULL && scenario_load(&scenario, scenario_path, TICK_MS) == -1) return -1;
+    if (samples_path != NULL) {
+        if (scenario_path == NULL) {
+            fprintf(stderr, "-G needs a scenario (-x)\n");
+            return -1;
+        }
+        int rc = generate_samples(&scenario, samples_path, seed);
+        scenario_free(&scenario);
+        return rc;
+    }
+
+    if (id_list != NULL) {
+        n_drives = parse_drive_list(id_list, drives, default_delay);
+    } else if (n_drives >= 1 && n_drives <= MAX_DRIVES && SLAVE_ID + n_drives - 1 <= 247) {
+        for (int i = 0; i < n_drives; i++) {
+            drives[i].slave_id = SLAVE_ID + i;
+            drives[i].delay_ms = default_delay;
+        }
+    } else {
+        n_drives = -1;
+    }
+    if (tcp_port < 0 || tcp_port > 65535) {
+        fprintf(stderr, "Invalid TCP port %d\n", tcp_port);
+        return -1;
+    }
+    if (report_s < 0 || bench_s < 0) {
+        fprintf(stderr, "Invalid report or benchmark time\n");
+        return -1;
+    }
+    if (n_drives < 1 || default_delay < 0) {
+        fprintf(stderr, "Invalid drive list (1-%d drives, ids 1-247)\n", MAX_DRIVES);
+        usage(argv[0]);
+        return -1;
+    }
+    for (int i = 0; i < n_drives; i++) {
+        if (find_drive(drives, i, drives[i].slave_id) != NULL) {
+            fprintf(stderr, "Duplicate slave id %d\n", drives[i].slave_id);
+            return -1;
+        }
+        init_env(&drives[i].env, seed, drives[i].slave_id);
+        const fault_rule_t *brownout = fault_brownout_rule(&faults, drives[i].slave_id);
+        if (brownout != NULL) {
+            drives[i].brownout_period_ms = brownout->brownout_period_ms;
+            drives[i].brownout_ms = brownout->brownout_ms;
+        }
+    }
+
+    const char *port = (optind < argc) ? argv[optind] : "/dev/ttyUSB1";
+
+    // A benchmark needs no hardware: the serial port is replaced by a PTY,
+    // whose other end is the RTU benchmark client (idle when benchmarking TCP)
+    char pty_name[64];
+    int pty_master = -1;
+    int pty_slave = -1;
+    if (bench_s > 0) {
+        debug = false;   // Printing every frame would be the bottleneck
+        if (openpty(&pty_master, &pty_slave, pty_name, NULL, NULL) == -1) {
+            fprintf(stderr, "openpty failed: %s\n", strerror(errno));
+            return -1;
+        }
+        port = pty_name;
+    }
 
     printf("Starting VFD Slave Simulator on %s...\n", port);
 
@@ -147,61 +869,230 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    // Timeout for non-blocking loop
-    modbus_set_response_timeout(ctx, 0, 100000); // 100ms
-    modbus_set_slave(ctx, SLAVE_ID);
+    modbus_set_slave(ctx, drives[0].slave_id);
 
-    // Arguments: (Coils, NbCoils, InputBits, NbInputBits, Registers, NbRegisters, InputRegs, NbInputRegs)
-    // We put REG_START_ADDR and REG_BLOCK_SIZE in the 5th and 6th arguments (Holding Registers)
-    mb_mapping = modbus_mapping_new_start_address(
-        0, 0, 
-        0, 0, 
-        REG_START_ADDR, REG_BLOCK_SIZE, 
-        0, 0
-    );
-    
-    if (mb_mapping == NULL) {
-        fprintf(stderr, "Failed to allocate mapping: %s\n", modbus_strerror(errno));
-        modbus_free(ctx);
-        return -1;
+    for (int i = 0; i < n_drives; i++) {
+        // Arguments: (Coils, NbCoils, InputBits, NbInputBits, Registers, NbRegisters, InputRegs, NbInputRegs)
+        // We put REG_START_ADDR and REG_BLOCK_SIZE in the 5th and 6th arguments (Holding Registers)
+        drives[i].mapping = modbus_mapping_new_start_address(
+            0, 0, 
+            0, 0, 
+            REG_START_ADDR, REG_BLOCK_SIZE, 
+            0, 0
+        );
+        
+        if (drives[i].mapping == NULL) {
+            fprintf(stderr, "Failed to allocate mapping: %s\n", modbus_strerror(errno));
+            for (int j = 0; j < i; j++) modbus_mapping_free(drives[j].mapping);
+            modbus_free(ctx);
+            return -1;
+        }
     }
 
     if (modbus_connect(ctx) == -1) {
         fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
-        modbus_mapping_free(mb_mapping);
+        for (int i = 0; i < n_drives; i++) modbus_mapping_free(drives[i].mapping);
         modbus_free(ctx);
         return -1;
     }
 
-    printf("Slave running (ID %d). Press Ctrl+C to stop.\n", SLAVE_ID);
+    for (int i = 0; i < n_drives; i++) {
+        printf("Slave running (ID %d, response delay %d ms).\n", drives[i].slave_id, drives[i].delay_ms);
+    }
+    if (faults.n_rules > 0) {
+        printf("%d fault rule(s), seed %ld.\n", faults.n_rules, seed);
+    }
+    if (scenario.steps != NULL) {
+        printf("Scenario %s: %.1f s%s.\n", scenario_path, scenario.n_steps * TICK_MS / 1000.0,
+               scenario.loop ? ", looping" : "");
+    }
+    printf("Press Ctrl+C to stop.\n");
     
     signal(SIGINT, handle_shutdown);
     signal(SIGTERM, handle_shutdown);
 
+    // Replies are built by a second context whose "serial port" is a pipe
+    int pipe_fds[2];
+    reply_builder_t rb = { .ctx = modbus_new_rtu(port, BAUDRATE, PARITY, DATA_BITS, STOP_BITS) };
+    if (rb.ctx == NULL || pipe(pipe_fds) == -1) {
+        fprintf(stderr, "Failed to create reply builder: %s\n", strerror(errno));
+        for (int i = 0; i < n_drives; i++) modbus_mapping_free(drives[i].mapping);
+        modbus_close(ctx);
+        modbus_free(ctx);
+        return -1;
+    }
+    rb.pipe_rd = pipe_fds[0];
+    rb.pipe_wr = pipe_fds[1];
+    modbus_set_socket(rb.ctx, rb.pipe_wr);
+
+    tcp_server_t tcp = { .listen_fd = -1 };
+    for (int i = 0; i < TCP_MAX_CLIENTS; i++) tcp.clients[i].fd = -1;
+    if (tcp_port != 0) {
+        tcp.ctx = modbus_new_tcp("0.0.0.0", tcp_port);
+        if (tcp.ctx != NULL) tcp.listen_fd = modbus_tcp_listen(tcp.ctx, TCP_MAX_CLIENTS);
+        if (tcp.listen_fd == -1) {
+            fprintf(stderr, "Cannot listen on TCP port %d: %s\n", tcp_port, modbus_strerror(errno));
+            if (tcp.ctx != NULL) modbus_free(tcp.ctx);
+            for (int i = 0; i < n_drives; i++) modbus_mapping_free(drives[i].mapping);
+            modbus_free(rb.ctx);
+            close(rb.pipe_rd);
+            close(rb.pipe_wr);
+            modbus_close(ctx);
+            modbus_free(ctx);
+            return -1;
+        }
+        printf("Modbus TCP server listening on port %d.\n", tcp_port);
+    }
+
     // Optional: Enable debug output
-    modbus_set_debug(ctx, TRUE); 
+    modbus_set_debug(rb.ctx, debug); 
+    if (tcp.ctx != NULL) modbus_set_debug(tcp.ctx, debug);
 
-    vfd_state_t vfd_state = {0};
+    // The client side of the benchmark; the listener's backlog takes its connection
+    bench_client_t bench = { .seconds = bench_s };
+    pthread_t bench_thread;
+    bool bench_started = false;
+    if (bench_s > 0) {
+        close(pty_slave);   // The simulator has its own descriptor now
+        if (tcp_port == 0) {
+            // Never connected: it speaks RTU straight on the PTY master
+            bench.ctx = modbus_new_rtu(pty_name, BAUDRATE, PARITY, DATA_BITS, STOP_BITS);
+            modbus_set_socket(bench.ctx, pty_master);
+        } else {
+            bench.ctx = modbus_new_tcp("127.0.0.1", tcp_port);
+            if (modbus_connect(bench.ctx) == -1) {
+                fprintf(stderr, "Benchmark client cannot connect: %s\n", modbus_strerror(errno));
+                keep_running = 0;
+            }
+        }
+        modbus_set_slave(bench.ctx, drives[0].slave_id);
+        printf("Benchmarking over %s for %d s...\n", tcp_port == 0 ? "a PTY" : "TCP loopback", bench_s);
+        fflush(stdout);
+        if (keep_running) bench_started = pthread_create(&bench_thread, NULL, bench_client, &bench) == 0;
+    }
+
+    // Requests are framed here rather than by modbus_receive(), which only
+    // accepts frames for the single slave id set on the context
+    int fd = modbus_get_socket(ctx);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    if (tcp.listen_fd != -1) {
+        ev.data.fd = tcp.listen_fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, tcp.listen_fd, &ev);
+    }
+
+    struct epoll_event events[TCP_MAX_CLIENTS + 2];
+    rtu_rx_t rx = {0};
+    pending_reply_t pending = {0};
+    int64_t start = now_ms();
+    int64_t next_tick = start + TICK_MS;
+    int64_t next_report = start + (int64_t)report_s * 1000;
+    unsigned long last_requests = 0;
 
     while (keep_running) {
-        rc = modbus_receive(ctx, query);
-        
-        if (rc > 0) {
-            modbus_reply(ctx, query, rc, mb_mapping);
-        } else if (rc == -1 && errno != ETIMEDOUT) {
-            // Ignore errors during cleanup/disconnect to keep simulator alive if master drops
-            if (errno != EBADF) { 
-                 // Optional: print error only if verbose
+        // Sleep until a port has data, a reply or the next physics step is due
+        int64_t deadline = next_tick;
+        if (pending.drive != NULL && pending.due_ms < deadline) deadline = pending.due_ms;
+        int64_t wait = deadline - now_ms();
+        int n_events = epoll_wait(epfd, events, TCP_MAX_CLIENTS + 2, wait > 0 ? (int)wait : 0);
+        if (n_events == -1) {
+            if (errno != EINTR) {
+                fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+                break;
+            }
+            n_events = 0;
+        }
+
+        // Catch up on every step that is due, so the ramp only depends on elapsed time
+        while (now_ms() >= next_tick) {
+            long tick = (next_tick - start) / TICK_MS - 1;
+            const scenario_step_t *step = scenario.steps ? scenario_step(&scenario, tick) : NULL;
+            for (int i = 0; i < n_drives; i++) {
+                update_power(&drives[i], next_tick - start, &pending);
+                if (drives[i].powered_off) continue;
+                if (step != NULL) {
+                    apply_scenario(drives[i].mapping, &drives[i].env, step, scenario_step(&scenario, tick - 1));
+                }
+                run_simulation_tick(drives[i].mapping, &drives[i].vfd, &drives[i].env);
             }
+            next_tick += TICK_MS;
+        }
+
+        if (pending.drive != NULL && now_ms() >= pending.due_ms) {
+            if (write(fd, pending.adu, pending.len) == pending.len) pending.drive->stats.replies++;
+            pending.drive = NULL;
+        }
+
+        if (report_s > 0 && now_ms() >= next_report) {
+            unsigned long requests = total_requests(drives, n_drives);
+            printf("%.0f requests/s\n", (double)(requests - last_requests) / report_s);
+            fflush(stdout);
+            last_requests = requests;
+            next_report += (int64_t)report_s * 1000;
+        }
+
+        if (rx.len > 0 && now_ms() - rx.last_rx_ms > FRAME_TIMEOUT_MS) {
+            rx.len = 0;   // Truncated frame
         }
 
-        run_simulation_tick(mb_mapping, &vfd_state);
+        for (int i = 0; i < n_events; i++) {
+            int efd = events[i].data.fd;
+            if (efd == fd) {
+                if (serial_readable(fd, &rx, &rb, &faults, drives, n_drives, &pending) == -1) {
+                    keep_running = 0;
+                }
+            } else if (efd == tcp.listen_fd) {
+                tcp_accept(&tcp, epfd);
+            } else {
+                tcp_readable(&tcp, epfd, efd, drives, n_drives);
+            }
+        }
     }
 
     printf("\nShutting down slave...\n");
-    modbus_mapping_free(mb_mapping);
+    double elapsed_s = (now_ms() - start) / 1000.0;
+    printf("Served %lu requests in %.1f s (%.0f requests/s)\n", total_requests(drives, n_drives),
+           elapsed_s, elapsed_s > 0 ? total_requests(drives, n_drives) / elapsed_s : 0.0);
+    print_fc_timing();
+    // A benchmark that did not run, or where every request failed, exits non-zero
+    int rc = 0;
+    if (bench.ctx != NULL) {
+        if (bench_started) pthread_join(bench_thread, NULL);
+        if (!bench_started || bench.errors == bench.requests) {
+            fprintf(stderr, "Benchmark failed: %lu requests, none answered\n", bench.requests);
+            rc = -1;
+        } else {
+            printf("Benchmark client: %lu requests, %lu errors, %.0f requests/s, %.1f us per round trip\n",
+                   bench.requests, bench.errors,
+                   bench.elapsed_s > 0 ? bench.requests / bench.elapsed_s : 0.0,
+                   bench.elapsed_s * 1e6 / bench.requests);
+        }
+        modbus_free(bench.ctx);
+    }
+    if (pty_master != -1) close(pty_master);
+    scenario_free(&scenario);
+    for (int i = 0; i < n_drives; i++) {
+        const drive_stats_t *st = &drives[i].stats;
+        printf("ID %d: %lu requests (%lu over TCP), %lu replies, %lu dropped, %lu exceptions, "
+               "%lu bad CRC, %lu while busy, %lu during brown-out\n",
+               drives[i].slave_id, st->requests, st->tcp_requests, st->replies, st->dropped,
+               st->exceptions, st->bad_crc, st->busy, st->powered_off);
+        modbus_mapping_free(drives[i].mapping);
+    }
+    for (int i = 0; i < TCP_MAX_CLIENTS; i++) {
+        if (tcp.clients[i].fd != -1) close(tcp.clients[i].fd);
+    }
+    if (tcp.listen_fd != -1) close(tcp.listen_fd);
+    if (tcp.ctx != NULL) modbus_free(tcp.ctx);
+    close(epfd);
+    modbus_free(rb.ctx);
+    close(rb.pipe_rd);
+    close(rb.pipe_wr);
     modbus_close(ctx);
     modbus_free(ctx);
 
-    return 0;
-}
\ No newline at end of file
+    return rc;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file scenario.c
+ * @brief Parsing and compilation of scenario files into per-step tables.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scenario.h"
+
+typedef enum {
+    FIELD_RUN,
+    FIELD_FREQ,
+    FIELD_ACCEL,
+    FIELD_DECEL,
+    FIELD_LOAD,
+    FIELD_NOISE,
+    FIELD_FAULT
+} field_t;
+
+typedef struct {
+    long tick;
+    field_t field;
+    uint16_t value;               // Already scaled to the step_t unit
+} event_t;
+
+// --- Key, field, scale to the table unit and accepted range (in file units) ---
+static const struct {
+    const char *key;
+    field_t field;
+    double scale;
+    double min;
+    double max;
+} keys[] = {
+    { "run",   FIELD_RUN,   1,   0,   1     },
+    { "freq",  FIELD_FREQ,  100, 0,   600   },
+    { "accel", FIELD_ACCEL, 10,  0.1, 6000  },
+    { "decel", FIELD_DECEL, 10,  0.1, 6000  },
+    { "load",  FIELD_LOAD,  1,   0,   255   },
+    { "noise", FIELD_NOISE, 100, 0,   100   },
+    { "fault", FIELD_FAULT, 1,   0,   65535 },
+};
+
+static const scenario_step_t defaults = { .accel = 50, .decel = 100, .load = 100 };
+
+/**
+ * @brief Parses one "key=value" token into an event.
+ */
+static int parse_event(char *tok, long tick, event_t *ev) {
+    char *val = strchr(tok, '=');
+    char *end;
+    if (val == NULL) return -1;
+    *val++ = '\0';
+
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (strcmp(tok, keys[i].key) != 0) continue;
+        double v = strtod(val, &end);
+        if (end == val || *end != '\0' || v < keys[i].min || v > keys[i].max) return -1;
+        ev->tick = tick;
+        ev->field = keys[i].field;
+        ev->value = (uint16_t)lround(v * keys[i].scale);
+        return 0;
+    }
+    return -1;
+}
+
+static void apply_event(scenario_step_t *st, const event_t *ev) {
+    switch (ev->field) {
+        case FIELD_RUN:   st->run = (uint8_t)ev->value; break;
+        case FIELD_FREQ:  st->freq_cmd = ev->value; break;
+        case FIELD_ACCEL: st->accel = ev->value; break;
+        case FIELD_DECEL: st->decel = ev->value; break;
+        case FIELD_LOAD:  st->load = (uint8_t)ev->value; break;
+        case FIELD_NOISE: st->noise = ev->value; break;
+        case FIELD_FAULT: st->fault_code = ev->value; break;
+    }
+}
+
+int scenario_load(scenario_t *sc, const char *path, int tick_ms) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open scenario %s\n", path);
+        return -1;
+    }
+
+    memset(sc, 0, sizeof(*sc));
+    sc->tick_ms = tick_ms;
+
+    event_t *events = NULL;
+    int n_events = 0, cap = 0;
+    long max_ticks = (long)SCENARIO_MAX_S * 1000 / tick_ms;
+    long last_tick = 0;
+    long end_tick = -1;
+    char line[512];
+    int line_no = 0;
+    int rc = 0;
+
+    while (rc == 0 && fgets(line, sizeof(line), f) != NULL) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash != NULL) *hash = '\0';
+
+        char *tok = strtok(line, " \t\r\n");
+        if (tok == NULL) continue;
+
+        char *end;
+        double t = strtod(tok, &end);
+        long tick = lround(t * 1000.0 / tick_ms);
+        if (end == tok || *end != '\0' || t < 0 || tick < last_tick || tick >= max_ticks) {
+            fprintf(stderr, "%s:%d: bad or decreasing time '%s' (max %d s)\n", path, line_no, tok, SCENARIO_MAX_S);
+            rc = -1;
+            break;
+        }
+        if (end_tick != -1) {
+            fprintf(stderr, "%s:%d: event after the end of the scenario\n", path, line_no);
+            rc = -1;
+            break;
+        }
+        last_tick = tick;
+        int line_events = n_events;
+
+        while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+            if (strcmp(tok, "end") == 0 || strcmp(tok, "loop") == 0) {
+                sc->loop = (tok[0] == 'l');
+                end_tick = tick;
+                continue;
+            }
+            if (n_events == cap) {
+                cap = cap ? cap * 2 : 64;
+                event_t *grown = realloc(events, cap * sizeof(event_t));
+                if (grown == NULL) {
+                    fprintf(stderr, "Out of memory\n");
+                    rc = -1;
+                    break;
+                }
+                events = grown;
+            }
+            if (parse_event(tok, tick, &events[n_events]) == -1) {
+                fprintf(stderr, "%s:%d: invalid setting '%s'\n", path, line_no, tok);
+                rc = -1;
+                break;
+            }
+            n_events++;
+        }
+
+        // The scenario stops (or starts over) at the end tick: nothing set there would apply
+        if (rc == 0 && end_tick != -1 && n_events > line_events) {
+            fprintf(stderr, "%s:%d: settings on the '%s' line would never apply\n",
+                    path, line_no, sc->loop ? "loop" : "end");
+            rc = -1;
+        }
+    }
+    fclose(f);
+
+    sc->n_steps = (end_tick != -1) ? end_tick : last_tick + 1;
+    if (rc == 0 && sc->n_steps < 1) {
+        fprintf(stderr, "%s: the scenario is empty\n", path);
+        rc = -1;
+    }
+    if (rc == 0) {
+        sc->steps = malloc(sc->n_steps * sizeof(scenario_step_t));
+        if (sc->steps == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            rc = -1;
+        }
+    }
+
+    // Compile: the complete input state of every step
+    if (rc == 0) {
+        scenario_step_t state = defaults;
+        int e = 0;
+        for (long k = 0; k < sc->n_steps; k++) {
+            while (e < n_events && events[e].tick <= k) apply_event(&state, &events[e++]);
+            sc->steps[k] = state;
+        }
+    }
+
+    free(events);
+    if (rc == -1) scenario_free(sc);
+    return rc;
+}
+
+void scenario_free(scenario_t *sc) {
+    free(sc->steps);
+    sc->steps = NULL;
+    sc->n_steps = 0;
+}
+
+const scenario_step_t *scenario_step(const scenario_t *sc, long tick) {
+    if (tick < 0) return &defaults;
+    if (sc->loop) return &sc->steps[tick % sc->n_steps];
+    return (tick < sc->n_steps) ? &sc->steps[tick] : NULL;
+}
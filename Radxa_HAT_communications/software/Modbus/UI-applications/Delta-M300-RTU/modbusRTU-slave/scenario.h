@@ -0,0 +1,76 @@
+/**
+ * @file scenario.h
+ * @brief Scripted load profiles for the RTU slave simulator.
+ *
+ * A scenario file is a list of time-stamped events, one per line:
+ *
+ *   # time_s  key=value ...
+ *   0     run=1 freq=30 load=40
+ *   12.5  load=90 noise=2
+ *   20    fault=7
+ *   25    fault=0 freq=0
+ *   40    loop
+ *
+ *   run=0|1     start or stop the motor (written to the control word)
+ *   freq=HZ     frequency command (written to the frequency register)
+ *   accel=HZ/S  ramp rate while running (default 5)
+ *   decel=HZ/S  coast-down rate when stopped (default 10)
+ *   load=PCT    load torque, 100 = the rated load (default 100)
+ *   noise=PCT   amplitude of the noise on current, voltage and speed
+ *   fault=CODE  trip the drive with this error code, 0 clears it
+ *   end | loop  length of the scenario; with 'loop' it starts over.
+ *               Must be alone on its line: the scenario is over by then
+ *
+ * Times must not decrease. Without 'end' or 'loop' the scenario lasts
+ * until its last event and the final state is kept.
+ *
+ * The file is compiled once into a table holding the complete input state
+ * of every simulation step, so playing it back is an array lookup and the
+ * simulator can run it much faster than real time.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCENARIO_MAX_S    3600    // Longer runs loop a shorter scenario
+
+// --- Inputs of one simulation step (12 bytes) ---
+typedef struct {
+    uint16_t freq_cmd;            // 0.01 Hz, as in the frequency register
+    uint16_t accel;               // 0.1 Hz/s
+    uint16_t decel;               // 0.1 Hz/s
+    uint16_t noise;               // 0.01 %
+    uint16_t fault_code;
+    uint8_t run;
+    uint8_t load;                 // %
+} scenario_step_t;
+
+typedef struct {
+    scenario_step_t *steps;       // One per tick
+    long n_steps;
+    int tick_ms;
+    bool loop;
+} scenario_t;
+
+/**
+ * @brief Reads and compiles a scenario file for a given simulation step.
+ * @return 0 on success, -1 on error (reported on stderr with the line number).
+ */
+int scenario_load(scenario_t *sc, const char *path, int tick_ms);
+
+void scenario_free(scenario_t *sc);
+
+/**
+ * @brief Inputs of a simulation step; a negative tick gives the defaults,
+ *        i.e. the state before the first event.
+ * @return NULL once a scenario without 'loop' is over.
+ */
+const scenario_step_t *scenario_step(const scenario_t *sc, long tick);
+
+#endif // SCENARIO_H
@@ -0,0 +1,321 @@
+/**
+ * @file bridge_map.c
+ * @brief Parsing of map files and translation of payloads and registers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+#include "bridge_map.h"
+
+/**
+ * @brief Parses a whole token as an integer in [min, max] (decimal or 0x hex).
+ */
+static int parse_long(const char *tok, long min, long max, long *out) {
+    char *end;
+    if (tok == NULL) return -1;
+    long v = strtol(tok, &end, 0);
+    if (end == tok || *end != '\0' || v < min || v > max) return -1;
+    *out = v;
+    return 0;
+}
+
+static int copy_name(char *dst, size_t size, const char *src) {
+    if (src == NULL || src[0] == '\0' || strlen(src) >= size) return -1;
+    strcpy(dst, src);
+    return 0;
+}
+
+/**
+ * @brief Parses "timeout=MS" if present.
+ */
+static int parse_timeout(const char *tok, int *timeout_ms) {
+    long v;
+    *timeout_ms = MAP_DEFAULT_TIMEOUT;
+    if (tok == NULL) return 0;
+    if (strncmp(tok, "timeout=", 8) != 0 || parse_long(tok + 8, 1, 60000, &v) == -1) return -1;
+    *timeout_ms = (int)v;
+    return 0;
+}
+
+static int find_bus(const bridge_map_t *m, const char *name) {
+    for (int i = 0; name != NULL && i < m->n_buses; i++) {
+        if (strcmp(m->buses[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/* A topic one subscribes or publishes to literally: no wildcards */
+static int copy_topic(char *dst, const char *src) {
+    if (copy_name(dst, MAP_TOPIC_LEN, src) == -1 || strpbrk(src, "+#") != NULL) return -1;
+    return 0;
+}
+
+static int parse_broker(bridge_map_t *m) {
+    char *tok = strtok(NULL, " \t\r\n");
+    if (copy_name(m->broker, sizeof(m->broker), tok) == -1) return -1;
+
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        long v;
+        if (strncmp(tok, "qos=", 4) == 0) {
+            if (parse_long(tok + 4, 0, 2, &v) == -1) return -1;
+            m->qos = (int)v;
+        } else if (copy_name(m->client_id, sizeof(m->client_id), tok) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int parse_bus(bridge_map_t *m) {
+    map_bus_t *b = &m->buses[m->n_buses];
+    char *name = strtok(NULL, " \t\r\n");
+    char *kind = strtok(NULL, " \t\r\n");
+    char *dev = strtok(NULL, " \t\r\n");
+    long v;
+
+    if (m->n_buses == MAP_MAX_BUSES || find_bus(m, name) != -1) return -1;
+    if (copy_name(b->name, sizeof(b->name), name) == -1 || kind == NULL) return -1;
+    if (copy_name(b->device, sizeof(b->device), dev) == -1) return -1;
+
+    if (strcmp(kind, "rtu") == 0) {
+        b->kind = MAP_BUS_RTU;
+        if (parse_long(strtok(NULL, " \t\r\n"), 1200, 4000000, &v) == -1) return -1;
+        b->baud = (int)v;
+    } else if (strcmp(kind, "tcp") == 0) {
+        b->kind = MAP_BUS_TCP;
+        b->port = 502;
+        char *colon = strchr(b->device, ':');
+        if (colon != NULL) {
+            *colon = '\0';
+            if (parse_long(colon + 1, 1, 65535, &v) == -1) return -1;
+            b->port = (int)v;
+        }
+    } else {
+        return -1;
+    }
+    if (parse_timeout(strtok(NULL, " \t\r\n"), &b->timeout_ms) == -1) return -1;
+    if (strtok(NULL, " \t\r\n") != NULL) return -1;
+    m->n_buses++;
+    return 0;
+}
+
+/**
+ * @brief Parses the BUS SLAVE REGISTER part shared by commands and polls.
+ */
+static int parse_target(const bridge_map_t *m, int *bus, uint8_t *slave, uint16_t *addr) {
+    long s, a;
+    *bus = find_bus(m, strtok(NULL, " \t\r\n"));
+    if (*bus == -1) return -1;
+    if (parse_long(strtok(NULL, " \t\r\n"), 0, 255, &s) == -1) return -1;
+    if (parse_long(strtok(NULL, " \t\r\n"), 0, 0xFFFF, &a) == -1) return -1;
+    *slave = (uint8_t)s;
+    *addr = (uint16_t)a;
+    return 0;
+}
+
+/* Parses "WORD=VALUE,..." */
+static int parse_words(map_command_t *c, char *list) {
+    char *save = NULL;
+    for (char *w = strtok_r(list, ",", &save); w != NULL; w = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(w, '=');
+        long v;
+        if (eq == NULL || c->n_words == MAP_MAX_WORDS) return -1;
+        *eq = '\0';
+        if (copy_name(c->words[c->n_words].word, MAP_NAME_LEN, w) == -1) return -1;
+        if (parse_long(eq + 1, 0, 0xFFFF, &v) == -1) return -1;
+        c->words[c->n_words++].value = (uint16_t)v;
+    }
+    return 0;
+}
+
+static int parse_command(bridge_map_t *m) {
+    map_command_t *c = &m->commands[m->n_commands];
+    char *tok;
+
+    if (m->n_commands == MAP_MAX_COMMANDS) return -1;
+    memset(c, 0, sizeof(*c));
+    c->scale = 1;
+    if (copy_topic(c->topic, strtok(NULL, " \t\r\n")) == -1) return -1;
+    if (map_find_command(m, c->topic) != NULL) return -1;
+    if (parse_target(m, &c->bus, &c->slave, &c->addr) == -1) return -1;
+
+    while ((tok = strtok(NULL, " \t\r\n")) != NULL) {
+        if (tok[0] == 'x' && strchr(tok, '=') == NULL) {
+            char *end;
+            c->scale = strtod(tok + 1, &end);
+            if (end == tok + 1 || *end != '\0' || c->scale <= 0) return -1;
+        } else if (parse_words(c, tok) == -1) {
+            return -1;
+        }
+    }
+    m->n_commands++;
+    return 0;
+}
+
+/* Parses "NAME[/DIVISOR],_,..." */
+static int parse_fields(map_poll_t *p, char *list) {
+    char *save = NULL;
+    for (char *f = strtok_r(list, ",", &save); f != NULL; f = strtok_r(NULL, ",", &save)) {
+        map_field_t *fd = &p->fields[p->n_fields];
+        if (p->n_fields == MAP_MAX_FIELDS || p->n_fields == p->count) return -1;
+        fd->divisor = 1;
+        char *slash = strchr(f, '/');
+        if (slash != NULL) {
+            char *end;
+            *slash = '\0';
+            fd->divisor = strtod(slash + 1, &end);
+            if (end == slash + 1 || *end != '\0' || fd->divisor <= 0) return -1;
+        }
+        if (strcmp(f, "_") == 0) {
+            fd->name[0] = '\0';
+        } else if (copy_name(fd->name, sizeof(fd->name), f) == -1 || strpbrk(f, "\"\\") != NULL) {
+            return -1;
+        }
+        p->n_fields++;
+    }
+    return 0;
+}
+
+static int parse_poll(bridge_map_t *m) {
+    map_poll_t *p = &m->polls[m->n_polls];
+    long v;
+
+    if (m->n_polls == MAP_MAX_POLLS) return -1;
+    memset(p, 0, sizeof(*p));
+    if (copy_topic(p->topic, strtok(NULL, " \t\r\n")) == -1) return -1;
+    if (parse_target(m, &p->bus, &p->slave, &p->addr) == -1) return -1;
+    if (parse_long(strtok(NULL, " \t\r\n"), 1, MAP_MAX_COUNT, &v) == -1) return -1;
+    p->count = (int)v;
+    if (parse_long(strtok(NULL, " \t\r\n"), 10, 3600000, &v) == -1) return -1;
+    p->period_ms = (int)v;
+
+    char *tok = strtok(NULL, " \t\r\n");
+    if (tok != NULL && parse_fields(p, tok) == -1) return -1;
+    if (strtok(NULL, " \t\r\n") != NULL) return -1;
+    m->n_polls++;
+    return 0;
+}
+
+int map_load(bridge_map_t *m, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open map %s\n", path);
+        return -1;
+    }
+
+    memset(m, 0, sizeof(*m));
+    strcpy(m->broker, "tcp://localhost:1883");
+    strcpy(m->client_id, "radxa_mqtt_bridge");
+    m->qos = 1;
+
+    char line[1024];
+    int line_no = 0;
+    int rc = 0;
+
+    while (rc == 0 && fgets(line, sizeof(line), f) != NULL) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash != NULL) *hash = '\0';
+
+        char *tok = strtok(line, " \t\r\n");
+        if (tok == NULL) continue;
+
+        if (strcmp(tok, "broker") == 0) rc = parse_broker(m);
+        else if (strcmp(tok, "bus") == 0) rc = parse_bus(m);
+        else if (strcmp(tok, "command") == 0) rc = parse_command(m);
+        else if (strcmp(tok, "poll") == 0) rc = parse_poll(m);
+        else rc = -1;
+
+        if (rc == -1) fprintf(stderr, "%s:%d: invalid '%s' line\n", path, line_no, tok);
+    }
+    fclose(f);
+
+    if (rc == 0 && m->n_commands == 0 && m->n_polls == 0) {
+        fprintf(stderr, "%s: no command or poll lines\n", path);
+        rc = -1;
+    }
+    return rc;
+}
+
+const map_command_t *map_find_command(const bridge_map_t *m, const char *topic) {
+    for (int i = 0; i < m->n_commands; i++) {
+        if (strcmp(m->commands[i].topic, topic) == 0) return &m->commands[i];
+    }
+    return NULL;
+}
+
+int map_command_value(const map_command_t *c, const void *payload, int len, uint16_t *value) {
+    char buf[128];
+    char *s = buf;
+
+    if (len <= 0 || len >= (int)sizeof(buf)) return -1;
+    memcpy(buf, payload, (size_t)len);
+    buf[len] = '\0';
+
+    // {"value": X} carries the same X as a bare payload
+    if (*s == '{') {
+        s = strstr(s, "\"value\"");
+        if (s == NULL) return -1;
+        s = strchr(s + 7, ':');
+        if (s == NULL) return -1;
+        s++;
+        char *end = s + strcspn(s, ",}");
+        *end = '\0';
+    }
+
+    // Trim blanks and quotes
+    while (isspace((unsigned char)*s) || *s == '"') s++;
+    char *end = s + strlen(s);
+    while (end > s && (isspace((unsigned char)end[-1]) || end[-1] == '"')) *--end = '\0';
+    if (*s == '\0') return -1;
+
+    for (int i = 0; i < c->n_words; i++) {
+        if (strcasecmp(s, c->words[i].word) == 0) {
+            *value = c->words[i].value;
+            return 0;
+        }
+    }
+    if (strcasecmp(s, "true") == 0 || strcasecmp(s, "false") == 0) {
+        *value = (s[0] == 't' || s[0] == 'T');
+        return 0;
+    }
+
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0') return -1;
+    long raw = lround(v * c->scale);
+    if (raw < -32768 || raw > 0xFFFF) return -1;
+    *value = (uint16_t)raw;         // Negative values as two's complement
+    return 0;
+}
+
+int map_poll_format(const map_poll_t *p, const uint16_t *regs, char *buf, size_t len) {
+    size_t n;
+
+    if (p->n_fields == 0) {
+        n = (size_t)snprintf(buf, len, "{\"addr\":%u,\"values\":[", p->addr);
+        for (int i = 0; i < p->count && n < len; i++) {
+            n += (size_t)snprintf(buf + n, len - n, "%s%u", i ? "," : "", regs[i]);
+        }
+        if (n < len) n += (size_t)snprintf(buf + n, len - n, "]}");
+        return n < len ? (int)n : -1;
+    }
+
+    n = (size_t)snprintf(buf, len, "{");
+    int first = 1;
+    for (int i = 0; i < p->n_fields && n < len; i++) {
+        const map_field_t *f = &p->fields[i];
+        if (f->name[0] == '\0') continue;
+        if (f->divisor == 1) {
+            n += (size_t)snprintf(buf + n, len - n, "%s\"%s\":%u", first ? "" : ",", f->name, regs[i]);
+        } else {
+            n += (size_t)snprintf(buf + n, len - n, "%s\"%s\":%.10g", first ? "" : ",", f->name, regs[i] / f->divisor);
+        }
+        first = 0;
+    }
+    if (n < len) n += (size_t)snprintf(buf + n, len - n, "}");
+    return n < len ? (int)n : -1;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file bridge_map.h
+ * @brief Mapping table of the MQTT to Modbus bridge: buses, command topics
+ *        and polled telemetry ranges.
+ *
+ * A map file is a list of lines; '#' starts a comment:
+ *
+ *   broker  URI [CLIENT_ID] [qos=N]
+ *   bus     NAME rtu DEVICE BAUD [timeout=MS]
+ *   bus     NAME tcp HOST[:PORT] [timeout=MS]
+ *   command TOPIC BUS SLAVE REGISTER [xSCALE] [WORD=VALUE,...]
+ *   poll    TOPIC BUS SLAVE REGISTER COUNT PERIOD_MS [FIELD[/DIVISOR],...]
+ *
+ * A command topic takes a number ("60.5"), a JSON object with a "value"
+ * member ({"value": 60.5}), true/false, or one of its words. Numbers are
+ * multiplied by SCALE (default 1) and written to REGISTER of SLAVE.
+ *
+ * A poll reads COUNT registers every PERIOD_MS and publishes them on TOPIC,
+ * either as {"addr":A,"values":[...]} or, with fields, as one JSON member
+ * per register divided by its DIVISOR ('_' skips a register).
+ *
+ * Numbers accept decimal or 0x hex, e.g.
+ *
+ *   command vfd/1/cmd/freq line1 2 0x2001 x100
+ *   poll    vfd/1/telemetry line1 2 0x2103 10 500 freq_out/100,current/10,_,voltage/10
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef BRIDGE_MAP_H
+#define BRIDGE_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAP_MAX_BUSES     8
+#define MAP_MAX_COMMANDS  256
+#define MAP_MAX_POLLS     128
+#define MAP_MAX_WORDS     8
+#define MAP_MAX_FIELDS    32
+#define MAP_MAX_COUNT     125       // Registers in one read (Modbus limit)
+#define MAP_TOPIC_LEN     128
+#define MAP_NAME_LEN      24
+#define MAP_PAYLOAD_LEN   1024      // Longest telemetry payload
+#define MAP_DEFAULT_TIMEOUT  200    // Modbus response timeout in ms
+
+typedef enum {
+    MAP_BUS_RTU,
+    MAP_BUS_TCP
+} map_bus_kind_t;
+
+typedef struct {
+    char name[MAP_NAME_LEN];
+    map_bus_kind_t kind;
+    char device[128];               // Serial device, or host for TCP
+    int baud;                       // RTU only
+    int port;                       // TCP only
+    int timeout_ms;
+} map_bus_t;
+
+typedef struct {
+    char word[MAP_NAME_LEN];
+    uint16_t value;
+} map_word_t;
+
+typedef struct {
+    char topic[MAP_TOPIC_LEN];
+    int bus;                        // Index in buses[]
+    uint8_t slave;
+    uint16_t addr;
+    double scale;
+    map_word_t words[MAP_MAX_WORDS];
+    int n_words;
+} map_command_t;
+
+typedef struct {
+    char name[MAP_NAME_LEN];        // Empty: register not published
+    double divisor;
+} map_field_t;
+
+typedef struct {
+    char topic[MAP_TOPIC_LEN];
+    int bus;
+    uint8_t slave;
+    uint16_t addr;
+    int count;
+    int period_ms;
+    map_field_t fields[MAP_MAX_FIELDS];
+    int n_fields;                   // 0: publish the raw values
+} map_poll_t;
+
+typedef struct {
+    char broker[128];
+    char client_id[64];
+    int qos;
+    map_bus_t buses[MAP_MAX_BUSES];
+    int n_buses;
+    map_command_t commands[MAP_MAX_COMMANDS];
+    int n_commands;
+    map_poll_t polls[MAP_MAX_POLLS];
+    int n_polls;
+} bridge_map_t;
+
+/**
+ * @brief Loads a map file (see the file comment).
+ * @return 0 on success, -1 on error (reported on stderr with the line number).
+ */
+int map_load(bridge_map_t *m, const char *path);
+
+/** @brief Command mapped to a topic, or NULL. */
+const map_command_t *map_find_command(const bridge_map_t *m, const char *topic);
+
+/**
+ * @brief Translates a command payload into the register value to write.
+ * @return 0 on success, -1 if the payload is not a value of this command.
+ */
+int map_command_value(const map_command_t *c, const void *payload, int len, uint16_t *value);
+
+/**
+ * @brief Formats the registers read by a poll as its JSON payload.
+ * @return Length of the payload, or -1 if it does not fit.
+ */
+int map_poll_format(const map_poll_t *p, const uint16_t *regs, char *buf, size_t len);
+
+#endif // BRIDGE_MAP_H
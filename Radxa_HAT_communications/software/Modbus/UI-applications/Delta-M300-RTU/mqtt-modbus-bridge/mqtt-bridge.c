@@ -0,0 +1,641 @@
+/**
+ * @file mqtt-bridge.c
+ * @brief MQTT to Modbus bridge for a line of drives, configured by a map file.
+ *
+ * Command topics become register writes and polled register ranges become
+ * telemetry messages, on any number of RTU buses and Modbus TCP devices
+ * (see bridge_map.h for the map file).
+ *
+ * Features:
+ *   - One thread per bus owns its libmodbus context, so the buses work in
+ *     parallel and frames on one bus never interleave.
+ *   - MQTT -> Modbus: commands go to a bounded queue per bus. A command for
+ *     a register that is still queued replaces the queued value (only the
+ *     latest setpoint matters). The bus thread takes the whole queue at
+ *     once and writes each run of consecutive registers of a slave with
+ *     one FC16 request (FC06 for a single register). Writes go before polls.
+ *   - Modbus -> MQTT: each poll has one slot in a bounded outbox. A reading
+ *     that is still waiting to be published is replaced by the newer one,
+ *     and the main thread publishes everything waiting in one batch. While
+ *     the broker is unreachable the outbox holds the latest reading of
+ *     every poll.
+ *   - Reconnects to the broker (and resubscribes) and to TCP devices.
+ *
+ * Usage:
+ *   $ ./mqtt-bridge [-b broker] [-i client_id] map_file
+ *   -b and -i override the broker line of the map file.
+ *
+ * Dependencies:
+ *   - libmodbus (https://libmodbus.org/)
+ *   - Eclipse Paho MQTT C client (libpaho-mqtt3c)
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <modbus.h>
+#include <MQTTClient.h>
+#include "bridge_map.h"
+
+// --- Bridge Limits ---
+#define WRITE_QUEUE_MAX   64        // Distinct registers waiting for one bus
+#define MAX_WRITE_RUN     123       // Registers in one FC16 request (Modbus limit)
+#define RECONNECT_MS      2000      // Between attempts to reach the broker or a TCP device
+#define PUBLISH_RETRY_MS  10        // When the broker has too many messages in flight
+#define MQTT_TIMEOUT      10000L
+
+// --- RTU Line Settings (Delta MS300 bus) ---
+#define PARITY            'N'
+#define DATA_BITS         8
+#define STOP_BITS         1
+
+typedef struct {
+    uint8_t slave;
+    uint16_t addr;
+    uint16_t value;
+    uint64_t queued_us;             // Arrival of the oldest command it carries
+} write_t;
+
+typedef struct {
+    uint64_t due_us;
+    bool failing;                   // Last read failed (logged once)
+} poll_state_t;
+
+/**
+ * @brief One bus and the thread that owns it.
+ */
+typedef struct {
+    const map_bus_t *conf;
+    int index;
+    pthread_t thread;
+    modbus_t *ctx;                  // Bus thread only
+    bool connected;
+    bool down_logged;
+    uint64_t retry_us;
+
+    // Write queue and statistics, protected by lock
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    write_t pending[WRITE_QUEUE_MAX];
+    int n_pending;
+
+    unsigned long writes;           // Commands accepted
+    unsigned long coalesced;        // Commands that replaced a queued value
+    unsigned long dropped;          // Commands refused because the queue was full
+    unsigned long write_transactions;
+    unsigned long write_errors;
+    unsigned long written;          // Registers written
+    unsigned long polls;
+    unsigned long poll_errors;
+    unsigned long long bus_us;      // Time spent in transactions
+    double cmd_sum_ms;              // Command arrival to the end of its write
+    double cmd_max_ms;
+} bus_t;
+
+static bridge_map_t map;
+static bus_t buses[MAP_MAX_BUSES];
+static poll_state_t poll_state[MAP_MAX_POLLS];
+
+// --- Telemetry Outbox, protected by tlm_lock: one slot per poll ---
+static pthread_mutex_t tlm_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tlm_cond;
+static char tlm_payload[MAP_MAX_POLLS][MAP_PAYLOAD_LEN];
+static int tlm_len[MAP_MAX_POLLS];
+static bool tlm_queued[MAP_MAX_POLLS];
+static int tlm_fifo[MAP_MAX_POLLS];         // Polls waiting, in order of their first reading
+static int tlm_head = 0;
+static int tlm_count = 0;
+static unsigned long stat_tlm_replaced = 0;
+
+// --- MQTT Side (statistics written by the Paho thread or the main thread) ---
+static MQTTClient client;
+static volatile bool mqtt_connected = false;
+static unsigned long stat_commands = 0;
+static unsigned long stat_invalid = 0;
+static unsigned long stat_published = 0;
+static unsigned long stat_publish_failed = 0;
+
+// Global control flag for signal handler
+volatile sig_atomic_t keep_running = 1;
+volatile sig_atomic_t dump_stats = 0;
+
+/**
+ * @brief Signal handler for graceful shutdown (SIGINT/SIGTERM).
+ * @param sig Signal number.
+ */
+void handle_shutdown(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+/**
+ * @brief SIGUSR1 handler: print the statistics on the next loop iteration.
+ */
+void handle_stats(int sig) {
+    (void)sig;
+    dump_stats = 1;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static struct timespec abs_time(uint64_t us) {
+    struct timespec ts = { .tv_sec = (time_t)(us / 1000000), .tv_nsec = (long)(us % 1000000) * 1000 };
+    return ts;
+}
+
+static void init_cond(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static bool is_link_error(int err) {
+    return err == EBADF || err == ECONNRESET || err == EPIPE || err == ENOTCONN || err == ECONNREFUSED;
+}
+
+// ==== MQTT -> Modbus ====
+
+/**
+ * @brief Queues a register write, replacing a queued write to the same register.
+ */
+static void queue_write(bus_t *b, uint8_t slave, uint16_t addr, uint16_t value) {
+    pthread_mutex_lock(&b->lock);
+    int i;
+    for (i = 0; i < b->n_pending; i++) {
+        if (b->pending[i].slave == slave && b->pending[i].addr == addr) break;
+    }
+    if (i < b->n_pending) {
+        b->pending[i].value = value;
+        b->coalesced++;
+        b->writes++;
+    } else if (b->n_pending < WRITE_QUEUE_MAX) {
+        b->pending[b->n_pending++] = (write_t){ .slave = slave, .addr = addr, .value = value, .queued_us = now_us() };
+        b->writes++;
+    } else {
+        b->dropped++;
+    }
+    pthread_cond_signal(&b->cond);
+    pthread_mutex_unlock(&b->lock);
+}
+
+/**
+ * @brief Paho callback: a command arrived (runs on the Paho thread).
+ */
+static int message_arrived(void *context, char *topicName, int topicLen, MQTTClient_message *message) {
+    (void)context;
+    (void)topicLen;
+
+    const map_command_t *c = map_find_command(&map, topicName);
+    uint16_t value;
+    stat_commands++;
+    if (c != NULL && map_command_value(c, message->payload, message->payloadlen, &value) == 0) {
+        queue_write(&buses[c->bus], c->slave, c->addr, value);
+    } else {
+        stat_invalid++;
+        fprintf(stderr, "%s: ignoring payload '%.*s'\n", topicName,
+                message->payloadlen > 64 ? 64 : message->payloadlen, (const char *)message->payload);
+    }
+
+    MQTTClient_freeMessage(&message);
+    MQTTClient_free(topicName);
+    return 1;
+}
+
+static void connection_lost(void *context, char *cause) {
+    (void)context;
+    mqtt_connected = false;
+    fprintf(stderr, "Lost the connection to the broker: %s\n", cause != NULL ? cause : "unknown cause");
+}
+
+// ==== Bus Side ====
+
+/**
+ * @brief Opens the bus if it is not open, at most once every RECONNECT_MS.
+ */
+static bool bus_ready(bus_t *b) {
+    const map_bus_t *c = b->conf;
+
+    if (b->connected) return true;
+    if (now_us() < b->retry_us) return false;
+
+    if (b->ctx == NULL) {
+        b->ctx = c->kind == MAP_BUS_RTU ? modbus_new_rtu(c->device, c->baud, PARITY, DATA_BITS, STOP_BITS)
+                                        : modbus_new_tcp(c->device, c->port);
+        if (b->ctx == NULL) {
+            fprintf(stderr, "Bus %s: unable to create the libmodbus context\n", c->name);
+            b->retry_us = UINT64_MAX;
+            return false;
+        }
+        modbus_set_response_timeout(b->ctx, (uint32_t)(c->timeout_ms / 1000), (uint32_t)(c->timeout_ms % 1000) * 1000);
+    }
+
+    if (modbus_connect(b->ctx) == -1) {
+        if (!b->down_logged) fprintf(stderr, "Bus %s: cannot open %s: %s\n", c->name, c->device, modbus_strerror(errno));
+        b->down_logged = true;
+        b->retry_us = now_us() + RECONNECT_MS * 1000;
+        return false;
+    }
+    if (c->kind == MAP_BUS_RTU) printf("Bus %s: connected to %s @ %d baud\n", c->name, c->device, c->baud);
+    else printf("Bus %s: connected to %s:%d\n", c->name, c->device, c->port);
+    fflush(stdout);
+    b->connected = true;
+    b->down_logged = false;
+    return true;
+}
+
+static void bus_failed(bus_t *b, int err) {
+    if (b->conf->kind == MAP_BUS_TCP && is_link_error(err)) {
+        fprintf(stderr, "Bus %s: link lost: %s\n", b->conf->name, modbus_strerror(err));
+        modbus_close(b->ctx);
+        b->connected = false;
+        b->retry_us = now_us() + RECONNECT_MS * 1000;
+    }
+}
+
+static int cmp_write(const void *a, const void *b) {
+    const write_t *x = a, *y = b;
+    if (x->slave != y->slave) return x->slave - y->slave;
+    return x->addr - y->addr;
+}
+
+/**
+ * @brief Writes a batch: one request per run of consecutive registers of a slave.
+ */
+static void flush_writes(bus_t *b, write_t *batch, int n) {
+    uint16_t values[MAX_WRITE_RUN];
+
+    qsort(batch, (size_t)n, sizeof(write_t), cmp_write);
+    for (int i = 0, len; i < n; i += len) {
+        len = 1;
+        values[0] = batch[i].value;
+        while (i + len < n && len < MAX_WRITE_RUN && batch[i + len].slave == batch[i].slave &&
+               batch[i + len].addr == batch[i].addr + len) {
+            values[len] = batch[i + len].value;
+            len++;
+        }
+
+        uint64_t start = now_us();
+        int rc = -1;
+        if (b->connected) {
+            modbus_set_slave(b->ctx, batch[i].slave);
+            rc = len == 1 ? modbus_write_register(b->ctx, batch[i].addr, values[0])
+                          : modbus_write_registers(b->ctx, batch[i].addr, len, values);
+        }
+        int err = b->connected ? errno : ENOTCONN;
+        uint64_t end = now_us();
+
+        if (rc == -1) {
+            fprintf(stderr, "Bus %s: write of %d register(s) at 0x%04X on slave %d failed: %s\n",
+                    b->conf->name, len, batch[i].addr, batch[i].slave, modbus_strerror(err));
+            if (b->connected) bus_failed(b, err);
+        }
+
+        pthread_mutex_lock(&b->lock);
+        if (rc == -1) b->write_errors++;
+        if (err != ENOTCONN) {
+            b->write_transactions++;
+            b->bus_us += end - start;
+        }
+        for (int k = i; k < i + len && rc != -1; k++) {
+            double ms = (double)(end - batch[k].queued_us) / 1000.0;
+            b->written++;
+            b->cmd_sum_ms += ms;
+            if (ms > b->cmd_max_ms) b->cmd_max_ms = ms;
+        }
+        pthread_mutex_unlock(&b->lock);
+    }
+}
+
+/**
+ * @brief Puts a reading in the outbox, replacing one of the same poll still waiting.
+ */
+static void queue_telemetry(int poll, const char *payload, int len) {
+    pthread_mutex_lock(&tlm_lock);
+    memcpy(tlm_payload[poll], payload, (size_t)len);
+    tlm_len[poll] = len;
+    if (tlm_queued[poll]) {
+        stat_tlm_replaced++;
+    } else {
+        tlm_queued[poll] = true;
+        tlm_fifo[(tlm_head + tlm_count) % MAP_MAX_POLLS] = poll;
+        tlm_count++;
+    }
+    pthread_cond_signal(&tlm_cond);
+    pthread_mutex_unlock(&tlm_lock);
+}
+
+static void run_poll(bus_t *b, int k) {
+    const map_poll_t *p = &map.polls[k];
+    poll_state_t *st = &poll_state[k];
+    uint16_t regs[MAP_MAX_COUNT];
+    char payload[MAP_PAYLOAD_LEN];
+
+    // Keep the cadence, but never fire a burst to catch up
+    st->due_us += (uint64_t)p->period_ms * 1000;
+    if (st->due_us < now_us()) st->due_us = now_us() + (uint64_t)p->period_ms * 1000;
+    if (!b->connected) return;
+
+    uint64_t start = now_us();
+    modbus_set_slave(b->ctx, p->slave);
+    int rc = modbus_read_registers(b->ctx, p->addr, p->count, regs);
+    int err = errno;
+    uint64_t end = now_us();
+
+    pthread_mutex_lock(&b->lock);
+    b->polls++;
+    if (rc == -1) b->poll_errors++;
+    b->bus_us += end - start;
+    pthread_mutex_unlock(&b->lock);
+
+    if (rc == -1) {
+        if (!st->failing) fprintf(stderr, "%s: read failed: %s\n", p->topic, modbus_strerror(err));
+        st->failing = true;
+        bus_failed(b, err);
+        return;
+    }
+    if (st->failing) fprintf(stderr, "%s: reading again\n", p->topic);
+    st->failing = false;
+
+    int len = map_poll_format(p, regs, payload, sizeof(payload));
+    if (len > 0) queue_telemetry(k, payload, len);
+}
+
+/**
+ * @brief Earliest due time of the polls of a bus, UINT64_MAX if it has none.
+ */
+static uint64_t next_poll_us(const bus_t *b) {
+    uint64_t due = UINT64_MAX;
+    for (int k = 0; k < map.n_polls; k++) {
+        if (map.polls[k].bus == b->index && poll_state[k].due_us < due) due = poll_state[k].due_us;
+    }
+    return due;
+}
+
+/**
+ * @brief Bus thread: writes first, then the polls that are due.
+ */
+static void *bus_worker(void *arg) {
+    bus_t *b = (bus_t *)arg;
+    write_t batch[WRITE_QUEUE_MAX];
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        for (;;) {
+            if (!keep_running || b->n_pending > 0) break;
+            uint64_t due = next_poll_us(b);
+            uint64_t now = now_us();
+            if (due <= now) break;
+            // Wake up at least once a second to notice shutdown and reconnect
+            struct timespec ts = abs_time(due < now + 1000000 ? due : now + 1000000);
+            pthread_cond_timedwait(&b->cond, &b->lock, &ts);
+        }
+        if (!keep_running) {
+            pthread_mutex_unlock(&b->lock);
+            break;
+        }
+        int n = b->n_pending;
+        memcpy(batch, b->pending, (size_t)n * sizeof(write_t));
+        b->n_pending = 0;
+        pthread_mutex_unlock(&b->lock);
+
+        bus_ready(b);
+        if (n > 0) flush_writes(b, batch, n);
+
+        // Polls one at a time, returning to the writes as soon as one arrives
+        for (int k = 0; k < map.n_polls && keep_running; k++) {
+            if (map.polls[k].bus != b->index || poll_state[k].due_us > now_us()) continue;
+            run_poll(b, k);
+
+            pthread_mutex_lock(&b->lock);
+            bool writes_waiting = b->n_pending > 0;
+            pthread_mutex_unlock(&b->lock);
+            if (writes_waiting) break;
+        }
+    }
+    return NULL;
+}
+
+// ==== Modbus -> MQTT ====
+
+/**
+ * @brief Connects to the broker and subscribes to every command topic.
+ */
+static bool mqtt_connect(void) {
+    MQTTClient_connectOptions conn_opts = MQTTClient_connectOptions_initializer;
+    int rc;
+
+    conn_opts.keepAliveInterval = 20;
+    conn_opts.cleansession = 1;
+    conn_opts.connectTimeout = 10;
+
+    if ((rc = MQTTClient_connect(client, &conn_opts)) != MQTTCLIENT_SUCCESS) {
+        fprintf(stderr, "Failed to connect to the broker %s, return code: %d\n", map.broker, rc);
+        return false;
+    }
+    for (int i = 0; i < map.n_commands; i++) {
+        if ((rc = MQTTClient_subscribe(client, map.commands[i].topic, map.qos)) != MQTTCLIENT_SUCCESS) {
+            fprintf(stderr, "Failed to subscribe to %s, code: %d\n", map.commands[i].topic, rc);
+            MQTTClient_disconnect(client, 1000);
+            return false;
+        }
+    }
+    printf("Connected to the broker %s, %d command topic(s) subscribed\n", map.broker, map.n_commands);
+    fflush(stdout);
+    mqtt_connected = true;
+    return true;
+}
+
+/**
+ * @brief Publishes every reading in the outbox.
+ *
+ * A reading the client cannot take now goes back to the outbox, unless a
+ * newer one of the same poll arrived meanwhile.
+ * @return false if the broker is not taking messages right now.
+ */
+static bool publish_outbox(void) {
+    static char batch_payload[MAP_MAX_POLLS][MAP_PAYLOAD_LEN];
+    int batch_poll[MAP_MAX_POLLS];
+    int batch_len[MAP_MAX_POLLS];
+    int n = 0;
+
+    pthread_mutex_lock(&tlm_lock);
+    while (tlm_count > 0) {
+        int k = tlm_fifo[tlm_head];
+        tlm_head = (tlm_head + 1) % MAP_MAX_POLLS;
+        tlm_count--;
+        tlm_queued[k] = false;
+        batch_poll[n] = k;
+        batch_len[n] = tlm_len[k];
+        memcpy(batch_payload[n], tlm_payload[k], (size_t)tlm_len[k]);
+        n++;
+    }
+    pthread_mutex_unlock(&tlm_lock);
+
+    for (int i = 0; i < n; i++) {
+        MQTTClient_deliveryToken token;
+        int rc = mqtt_connected ? MQTTClient_publish(client, map.polls[batch_poll[i]].topic, batch_len[i],
+                                                     batch_payload[i], map.qos, 0, &token)
+                                : MQTTCLIENT_DISCONNECTED;
+        if (rc == MQTTCLIENT_SUCCESS) {
+            stat_published++;
+            continue;
+        }
+        if (rc != MQTTCLIENT_MAX_MESSAGES_INFLIGHT && rc != MQTTCLIENT_DISCONNECTED) stat_publish_failed++;
+
+        // Put the rest back for the next attempt
+        pthread_mutex_lock(&tlm_lock);
+        for (int j = i; j < n; j++) {
+            int k = batch_poll[j];
+            if (tlm_queued[k]) continue;
+            tlm_queued[k] = true;
+            tlm_len[k] = batch_len[j];
+            memcpy(tlm_payload[k], batch_payload[j], (size_t)batch_len[j]);
+            tlm_fifo[(tlm_head + tlm_count) % MAP_MAX_POLLS] = k;
+            tlm_count++;
+        }
+        pthread_mutex_unlock(&tlm_lock);
+        return false;
+    }
+    return true;
+}
+
+static void print_stats(void) {
+    for (int i = 0; i < map.n_buses; i++) {
+        bus_t *b = &buses[i];
+        pthread_mutex_lock(&b->lock);
+        unsigned long transactions = b->write_transactions + b->polls;
+        printf("Bus %s: %lu commands (%lu coalesced, %lu dropped) in %lu writes (%lu failed), "
+               "%lu polls (%lu failed), avg %.1f ms/transaction, command latency avg %.1f ms max %.1f ms\n",
+               b->conf->name, b->writes, b->coalesced, b->dropped, b->write_transactions, b->write_errors,
+               b->polls, b->poll_errors,
+               transactions > 0 ? (double)b->bus_us / (double)transactions / 1000.0 : 0.0,
+               b->written > 0 ? b->cmd_sum_ms / (double)b->written : 0.0, b->cmd_max_ms);
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    pthread_mutex_lock(&tlm_lock);
+    unsigned long replaced = stat_tlm_replaced;
+    int waiting = tlm_count;
+    pthread_mutex_unlock(&tlm_lock);
+    printf("MQTT: %lu commands (%lu invalid), %lu readings published (%lu replaced before publishing, "
+           "%lu failed, %d waiting)\n",
+           stat_commands, stat_invalid, stat_published, replaced, stat_publish_failed, waiting);
+    fflush(stdout);
+}
+
+// ==== Setup ====
+
+int main(int argc, char *argv[]) {
+    const char *broker = NULL;
+    const char *client_id = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:i:")) != -1) {
+        switch (opt) {
+            case 'b': broker = optarg; break;
+            case 'i': client_id = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-b broker] [-i client_id] map_file\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-b broker] [-i client_id] map_file\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (map_load(&map, argv[optind]) != 0) return EXIT_FAILURE;
+    if (broker != NULL) snprintf(map.broker, sizeof(map.broker), "%s", broker);
+    if (client_id != NULL) snprintf(map.client_id, sizeof(map.client_id), "%s", client_id);
+
+    int rc;
+    if ((rc = MQTTClient_create(&client, map.broker, map.client_id, MQTTCLIENT_PERSISTENCE_NONE, NULL)) != MQTTCLIENT_SUCCESS) {
+        fprintf(stderr, "Error creating the MQTT client, code: %d\n", rc);
+        return EXIT_FAILURE;
+    }
+    // With callbacks set, commands arrive on the Paho thread and publishing does not block
+    MQTTClient_setCallbacks(client, NULL, connection_lost, message_arrived, NULL);
+
+    struct sigaction sa = { .sa_handler = handle_shutdown };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = handle_stats;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    init_cond(&tlm_cond);
+    uint64_t start = now_us();
+    for (int k = 0; k < map.n_polls; k++) poll_state[k].due_us = start;
+
+    for (int i = 0; i < map.n_buses; i++) {
+        bus_t *b = &buses[i];
+        b->conf = &map.buses[i];
+        b->index = i;
+        pthread_mutex_init(&b->lock, NULL);
+        init_cond(&b->cond);
+        if (pthread_create(&b->thread, NULL, bus_worker, b) != 0) {
+            fprintf(stderr, "Failed to start the thread of bus %s\n", b->conf->name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("MQTT bridge: broker %s as %s, %d bus(es), %d command topic(s), %d poll(s)\n",
+           map.broker, map.client_id, map.n_buses, map.n_commands, map.n_polls);
+    printf("Send SIGUSR1 for statistics, Ctrl+C to exit.\n");
+    fflush(stdout);
+
+    uint64_t retry_us = 0;
+    while (keep_running) {
+        if (!mqtt_connected && now_us() >= retry_us && !mqtt_connect()) {
+            retry_us = now_us() + RECONNECT_MS * 1000;
+        }
+
+        // Wait for readings; a full client or a lost broker is retried shortly
+        pthread_mutex_lock(&tlm_lock);
+        if (tlm_count == 0 && keep_running) {
+            struct timespec ts = abs_time(now_us() + 500000);
+            pthread_cond_timedwait(&tlm_cond, &tlm_lock, &ts);
+        }
+        pthread_mutex_unlock(&tlm_lock);
+
+        if (!publish_outbox()) usleep(mqtt_connected ? PUBLISH_RETRY_MS * 1000 : 100000);
+
+        if (dump_stats) {
+            dump_stats = 0;
+            print_stats();
+        }
+    }
+
+    printf("\nShutting down...\n");
+    for (int i = 0; i < map.n_buses; i++) {
+        pthread_mutex_lock(&buses[i].lock);
+        pthread_cond_signal(&buses[i].cond);
+        pthread_mutex_unlock(&buses[i].lock);
+        pthread_join(buses[i].thread, NULL);
+    }
+    publish_outbox();
+    print_stats();
+
+    if (mqtt_connected) MQTTClient_disconnect(client, MQTT_TIMEOUT);
+    MQTTClient_destroy(&client);
+    for (int i = 0; i < map.n_buses; i++) {
+        if (buses[i].ctx == NULL) continue;
+        modbus_close(buses[i].ctx);
+        modbus_free(buses[i].ctx);
+    }
+    return EXIT_SUCCESS;
+}
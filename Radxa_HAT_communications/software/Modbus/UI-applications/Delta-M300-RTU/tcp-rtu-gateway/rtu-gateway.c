@@ -0,0 +1,800 @@
+/**
+ * @file rtu-gateway.c
+ * @brief Modbus TCP to RTU gateway that shares one RS-485 bus among many clients.
+ *
+ * Only one process can own the serial port. This daemon owns it and exposes
+ * the RTU bus as a Modbus TCP server, so the TUI, VDF-telemetry, hello_rtu or
+ * the web tools can all talk to the drives at the same time.
+ *
+ * Features:
+ *   - Serves up to MAX_CLIENTS TCP clients from one epoll loop.
+ *   - A single serial thread performs one RTU transaction at a time, so
+ *     frames from different clients never interleave on the wire.
+ *   - Fair, prioritized scheduling: each client's requests are executed in
+ *     order, clients are served round-robin, and writes go before reads
+ *     (reads that waited READ_AGING_MS are promoted so they cannot starve).
+ *   - Unit id mapping: the MBAP unit id selects the RTU slave id.
+ *   - Identical concurrent reads (same slave, function, address and count)
+ *     are answered from one bus transaction.
+ *   - Gateway exceptions: 0x0A for unmapped unit ids, 0x0B when the slave
+ *     does not answer, 0x06 when a client has too many requests queued.
+ *
+ * Usage:
+ *   $ ./rtu-gateway [-d device] [-b baud] [-p port] [-s slave] [-m unit=slave,...] [-t timeout_ms]
+ *   Defaults: /dev/ttyS4, 38400 8N1, TCP port 5020, slave 2, 200 ms.
+ *
+ *   Without -m, unit ids 1-247 address the RTU slave with the same id and
+ *   0/255 (the usual "don't care" values of TCP clients) address the default
+ *   slave. With -m, only the listed unit ids are accepted.
+ *
+ * Dependencies:
+ *   - libmodbus (https://libmodbus.org/), used for the RTU side (framing,
+ *     CRC and timing); the TCP side is plain sockets.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <modbus.h>
+
+// --- Serial Defaults (Delta MS300 bus) ---
+#define DEFAULT_DEVICE    "/dev/ttyS4"
+#define DEFAULT_BAUD      38400
+#define PARITY            'N'
+#define DATA_BITS         8
+#define STOP_BITS         1
+#define DEFAULT_SLAVE     2
+#define DEFAULT_PORT      5020
+#define DEFAULT_TIMEOUT   200       // RTU response timeout in ms
+
+// --- Gateway Limits ---
+#define MAX_CLIENTS       64
+#define MAX_PENDING       256       // Requests queued for the bus, all clients
+#define CLIENT_QUEUE_MAX  16        // Requests one client may have outstanding
+#define MAX_WAITERS       16        // Clients sharing one collapsed read
+#define READ_AGING_MS     500       // Reads waiting this long rank like writes
+#define PDU_MAX           253
+#define MBAP_HEADER_LEN   7
+#define RX_BUF_LEN        (2 * (MBAP_HEADER_LEN + PDU_MAX))
+#define TX_BUF_LEN        8192
+
+// --- Modbus Exception Codes Sent by the Gateway ---
+#define EXC_ILLEGAL_FUNCTION  0x01
+#define EXC_BUSY              0x06
+#define EXC_PATH_UNAVAILABLE  0x0A
+#define EXC_TARGET_NO_ANSWER  0x0B
+
+/**
+ * @brief One connected TCP client. Only touched by the epoll thread.
+ */
+typedef struct {
+    int fd;                         // -1 if the slot is free
+    unsigned int gen;               // Bumped on every reuse of the slot
+    int pending;                    // Requests queued or on the bus
+    uint8_t rx[RX_BUF_LEN];
+    size_t rx_len;
+    uint8_t tx[TX_BUF_LEN];         // Responses the socket did not take yet
+    size_t tx_len;
+} client_t;
+
+/**
+ * @brief A client waiting for the result of a bus transaction.
+ */
+typedef struct {
+    int client;                     // Slot in clients[]
+    unsigned int gen;               // Generation of the slot when queued
+    uint16_t tid;                   // MBAP transaction id to answer with
+    uint8_t unit;                   // MBAP unit id to answer with
+} waiter_t;
+
+/**
+ * @brief One RTU transaction, shared by every waiter that asked for it.
+ *
+ * waiters[0] owns the request: its position in that client's order decides
+ * when the transaction may run.
+ */
+typedef struct request {
+    struct request *next;
+    uint8_t slave;
+    uint8_t pdu[PDU_MAX];           // Request PDU, pdu[0] is the function code
+    size_t pdu_len;
+    bool is_write;
+    uint64_t queued_ms;
+    waiter_t waiters[MAX_WAITERS];
+    int n_waiters;
+
+    // Result, written by the serial thread
+    uint8_t rsp[PDU_MAX];           // Response PDU
+    size_t rsp_len;
+    long bus_us;                    // Duration of the transaction
+} request_t;
+
+// --- Bus Queue, protected by bus_lock ---
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bus_cond = PTHREAD_COND_INITIALIZER;
+static request_t *queue_head = NULL;        // Arrival order
+static request_t *queue_tail = NULL;
+static int queue_len = 0;
+static request_t *current = NULL;           // On the bus right now
+static request_t *done_head = NULL;         // Finished, not yet answered
+static request_t *done_tail = NULL;
+static int last_owner = -1;                 // Round-robin cursor
+
+// --- Statistics (bus counters under bus_lock, the rest epoll thread only) ---
+static unsigned long stat_transactions = 0;
+static unsigned long stat_no_answer = 0;
+static unsigned long long stat_bus_us = 0;
+static unsigned long stat_requests = 0;
+static unsigned long stat_collapsed = 0;
+static unsigned long stat_rejected = 0;
+
+static client_t clients[MAX_CLIENTS];
+static uint8_t unit_map[256];               // MBAP unit id -> RTU slave, 0 = unmapped
+static int wake_fd = -1;                    // eventfd, serial thread -> epoll thread
+static modbus_t *rtu_ctx = NULL;
+
+// Global control flag for signal handler
+volatile sig_atomic_t keep_running = 1;
+volatile sig_atomic_t dump_stats = 0;
+
+/**
+ * @brief Signal handler for graceful shutdown (SIGINT/SIGTERM).
+ * @param sig Signal number.
+ */
+void handle_shutdown(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+/**
+ * @brief SIGUSR1 handler: print the statistics on the next loop iteration.
+ */
+void handle_stats(int sig) {
+    (void)sig;
+    dump_stats = 1;
+}
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static bool is_read_function(uint8_t fc) {
+    return fc >= 1 && fc <= 4;
+}
+
+static bool is_supported_function(uint8_t fc) {
+    return is_read_function(fc) || fc == 5 || fc == 6 || fc == 15 || fc == 16 || fc == 23;
+}
+
+// ==== Serial Side ====
+
+/**
+ * @brief Picks the next transaction for the bus and unlinks it from the queue.
+ *
+ * A request is eligible only if none of its waiters has an older request
+ * still queued, which keeps every client's requests in order (a client that
+ * joined a shared read waits for it before its next request runs). Among
+ * the eligible ones, writes and aged reads go first; ties are broken
+ * round-robin starting after the client served last.
+ * Caller holds bus_lock and the queue is not empty.
+ */
+static request_t *pick_next(void) {
+    bool seen[MAX_CLIENTS] = { false };
+    uint64_t now_ms = now_us() / 1000;
+    request_t *best = NULL, *best_prev = NULL;
+    int best_rank = 0;
+
+    for (request_t *r = queue_head, *prev = NULL; r != NULL; prev = r, r = r->next) {
+        int owner = r->waiters[0].client;
+        bool eligible = true;
+        for (int i = 0; i < r->n_waiters; i++) {
+            if (seen[r->waiters[i].client]) eligible = false;
+            seen[r->waiters[i].client] = true;
+        }
+        if (!eligible) continue;
+
+        bool urgent = r->is_write || now_ms - r->queued_ms >= READ_AGING_MS;
+        int distance = (owner - last_owner - 1 + MAX_CLIENTS) % MAX_CLIENTS;
+        int rank = (urgent ? 0 : MAX_CLIENTS) + distance;
+        if (best == NULL || rank < best_rank) {
+            best = r;
+            best_prev = prev;
+            best_rank = rank;
+        }
+    }
+
+    if (best_prev == NULL) {
+        queue_head = best->next;
+    } else {
+        best_prev->next = best->next;
+    }
+    if (queue_tail == best) queue_tail = best_prev;
+    best->next = NULL;
+    queue_len--;
+    last_owner = best->waiters[0].client;
+    return best;
+}
+
+/**
+ * @brief Runs one request on the RTU bus and stores the response PDU.
+ *
+ * Timeouts, CRC errors and malformed frames all become exception 0x0B, the
+ * gateway code for "target device failed to respond".
+ * @return 0 if the slave answered (possibly with an exception), -1 otherwise.
+ */
+static int run_transaction(request_t *r) {
+    uint8_t req[1 + PDU_MAX];
+    uint8_t rsp[MODBUS_RTU_MAX_ADU_LENGTH];
+    uint64_t start = now_us();
+    int rc = -1;
+
+    req[0] = r->slave;
+    memcpy(&req[1], r->pdu, r->pdu_len);
+    modbus_set_slave(rtu_ctx, r->slave);
+
+    if (modbus_send_raw_request(rtu_ctx, req, (int)r->pdu_len + 1) != -1) {
+        rc = modbus_receive_confirmation(rtu_ctx, rsp);
+    }
+
+    // Slave id, PDU and CRC; anything shorter is not a usable answer
+    r->bus_us = (long)(now_us() - start);
+    if (rc >= 4 && rsp[0] == r->slave && (rsp[1] & 0x7F) == r->pdu[0]) {
+        r->rsp_len = (size_t)rc - 3;
+        memcpy(r->rsp, &rsp[1], r->rsp_len);
+        return 0;
+    }
+
+    if (rc != -1 || errno != ETIMEDOUT) modbus_flush(rtu_ctx);
+    r->rsp[0] = r->pdu[0] | 0x80;
+    r->rsp[1] = EXC_TARGET_NO_ANSWER;
+    r->rsp_len = 2;
+    return -1;
+}
+
+/**
+ * @brief Serial thread: executes queued requests back to back.
+ */
+static void *serial_worker(void *arg) {
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&bus_lock);
+        while (queue_head == NULL && keep_running) {
+            pthread_cond_wait(&bus_cond, &bus_lock);
+        }
+        if (!keep_running) {
+            pthread_mutex_unlock(&bus_lock);
+            break;
+        }
+        request_t *r = pick_next();
+        current = r;
+        pthread_mutex_unlock(&bus_lock);
+
+        int rc = run_transaction(r);
+
+        pthread_mutex_lock(&bus_lock);
+        current = NULL;
+        stat_transactions++;
+        stat_bus_us += (unsigned long long)r->bus_us;
+        if (rc != 0) stat_no_answer++;
+        if (done_tail == NULL) {
+            done_head = r;
+        } else {
+            done_tail->next = r;
+        }
+        done_tail = r;
+        pthread_mutex_unlock(&bus_lock);
+
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) == -1) perror("eventfd write");
+    }
+    return NULL;
+}
+
+// ==== TCP Side ====
+
+static void drop_client(int epfd, int idx);
+
+/**
+ * @brief Queues bytes for a client, sending as much as the socket takes now.
+ * @return 0 on success, -1 if the client cannot keep up and was dropped.
+ */
+static int client_send(int epfd, int idx, const uint8_t *data, size_t len) {
+    client_t *cl = &clients[idx];
+
+    if (cl->tx_len == 0) {
+        ssize_t n = send(cl->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            drop_client(epfd, idx);
+            return -1;
+        }
+        if (n > 0) {
+            data += n;
+            len -= (size_t)n;
+        }
+        if (len == 0) return 0;
+    }
+    if (cl->tx_len + len > TX_BUF_LEN) {
+        fprintf(stderr, "Client %d is not reading its responses, dropping it\n", idx);
+        drop_client(epfd, idx);
+        return -1;
+    }
+    memcpy(&cl->tx[cl->tx_len], data, len);
+    cl->tx_len += len;
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.u32 = (uint32_t)idx };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, cl->fd, &ev);
+    return 0;
+}
+
+/**
+ * @brief Sends a response PDU to one waiter, unless its client went away.
+ */
+static void answer(int epfd, const waiter_t *w, const uint8_t *pdu, size_t len) {
+    client_t *cl = &clients[w->client];
+    uint8_t adu[MBAP_HEADER_LEN + PDU_MAX];
+
+    if (cl->fd < 0 || cl->gen != w->gen) return;
+    adu[0] = (uint8_t)(w->tid >> 8);
+    adu[1] = (uint8_t)(w->tid & 0xFF);
+    adu[2] = 0;
+    adu[3] = 0;
+    adu[4] = (uint8_t)((len + 1) >> 8);
+    adu[5] = (uint8_t)((len + 1) & 0xFF);
+    adu[6] = w->unit;
+    memcpy(&adu[MBAP_HEADER_LEN], pdu, len);
+    client_send(epfd, w->client, adu, MBAP_HEADER_LEN + len);
+}
+
+static void answer_exception(int epfd, const waiter_t *w, uint8_t fc, uint8_t code) {
+    uint8_t pdu[2] = { (uint8_t)(fc | 0x80), code };
+    answer(epfd, w, pdu, sizeof(pdu));
+}
+
+/**
+ * @brief Finds a queued or running read identical to this one.
+ * Caller holds bus_lock.
+ */
+static request_t *find_identical_read(uint8_t slave, const uint8_t *pdu, size_t len) {
+    if (current != NULL && current->slave == slave && !current->is_write &&
+        current->pdu_len == len && memcmp(current->pdu, pdu, len) == 0 &&
+        current->n_waiters < MAX_WAITERS) {
+        return current;
+    }
+    for (request_t *r = queue_head; r != NULL; r = r->next) {
+        if (r->slave == slave && !r->is_write && r->pdu_len == len &&
+            memcmp(r->pdu, pdu, len) == 0 && r->n_waiters < MAX_WAITERS) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Routes one MBAP request to the bus queue.
+ */
+static void handle_request(int epfd, int idx, uint16_t tid, uint8_t unit, const uint8_t *pdu, size_t len) {
+    client_t *cl = &clients[idx];
+    waiter_t w = { .client = idx, .gen = cl->gen, .tid = tid, .unit = unit };
+    uint8_t fc = pdu[0];
+    uint8_t slave = unit_map[unit];
+
+    stat_requests++;
+    if (!is_supported_function(fc)) {
+        answer_exception(epfd, &w, fc, EXC_ILLEGAL_FUNCTION);
+        return;
+    }
+    if (slave == 0) {
+        answer_exception(epfd, &w, fc, EXC_PATH_UNAVAILABLE);
+        return;
+    }
+
+    pthread_mutex_lock(&bus_lock);
+
+    // A client with nothing outstanding may share a read that is already
+    // queued or running; one with earlier requests must wait its turn
+    if (is_read_function(fc) && cl->pending == 0) {
+        request_t *r = find_identical_read(slave, pdu, len);
+        if (r != NULL) {
+            r->waiters[r->n_waiters++] = w;
+            cl->pending++;
+            stat_collapsed++;
+            pthread_mutex_unlock(&bus_lock);
+            return;
+        }
+    }
+
+    request_t *r = NULL;
+    if (cl->pending < CLIENT_QUEUE_MAX && queue_len < MAX_PENDING) {
+        r = calloc(1, sizeof(*r));
+    }
+    if (r == NULL) {
+        pthread_mutex_unlock(&bus_lock);
+        stat_rejected++;
+        answer_exception(epfd, &w, fc, EXC_BUSY);
+        return;
+    }
+
+    r->slave = slave;
+    memcpy(r->pdu, pdu, len);
+    r->pdu_len = len;
+    r->is_write = !is_read_function(fc);
+    r->queued_ms = now_us() / 1000;
+    r->waiters[0] = w;
+    r->n_waiters = 1;
+    cl->pending++;
+
+    if (queue_tail == NULL) {
+        queue_head = r;
+    } else {
+        queue_tail->next = r;
+    }
+    queue_tail = r;
+    queue_len++;
+    pthread_cond_signal(&bus_cond);
+    pthread_mutex_unlock(&bus_lock);
+}
+
+/**
+ * @brief Cuts complete MBAP frames out of a client's receive buffer.
+ * @return 0 on success, -1 if the stream is not Modbus TCP.
+ */
+static int parse_frames(int epfd, int idx) {
+    client_t *cl = &clients[idx];
+    unsigned int gen = cl->gen;
+    size_t off = 0;
+
+    while (cl->rx_len - off >= MBAP_HEADER_LEN) {
+        const uint8_t *h = &cl->rx[off];
+        uint16_t tid = (uint16_t)((h[0] << 8) | h[1]);
+        uint16_t proto = (uint16_t)((h[2] << 8) | h[3]);
+        uint16_t length = (uint16_t)((h[4] << 8) | h[5]);
+
+        if (proto != 0 || length < 2 || length > PDU_MAX + 1) return -1;
+        if (cl->rx_len - off < 6 + (size_t)length) break;
+
+        handle_request(epfd, idx, tid, h[6], &h[MBAP_HEADER_LEN], (size_t)length - 1);
+        if (cl->fd < 0 || cl->gen != gen) return 0;     // Dropped while answering
+        off += 6 + (size_t)length;
+    }
+    memmove(cl->rx, &cl->rx[off], cl->rx_len - off);
+    cl->rx_len -= off;
+    return 0;
+}
+
+/**
+ * @brief Closes a client and removes it from every queued request.
+ *
+ * Requests nobody waits for any more are discarded before they reach the
+ * bus. A request already running completes and its answer is dropped.
+ */
+static void drop_client(int epfd, int idx) {
+    client_t *cl = &clients[idx];
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, cl->fd, NULL);
+    close(cl->fd);
+    cl->fd = -1;
+    cl->gen++;
+    cl->pending = 0;
+    cl->rx_len = 0;
+    cl->tx_len = 0;
+
+    pthread_mutex_lock(&bus_lock);
+    for (request_t *r = queue_head, *prev = NULL, *next; r != NULL; r = next) {
+        next = r->next;
+        int n = 0;
+        for (int i = 0; i < r->n_waiters; i++) {
+            if (r->waiters[i].client != idx) r->waiters[n++] = r->waiters[i];
+        }
+        r->n_waiters = n;
+        if (n > 0) {
+            prev = r;
+            continue;
+        }
+        if (prev == NULL) {
+            queue_head = next;
+        } else {
+            prev->next = next;
+        }
+        if (queue_tail == r) queue_tail = prev;
+        queue_len--;
+        free(r);
+    }
+    pthread_mutex_unlock(&bus_lock);
+}
+
+/**
+ * @brief Answers every waiter of the transactions the serial thread finished.
+ */
+static void deliver_results(int epfd) {
+    uint64_t count;
+
+    if (read(wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) perror("eventfd read");
+
+    pthread_mutex_lock(&bus_lock);
+    request_t *r = done_head;
+    done_head = done_tail = NULL;
+    pthread_mutex_unlock(&bus_lock);
+
+    while (r != NULL) {
+        request_t *next = r->next;
+        for (int i = 0; i < r->n_waiters; i++) {
+            const waiter_t *w = &r->waiters[i];
+            if (clients[w->client].fd < 0 || clients[w->client].gen != w->gen) continue;
+            clients[w->client].pending--;
+            answer(epfd, w, r->rsp, r->rsp_len);
+        }
+        free(r);
+        r = next;
+    }
+}
+
+static void accept_clients(int epfd, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) return;
+
+        int idx = -1;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0) {
+                idx = i;
+                break;
+            }
+        }
+        if (idx < 0) {
+            fprintf(stderr, "Too many clients (max %d), rejecting connection\n", MAX_CLIENTS);
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        clients[idx].fd = fd;
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)idx };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void client_readable(int epfd, int idx) {
+    client_t *cl = &clients[idx];
+
+    for (;;) {
+        ssize_t n = recv(cl->fd, &cl->rx[cl->rx_len], RX_BUF_LEN - cl->rx_len, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            drop_client(epfd, idx);
+            return;
+        }
+        if (n < 0) return;
+        cl->rx_len += (size_t)n;
+        if (parse_frames(epfd, idx) != 0) {
+            fprintf(stderr, "Client %d sent a malformed MBAP frame, dropping it\n", idx);
+            drop_client(epfd, idx);
+            return;
+        }
+        if (cl->fd < 0) return;
+    }
+}
+
+static void client_writable(int epfd, int idx) {
+    client_t *cl = &clients[idx];
+
+    ssize_t n = send(cl->fd, cl->tx, cl->tx_len, MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        drop_client(epfd, idx);
+        return;
+    }
+    if (n > 0) {
+        memmove(cl->tx, &cl->tx[n], cl->tx_len - (size_t)n);
+        cl->tx_len -= (size_t)n;
+    }
+    if (cl->tx_len == 0) {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)idx };
+        epoll_ctl(epfd, EPOLL_CTL_MOD, cl->fd, &ev);
+    }
+}
+
+static void print_stats(void) {
+    pthread_mutex_lock(&bus_lock);
+    unsigned long transactions = stat_transactions;
+    unsigned long no_answer = stat_no_answer;
+    unsigned long long bus_us = stat_bus_us;
+    int queued = queue_len;
+    pthread_mutex_unlock(&bus_lock);
+
+    printf("Requests: %lu, bus transactions: %lu (avg %.1f ms), shared reads: %lu, "
+           "no answer: %lu, rejected: %lu, queued: %d\n",
+           stat_requests, transactions,
+           transactions > 0 ? (double)bus_us / (double)transactions / 1000.0 : 0.0,
+           stat_collapsed, no_answer, stat_rejected, queued);
+    fflush(stdout);
+}
+
+// ==== Setup ====
+
+/**
+ * @brief Parses a '-m unit=slave,...' list into unit_map.
+ * @return 0 on success, -1 if an entry is malformed.
+ */
+static int parse_unit_map(const char *arg) {
+    memset(unit_map, 0, sizeof(unit_map));
+    while (*arg != '\0') {
+        char *end;
+        long unit = strtol(arg, &end, 10);
+        if (*end != '=' || unit < 0 || unit > 255) return -1;
+        long slave = strtol(end + 1, &end, 10);
+        if (slave < 1 || slave > 247 || (*end != ',' && *end != '\0')) return -1;
+        unit_map[unit] = (uint8_t)slave;
+        arg = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons((uint16_t)port),
+                                .sin_addr.s_addr = htonl(INADDR_ANY) };
+
+    if (fd == -1) return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, MAX_CLIENTS) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    const char *device = DEFAULT_DEVICE;
+    int baud = DEFAULT_BAUD;
+    int port = DEFAULT_PORT;
+    int default_slave = DEFAULT_SLAVE;
+    int timeout_ms = DEFAULT_TIMEOUT;
+    const char *map_arg = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:b:p:s:m:t:")) != -1) {
+        switch (opt) {
+            case 'd': device = optarg; break;
+            case 'b': baud = atoi(optarg); break;
+            case 'p': port = atoi(optarg); break;
+            case 's': default_slave = atoi(optarg); break;
+            case 'm': map_arg = optarg; break;
+            case 't': timeout_ms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-d device] [-b baud] [-p port] [-s slave] "
+                                "[-m unit=slave,...] [-t timeout_ms]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (default_slave < 1 || default_slave > 247 || timeout_ms <= 0 || port <= 0 || port > 65535) {
+        fprintf(stderr, "Invalid slave id (1-247), timeout or port\n");
+        return EXIT_FAILURE;
+    }
+
+    if (map_arg != NULL) {
+        if (parse_unit_map(map_arg) != 0) {
+            fprintf(stderr, "Invalid unit map '%s', expected unit=slave,...\n", map_arg);
+            return EXIT_FAILURE;
+        }
+    } else {
+        for (int u = 1; u <= 247; u++) unit_map[u] = (uint8_t)u;
+        unit_map[0] = (uint8_t)default_slave;
+        unit_map[255] = (uint8_t)default_slave;
+    }
+
+    // Serial side
+    rtu_ctx = modbus_new_rtu(device, baud, PARITY, DATA_BITS, STOP_BITS);
+    if (rtu_ctx == NULL) {
+        fprintf(stderr, "Unable to create the libmodbus context\n");
+        return EXIT_FAILURE;
+    }
+    modbus_set_response_timeout(rtu_ctx, (uint32_t)(timeout_ms / 1000), (uint32_t)(timeout_ms % 1000) * 1000);
+    if (modbus_connect(rtu_ctx) == -1) {
+        fprintf(stderr, "Connection to %s failed: %s\n", device, modbus_strerror(errno));
+        modbus_free(rtu_ctx);
+        return EXIT_FAILURE;
+    }
+
+    // TCP side
+    int listen_fd = open_listener(port);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listen_fd == -1 || epfd == -1 || wake_fd == -1) {
+        fprintf(stderr, "Cannot listen on port %d: %s\n", port, strerror(errno));
+        modbus_close(rtu_ctx);
+        modbus_free(rtu_ctx);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) clients[i].fd = -1;
+
+    // Listener and eventfd are tagged past the client slot range
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = MAX_CLIENTS };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.u32 = MAX_CLIENTS + 1;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    struct sigaction sa = { .sa_handler = handle_shutdown };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = handle_stats;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    pthread_t serial_thread;
+    if (pthread_create(&serial_thread, NULL, serial_worker, NULL) != 0) {
+        fprintf(stderr, "Failed to start the serial thread\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("RTU gateway: %s @ %d baud <-> TCP port %d (default slave %d, timeout %d ms)\n",
+           device, baud, port, default_slave, timeout_ms);
+    printf("Send SIGUSR1 for statistics, Ctrl+C to exit.\n");
+    fflush(stdout);
+
+    struct epoll_event events[MAX_CLIENTS + 2];
+    while (keep_running) {
+        int n = epoll_wait(epfd, events, MAX_CLIENTS + 2, 1000);
+        if (n == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+
+            if (tag == MAX_CLIENTS) {
+                accept_clients(epfd, listen_fd);
+            } else if (tag == MAX_CLIENTS + 1) {
+                deliver_results(epfd);
+            } else if (clients[tag].fd >= 0) {
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    drop_client(epfd, (int)tag);
+                    continue;
+                }
+                if (events[i].events & EPOLLOUT) client_writable(epfd, (int)tag);
+                if (clients[tag].fd >= 0 && (events[i].events & EPOLLIN)) {
+                    client_readable(epfd, (int)tag);
+                }
+            }
+        }
+        if (dump_stats) {
+            dump_stats = 0;
+            print_stats();
+        }
+    }
+
+    printf("\nShutting down...\n");
+    pthread_mutex_lock(&bus_lock);
+    pthread_cond_signal(&bus_cond);
+    pthread_mutex_unlock(&bus_lock);
+    pthread_join(serial_thread, NULL);
+    print_stats();
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    close(listen_fd);
+    close(epfd);
+    close(wake_fd);
+    modbus_close(rtu_ctx);
+    modbus_free(rtu_ctx);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,351 @@
+/**
+ * @file virtual-bus.c
+ * @brief Virtual RS-485 bus made of two pseudo-terminals, for tests without hardware.
+ *
+ * Every RTU tool in this project expects a real serial port. This harness
+ * creates two PTY pairs and relays bytes between them, so a slave (usually
+ * rtu-slave) can open one end and a master (the TUI, VDF-telemetry,
+ * hello_rtu...) the other, on any Linux machine.
+ *
+ * Features:
+ *   - Optional baud-rate pacing: each byte takes 10 bit times (8N1) on the
+ *     wire, so request/response latencies match a real bus at that speed.
+ *   - Optional extra gap after every character, to exercise the
+ *     inter-character timing of the receivers.
+ *   - Can start the slave and the master commands itself. The PTY paths are
+ *     exported as $VBUS_SLAVE and $VBUS_MASTER and can also be symlinked to
+ *     fixed paths. The harness exits with the status of the master command.
+ *   - Prints the bytes carried in each direction and the line occupancy.
+ *
+ * Usage:
+ *   $ ./virtual-bus [-b baud] [-g gap_us] [-S slave_link] [-M master_link]
+ *                   [-s slave_cmd] [-m master_cmd] [-w start_delay_ms]
+ *
+ *   Without -m, the bus runs until Ctrl+C.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#define QUEUE_LEN         4096    // Bytes in flight per direction
+#define BITS_PER_CHAR     10      // Start + 8 data + stop
+#define DEFAULT_WAIT_MS   200     // Time the slave gets to open its port
+
+// --- One end of the bus: the PTY master we relay through ---
+typedef struct {
+    int master_fd;
+    int slave_fd;                 // Kept open so the PTY never hangs up between tool runs
+    char path[64];
+    const char *link;
+} bus_end_t;
+
+// --- Bytes travelling in one direction, each with its delivery time ---
+typedef struct {
+    uint8_t data[QUEUE_LEN];
+    int64_t due_ns[QUEUE_LEN];
+    unsigned int head;            // Next byte to deliver
+    unsigned int tail;            // Next free slot
+    int64_t line_free_ns;         // When the last queued byte finishes on the wire
+    unsigned long bytes;
+    int64_t busy_ns;
+} lane_t;
+
+volatile sig_atomic_t keep_running = 1;
+
+/**
+ * @brief Signal handler for graceful shutdown (SIGINT/SIGTERM).
+ */
+void handle_shutdown(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief Creates a raw PTY pair and optionally a symlink to its slave side.
+ * @return 0 on success, -1 on failure.
+ */
+static int open_bus_end(bus_end_t *end, const char *link) {
+    struct termios tio;
+
+    if (openpty(&end->master_fd, &end->slave_fd, end->path, NULL, NULL) == -1) {
+        fprintf(stderr, "openpty failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Raw on both sides: no echo, no line discipline, 8-bit clean
+    tcgetattr(end->slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(end->slave_fd, TCSANOW, &tio);
+
+    fcntl(end->master_fd, F_SETFL, fcntl(end->master_fd, F_GETFL) | O_NONBLOCK);
+    fcntl(end->master_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(end->slave_fd, F_SETFD, FD_CLOEXEC);
+
+    end->link = link;
+    if (link != NULL) {
+        unlink(link);
+        if (symlink(end->path, link) == -1) {
+            fprintf(stderr, "Cannot create %s: %s\n", link, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void close_bus_end(bus_end_t *end) {
+    if (end->link != NULL) unlink(end->link);
+    close(end->master_fd);
+    close(end->slave_fd);
+}
+
+static unsigned int lane_count(const lane_t *lane) {
+    return lane->tail - lane->head;
+}
+
+/**
+ * @brief Reads what one end has sent and schedules it on the wire.
+ *
+ * With pacing, byte i of a burst is delivered once it has been fully
+ * transmitted: char_ns after the previous byte (plus the gap), never earlier
+ * than the moment it was written.
+ */
+static void lane_fill(lane_t *lane, int from_fd, int64_t char_ns, int64_t gap_ns) {
+    uint8_t buf[512];
+    unsigned int space = QUEUE_LEN - lane_count(lane);
+    if (space == 0) return;
+    if (space > sizeof(buf)) space = sizeof(buf);
+
+    ssize_t n = read(from_fd, buf, space);
+    if (n <= 0) return;   // EAGAIN, or EIO while nobody has the slave side open
+
+    int64_t now = now_ns();
+    for (ssize_t i = 0; i < n; i++) {
+        unsigned int slot = lane->tail % QUEUE_LEN;
+        int64_t start = lane->line_free_ns > now ? lane->line_free_ns : now;
+
+        lane->data[slot] = buf[i];
+        lane->due_ns[slot] = start + char_ns;
+        lane->line_free_ns = start + char_ns + gap_ns;
+        lane->busy_ns += char_ns;
+        lane->tail++;
+    }
+    lane->bytes += n;
+}
+
+/**
+ * @brief Delivers every byte whose time has come.
+ */
+static void lane_drain(lane_t *lane, int to_fd) {
+    uint8_t buf[512];
+    int64_t now = now_ns();
+    unsigned int n = 0;
+
+    while (n < sizeof(buf) && lane->head + n != lane->tail &&
+           lane->due_ns[(lane->head + n) % QUEUE_LEN] <= now) {
+        buf[n] = lane->data[(lane->head + n) % QUEUE_LEN];
+        n++;
+    }
+    if (n == 0) return;
+
+    ssize_t w = write(to_fd, buf, n);
+    if (w > 0) lane->head += w;
+}
+
+/**
+ * @brief Starts a shell command in the background.
+ *
+ * The slave gets its own process group, so that stopping it also stops
+ * whatever the shell started. The master stays in ours, because it may
+ * need the terminal (the TUI).
+ *
+ * @return Child pid, or -1 on failure.
+ */
+static pid_t spawn(const char *cmd, bool own_group) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (own_group) setpgid(0, 0);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    if (pid == -1) fprintf(stderr, "fork failed: %s\n", strerror(errno));
+    return pid;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-b baud] [-g gap_us] [-S slave_link] [-M master_link]\n"
+            "          [-s slave_cmd] [-m master_cmd] [-w start_delay_ms]\n"
+            "  -b  Pace the bus at this baud rate (default: no pacing)\n"
+            "  -g  Extra idle time after every character, in microseconds\n"
+            "  -S  Symlink to the slave side PTY\n"
+            "  -M  Symlink to the master side PTY\n"
+            "  -s  Slave command, run with $VBUS_SLAVE set\n"
+            "  -m  Master command, run with $VBUS_MASTER set; the bus stops when it exits\n"
+            "  -w  Delay between starting the slave and the master (default %d ms)\n",
+            prog, DEFAULT_WAIT_MS);
+}
+
+int main(int argc, char *argv[]) {
+    long baud = 0;
+    long gap_us = 0;
+    long wait_ms = DEFAULT_WAIT_MS;
+    const char *slave_link = NULL;
+    const char *master_link = NULL;
+    const char *slave_cmd = NULL;
+    const char *master_cmd = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:g:S:M:s:m:w:h")) != -1) {
+        switch (opt) {
+            case 'b': baud = strtol(optarg, NULL, 10); break;
+            case 'g': gap_us = strtol(optarg, NULL, 10); break;
+            case 'S': slave_link = optarg; break;
+            case 'M': master_link = optarg; break;
+            case 's': slave_cmd = optarg; break;
+            case 'm': master_cmd = optarg; break;
+            case 'w': wait_ms = strtol(optarg, NULL, 10); break;
+            default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (baud < 0 || gap_us < 0 || wait_ms < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int64_t char_ns = baud > 0 ? (int64_t)BITS_PER_CHAR * 1000000000LL / baud : 0;
+    int64_t gap_ns = gap_us * 1000;
+
+    bus_end_t slave_end = {0}, master_end = {0};
+    if (open_bus_end(&slave_end, slave_link) == -1 || open_bus_end(&master_end, master_link) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    setenv("VBUS_SLAVE", slave_end.path, 1);
+    setenv("VBUS_MASTER", master_end.path, 1);
+
+    fprintf(stderr, "Virtual bus: slave side %s, master side %s", slave_end.path, master_end.path);
+    if (baud > 0) {
+        fprintf(stderr, ", paced at %ld baud (%.1f us/char)", baud, char_ns / 1000.0);
+    }
+    fprintf(stderr, "\n");
+
+    signal(SIGINT, handle_shutdown);
+    signal(SIGTERM, handle_shutdown);
+    signal(SIGPIPE, SIG_IGN);
+
+    pid_t slave_pid = -1, master_pid = -1;
+    int64_t master_start_ns = 0;
+    int exit_code = EXIT_SUCCESS;
+
+    if (slave_cmd != NULL) {
+        slave_pid = spawn(slave_cmd, true);
+        if (slave_pid == -1) keep_running = 0;
+    }
+    if (master_cmd != NULL) {
+        master_start_ns = now_ns() + (slave_cmd != NULL ? wait_ms * 1000000LL : 0);
+    }
+
+    lane_t to_master = {0}, to_slave = {0};
+    int64_t start_ns = now_ns();
+
+    while (keep_running) {
+        struct pollfd pfd[2] = {
+            { .fd = slave_end.master_fd, .events = 0 },
+            { .fd = master_end.master_fd, .events = 0 },
+        };
+        if (lane_count(&to_master) < QUEUE_LEN) pfd[0].events |= POLLIN;
+        if (lane_count(&to_slave) < QUEUE_LEN) pfd[1].events |= POLLIN;
+
+        // Wake up for the next delivery, and at least every 50 ms to reap children
+        int64_t now = now_ns();
+        int64_t deadline = now + 50000000LL;
+        if (lane_count(&to_master) > 0 && to_master.due_ns[to_master.head % QUEUE_LEN] < deadline) {
+            deadline = to_master.due_ns[to_master.head % QUEUE_LEN];
+        }
+        if (lane_count(&to_slave) > 0 && to_slave.due_ns[to_slave.head % QUEUE_LEN] < deadline) {
+            deadline = to_slave.due_ns[to_slave.head % QUEUE_LEN];
+        }
+        if (master_cmd != NULL && master_pid == -1 && master_start_ns < deadline) {
+            deadline = master_start_ns;
+        }
+        int64_t wait_ns = deadline > now ? deadline - now : 0;
+        struct timespec timeout = { .tv_sec = wait_ns / 1000000000LL, .tv_nsec = wait_ns % 1000000000LL };
+
+        int rc = ppoll(pfd, 2, &timeout, NULL);
+        if (rc == -1 && errno != EINTR) {
+            fprintf(stderr, "ppoll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (rc > 0) {
+            if (pfd[0].revents & POLLIN) lane_fill(&to_master, slave_end.master_fd, char_ns, gap_ns);
+            if (pfd[1].revents & POLLIN) lane_fill(&to_slave, master_end.master_fd, char_ns, gap_ns);
+        }
+        lane_drain(&to_master, master_end.master_fd);
+        lane_drain(&to_slave, slave_end.master_fd);
+
+        if (master_cmd != NULL && master_pid == -1 && now_ns() >= master_start_ns) {
+            master_pid = spawn(master_cmd, false);
+            if (master_pid == -1) break;
+        }
+
+        int status;
+        if (slave_pid > 0 && waitpid(slave_pid, &status, WNOHANG) == slave_pid) {
+            fprintf(stderr, "Slave command exited (status %d)\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+            slave_pid = -1;
+            if (master_pid == -1) exit_code = EXIT_FAILURE;
+            break;
+        }
+        if (master_pid > 0 && waitpid(master_pid, &status, WNOHANG) == master_pid) {
+            exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+            master_pid = -1;
+            break;
+        }
+    }
+
+    // Stop whatever is still running
+    if (master_pid > 0) {
+        kill(master_pid, SIGTERM);
+        waitpid(master_pid, NULL, 0);
+        exit_code = EXIT_FAILURE;
+    }
+    if (slave_pid > 0) {
+        kill(-slave_pid, SIGTERM);
+        waitpid(slave_pid, NULL, 0);
+    }
+
+    double elapsed = (now_ns() - start_ns) / 1e9;
+    fprintf(stderr, "Bus: %lu bytes master->slave, %lu bytes slave->master in %.2f s",
+            to_slave.bytes, to_master.bytes, elapsed);
+    if (baud > 0 && elapsed > 0) {
+        fprintf(stderr, ", line busy %.1f%%", 100.0 * (to_slave.busy_ns + to_master.busy_ns) / 1e9 / elapsed);
+    }
+    fprintf(stderr, "\n");
+
+    close_bus_end(&slave_end);
+    close_bus_end(&master_end);
+    return exit_code;
+}
@@ -1,23 +1,59 @@
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <math.h>
 #include "modbus.h"
+#include "ramp.h"
+#include "pulse.h"
 
 #define SERVER_IP "192.168.0.52"
 #define TAB_REG_NUM 10
 #define START_REG 0
 #define READ_REG_NUM TAB_REG_NUM
 
+/* Frequency ramp on register 0 (Hz * 100) */
+#define FREQ_REG 0
+#define RAMP_PROFILE "linear:0:60:6"
+#define RAMP_PERIOD_MS 50
+
 /* Push bottons */
 #define FWD_REV 1
 #define RUN 2
 #define STOP 3
 
+/* How a button press is sent (see pulse.h) */
+static pulse_mode_t pulse_mode = PULSE_TWICE;
+
 void read_server(modbus_t *mb);
-void push_btn(modbus_t *mb, uint8_t reg);
+int push_btn(modbus_t *mb, uint8_t reg);
+double elapsed_ms(const struct timespec *t0);
+void run_ramp(modbus_t *mb, const ramp_profile_t *profile, int period_ms);
+
+/* Usage: ./hello_modbus [twice|auto|coil] [profile [period_ms]] */
+int main(int argc, char *argv[]) {
+  ramp_profile_t profile;
+  const char *spec = argc > 2 ? argv[2] : RAMP_PROFILE;
+  int period_ms = argc > 3 ? atoi(argv[3]) : RAMP_PERIOD_MS;
+  double min_hz, max_hz;
+
+  if (argc > 1 && pulse_parse(argv[1], &pulse_mode) == -1) argc = -1;
+  if (argc < 0 || ramp_parse(&profile, spec) == -1 || period_ms < 1 || period_ms > 10000) {
+    fprintf(stderr, "Usage: %s [twice|auto|coil] [profile [period_ms]]\n"
+                    "  profile: linear|scurve:FROM:TO:SECONDS or linear|scurve:T=HZ,T=HZ,...\n"
+                    "           (default %s, one write every %d ms)\n",
+            argv[0], RAMP_PROFILE, RAMP_PERIOD_MS);
+    return -1;
+  }
+  ramp_bounds(&profile, &min_hz, &max_hz);
+  if (min_hz < 0 || max_hz > 60) {
+    fprintf(stderr, "Ramp frequencies must be within 0-60 Hz\n");
+    return -1;
+  }
 
-int main(void) {
   /* Init coommunication */
   modbus_t *mb = modbus_new_tcp(SERVER_IP, MODBUS_TCP_DEFAULT_PORT);
   if (mb == NULL){
@@ -30,17 +66,32 @@ int main(void) {
     return -1;
   }
   
+  /* Time every button press to compare pulse modes */
+  double total_ms = 0, max_ms = 0;
+  int presses = 0;
+  uint8_t sequence[] = {FWD_REV, STOP, RUN};
   for (int i=0; i < 3; i++) {
-    push_btn(mb, FWD_REV);
-    push_btn(mb, STOP);
-    sleep(1);
-    push_btn(mb, RUN);
-    sleep(1);
+    for (int b = 0; b < 3; b++) {
+      struct timespec t0;
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      if (push_btn(mb, sequence[b]) == -1) {
+        fprintf(stderr, "Button %d failed: %s\n", sequence[b], modbus_strerror(errno));
+        continue;
+      }
+      double ms = elapsed_ms(&t0);
+      total_ms += ms;
+      if (ms > max_ms) max_ms = ms;
+      presses++;
+      if (sequence[b] != FWD_REV) sleep(1);
+    }
   }
-
-  for (int i = 0; i < 6001; i = i + 50) {
-    modbus_write_register(mb, 0, i);
+  if (presses > 0) {
+    printf("Button latency (%s): avg %.2f ms, max %.2f ms over %d presses\n",
+           pulse_name(pulse_mode),
+           total_ms / presses, max_ms, presses);
   }
+
+  run_ramp(mb, &profile, period_ms);
   
   // Print PLC server
   read_server(mb);
@@ -62,7 +113,41 @@ void read_server(modbus_t *mb){
   }
 }
 
-void push_btn(modbus_t *mb, uint8_t reg){
-  modbus_write_register(mb, reg, 1);
-  modbus_write_register(mb, reg, 0);
+/* Play a frequency profile on FREQ_REG, one write per period on an absolute
+   schedule, and report how far the writes were from that schedule. */
+void run_ramp(modbus_t *mb, const ramp_profile_t *profile, int period_ms){
+  ramp_t ramp;
+  char report[256];
+  double hz;
+  int64_t issued;
+  int rc;
+
+  ramp_start(&ramp, profile, period_ms, ramp_now_ns());
+  while ((rc = ramp_next(&ramp, ramp_now_ns(), &hz, NULL)) != -1) {
+    if (rc == 0) {
+      ramp_sleep_until(ramp_due_ns(&ramp));
+      continue;
+    }
+    issued = ramp_now_ns();
+    rc = modbus_write_register(mb, FREQ_REG, (uint16_t)lround(hz * 100));
+    if (rc == -1) fprintf(stderr, "Ramp write failed: %s\n", modbus_strerror(errno));
+    ramp_done(&ramp, rc != -1, issued, ramp_now_ns());
+  }
+  ramp_format(&ramp, report, sizeof(report));
+  printf("Ramp: %s\n", report);
+}
+
+/* Press a button in one transaction when the PLC resets it by itself,
+   otherwise (or if the PLC rejects the coil) write 1 then 0. */
+int push_btn(modbus_t *mb, uint8_t reg){
+  pulse_mode_t mode = pulse_mode;
+  int rc = pulse_press(mb, reg, &pulse_mode);
+  if (pulse_mode != mode) fprintf(stderr, "Coil %d rejected, falling back to two writes\n", reg);
+  return rc;
+}
+
+double elapsed_ms(const struct timespec *t0){
+  struct timespec t1;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
 }
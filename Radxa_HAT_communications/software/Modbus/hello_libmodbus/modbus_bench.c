@@ -0,0 +1,466 @@
+/**
+ * @file modbus_bench.c
+ * @brief Modbus client benchmark: FC03/FC06/FC16 throughput and latency.
+ *
+ * Opens a number of connections, one thread each, and sends requests back
+ * to back for a fixed time. Each request picks an operation at random from
+ * a weighted mix of register reads of several sizes and single or block
+ * writes, so the load resembles a polling plan. Latencies are recorded per
+ * request and reported as operations/s, bytes/s on the wire and percentiles
+ * per operation.
+ *
+ * Targets are Modbus TCP servers (host[:port]) or serial ports (any path
+ * starting with '/', e.g. a virtual-bus PTY). A serial bus has one master,
+ * so each serial target gets at most one connection; give several targets
+ * to load several buses (connections are spread over the targets).
+ *
+ * Writes never change the target: every connection first reads the
+ * registers it will write and writes those same values back.
+ *
+ * Usage:
+ *   $ ./modbus_bench [-c connections] [-d seconds] [-m mix] [-a read_addr]
+ *                    [-w write_addr] [-u unit] [-b baud] [-T timeout_ms] target...
+ *   Defaults: one connection per target, 10 s,
+ *             mix fc03x10:70,fc03x125:10,fc06:10,fc16x8:10, registers 0,
+ *             unit 255 (TCP) or 2 (RTU, as the drives on our buses), 38400 baud
+ *             8N1, 1000 ms timeout.
+ *
+ * Mix entries are OP[xCOUNT]:WEIGHT with OP fc03 (read COUNT registers,
+ * 1-125), fc06 (write one register) or fc16 (write COUNT registers, 1-123).
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "modbus.h"
+
+#define MAX_CONNECTIONS 256
+#define MAX_TARGETS 16
+#define MAX_OPS 16
+#define DEFAULT_MIX "fc03x10:70,fc03x125:10,fc06:10,fc16x8:10"
+
+typedef struct {
+  char name[16];
+  int fc;                   /* 3, 6 or 16 */
+  int count;                /* Registers read or written */
+  int weight;
+} op_t;
+
+typedef struct {
+  uint32_t *lat_us;         /* Latency of every successful request */
+  size_t n;
+  size_t cap;
+  unsigned long errors;
+  int last_error;
+} samples_t;
+
+typedef struct {
+  char spec[128];
+  bool rtu;
+  char host[96];            /* TCP host or serial device */
+  int port;
+  int conns;                /* Connections opened on it */
+} target_t;
+
+typedef struct {
+  pthread_t thread;
+  const target_t *target;
+  unsigned int seed;
+  bool ready;               /* Connected and holding the write-back values */
+  unsigned long reconnects;
+  samples_t samples[MAX_OPS];
+} worker_t;
+
+typedef struct {
+  unsigned long ops;
+  double ops_s;
+  double bytes_s;
+  uint32_t p50, p90, p99, p999, max;
+  unsigned long errors;
+} summary_t;
+
+static op_t ops[MAX_OPS];
+static int n_ops;
+static int total_weight;
+static int read_addr = 0;
+static int write_addr = 0;
+static int unit_id = -1;
+static int baud = 38400;
+static int timeout_ms = 1000;
+static pthread_barrier_t start_barrier;
+static uint64_t deadline_us;
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/* Bytes of an ADU: RTU adds the slave id and the CRC, TCP the 7-byte MBAP header */
+static int adu_bytes(bool rtu, int pdu) {
+  return rtu ? pdu + 3 : pdu + 7;
+}
+
+/* Request plus response size of an operation, both PDUs included */
+static int op_bytes(const op_t *op, bool rtu) {
+  switch (op->fc) {
+    case 3:  return adu_bytes(rtu, 5) + adu_bytes(rtu, 2 + 2 * op->count);
+    case 6:  return adu_bytes(rtu, 5) + adu_bytes(rtu, 5);
+    default: return adu_bytes(rtu, 6 + 2 * op->count) + adu_bytes(rtu, 5);
+  }
+}
+
+/* Parses a mix such as "fc03x10:70,fc06:20" into the ops table */
+static int parse_mix(const char *mix) {
+  char buf[256];
+  char *save = NULL;
+
+  snprintf(buf, sizeof(buf), "%s", mix);
+  n_ops = 0;
+  total_weight = 0;
+
+  for (char *tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+    char *colon = strchr(tok, ':');
+    op_t op = { .count = 1, .weight = 1 };
+    char *end;
+
+    if (colon != NULL) {
+      *colon = '\0';
+      op.weight = (int)strtol(colon + 1, &end, 10);
+      if (end == colon + 1 || *end != '\0' || op.weight < 0) op.weight = -1;
+    }
+    char *x = strchr(tok, 'x');
+    if (x != NULL) {
+      op.count = (int)strtol(x + 1, &end, 10);
+      if (end == x + 1 || *end != '\0') op.count = 0;
+      *x = '\0';
+    }
+    if (strcmp(tok, "fc03") == 0) op.fc = 3;
+    else if (strcmp(tok, "fc06") == 0 && x == NULL) op.fc = 6;
+    else if (strcmp(tok, "fc16") == 0) op.fc = 16;
+
+    int max = op.fc == 3 ? MODBUS_MAX_READ_REGISTERS : op.fc == 16 ? MODBUS_MAX_WRITE_REGISTERS : 1;
+    if (op.fc == 0 || op.weight < 0 || op.count < 1 || op.count > max || n_ops == MAX_OPS) {
+      fprintf(stderr, "Invalid mix entry: '%s'\n", tok);
+      return -1;
+    }
+    if (op.fc == 6) snprintf(op.name, sizeof(op.name), "fc06");
+    else snprintf(op.name, sizeof(op.name), "fc%02dx%d", op.fc, op.count);
+    ops[n_ops++] = op;
+    total_weight += op.weight;
+  }
+  return total_weight > 0 ? 0 : -1;
+}
+
+static int pick_op(unsigned int *seed) {
+  int r = rand_r(seed) % total_weight;
+  int i;
+
+  for (i = 0; i < n_ops - 1; i++) {
+    if (r < ops[i].weight) break;
+    r -= ops[i].weight;
+  }
+  return i;
+}
+
+/* Parses "host[:port]" or a serial device path */
+static int parse_target(target_t *t, const char *spec) {
+  memset(t, 0, sizeof(*t));
+  snprintf(t->spec, sizeof(t->spec), "%s", spec);
+
+  if (spec[0] == '/') {
+    t->rtu = true;
+    snprintf(t->host, sizeof(t->host), "%s", spec);
+    return 0;
+  }
+  snprintf(t->host, sizeof(t->host), "%s", spec);
+  t->port = MODBUS_TCP_DEFAULT_PORT;
+  char *colon = strrchr(t->host, ':');
+  if (colon != NULL) {
+    char *end;
+    *colon = '\0';
+    t->port = (int)strtol(colon + 1, &end, 10);
+    if (end == colon + 1 || *end != '\0' || t->port < 1 || t->port > 65535) return -1;
+  }
+  return t->host[0] != '\0' ? 0 : -1;
+}
+
+static modbus_t *open_target(const target_t *t) {
+  modbus_t *mb = t->rtu ? modbus_new_rtu(t->host, baud, 'N', 8, 1)
+                        : modbus_new_tcp(t->host, t->port);
+  if (mb == NULL) return NULL;
+
+  modbus_set_slave(mb, unit_id != -1 ? unit_id : t->rtu ? 2 : MODBUS_TCP_SLAVE);
+  modbus_set_response_timeout(mb, timeout_ms / 1000, (timeout_ms % 1000) * 1000);
+  if (modbus_connect(mb) == -1) {
+    modbus_free(mb);
+    return NULL;
+  }
+  return mb;
+}
+
+static bool is_link_error(int err) {
+  return err == EBADF || err == ECONNRESET || err == EPIPE || err == ENOTCONN || err == ECONNREFUSED;
+}
+
+static void record(samples_t *s, uint32_t lat_us) {
+  if (s->n == s->cap) {
+    size_t cap = s->cap ? s->cap * 2 : 4096;
+    uint32_t *p = realloc(s->lat_us, cap * sizeof(*p));
+    if (p == NULL) return;
+    s->lat_us = p;
+    s->cap = cap;
+  }
+  s->lat_us[s->n++] = lat_us;
+}
+
+static void *worker_main(void *arg) {
+  worker_t *w = (worker_t *)arg;
+  uint16_t regs[MODBUS_MAX_READ_REGISTERS];
+  uint16_t saved[MODBUS_MAX_WRITE_REGISTERS];
+  int n_saved = 0;
+
+  for (int i = 0; i < n_ops; i++) {
+    if (ops[i].fc != 3 && ops[i].count > n_saved) n_saved = ops[i].count;
+  }
+
+  /* Connect and read the values the writes will put back */
+  modbus_t *mb = open_target(w->target);
+  if (mb == NULL) {
+    fprintf(stderr, "%s: connection failed: %s\n", w->target->spec, modbus_strerror(errno));
+  } else if (n_saved > 0 && modbus_read_registers(mb, write_addr, n_saved, saved) == -1) {
+    fprintf(stderr, "%s: cannot read the registers to write back (%d at %d): %s\n",
+            w->target->spec, n_saved, write_addr, modbus_strerror(errno));
+  } else {
+    w->ready = true;
+  }
+  pthread_barrier_wait(&start_barrier);   /* Every connection is up */
+  pthread_barrier_wait(&start_barrier);   /* The deadline is set */
+  if (!w->ready) goto out;
+
+  while (now_us() < deadline_us) {
+    if (mb == NULL) {
+      if ((mb = open_target(w->target)) == NULL) {
+        usleep(10000);
+        continue;
+      }
+      w->reconnects++;
+    }
+
+    int k = pick_op(&w->seed);
+    const op_t *op = &ops[k];
+    uint64_t t0 = now_us();
+    int rc;
+
+    switch (op->fc) {
+      case 3:  rc = modbus_read_registers(mb, read_addr, op->count, regs); break;
+      case 6:  rc = modbus_write_register(mb, write_addr, saved[0]); break;
+      default: rc = modbus_write_registers(mb, write_addr, op->count, saved); break;
+    }
+    uint64_t t1 = now_us();
+
+    if (rc == -1) {
+      w->samples[k].errors++;
+      w->samples[k].last_error = errno;
+      if (!w->target->rtu && is_link_error(errno)) {
+        modbus_close(mb);
+        modbus_free(mb);
+        mb = NULL;
+      }
+      continue;
+    }
+    record(&w->samples[k], (uint32_t)(t1 - t0));
+  }
+
+out:
+  if (mb != NULL) {
+    modbus_close(mb);
+    modbus_free(mb);
+  }
+  return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double q) {
+  return n == 0 ? 0 : sorted[(size_t)(q * (double)(n - 1))];
+}
+
+/* Merges and sorts the samples of one operation (or all if k < 0) */
+static summary_t summarize(const worker_t *workers, int nworkers, int k, double seconds) {
+  summary_t sum = { 0 };
+  size_t n = 0;
+  double bytes = 0;
+
+  for (int w = 0; w < nworkers; w++) {
+    for (int i = 0; i < n_ops; i++) {
+      if (k >= 0 && k != i) continue;
+      n += workers[w].samples[i].n;
+      sum.errors += workers[w].samples[i].errors;
+      bytes += (double)workers[w].samples[i].n * op_bytes(&ops[i], workers[w].target->rtu);
+    }
+  }
+  uint32_t *all = malloc((n ? n : 1) * sizeof(*all));
+  if (all == NULL) return sum;
+
+  size_t m = 0;
+  for (int w = 0; w < nworkers; w++) {
+    for (int i = 0; i < n_ops; i++) {
+      if (k >= 0 && k != i) continue;
+      memcpy(all + m, workers[w].samples[i].lat_us, workers[w].samples[i].n * sizeof(*all));
+      m += workers[w].samples[i].n;
+    }
+  }
+  qsort(all, n, sizeof(*all), cmp_u32);
+
+  sum.ops = n;
+  sum.ops_s = (double)n / seconds;
+  sum.bytes_s = bytes / seconds;
+  sum.p50 = percentile(all, n, 0.50);
+  sum.p90 = percentile(all, n, 0.90);
+  sum.p99 = percentile(all, n, 0.99);
+  sum.p999 = percentile(all, n, 0.999);
+  sum.max = n ? all[n - 1] : 0;
+  free(all);
+  return sum;
+}
+
+static void print_row(const char *name, const summary_t *s) {
+  printf("%-10s %9lu %9.1f %9.1f %8u %8u %8u %8u %8u %7lu\n",
+         name, s->ops, s->ops_s, s->bytes_s / 1000.0, s->p50, s->p90, s->p99, s->p999, s->max, s->errors);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-c connections] [-d seconds] [-m mix] [-a read_addr] [-w write_addr]\n"
+                  "       [-u unit] [-b baud] [-T timeout_ms] target...\n"
+                  "  target: host[:port] (Modbus TCP) or a serial device path (RTU)\n"
+                  "  mix:    fc03xCOUNT:WEIGHT,fc06:WEIGHT,fc16xCOUNT:WEIGHT (default %s)\n",
+          prog, DEFAULT_MIX);
+}
+
+int main(int argc, char *argv[]) {
+  target_t targets[MAX_TARGETS];
+  int n_targets = 0, nconns = 0, seconds = 10;
+  const char *mix = DEFAULT_MIX;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:d:m:a:w:u:b:T:")) != -1) {
+    switch (opt) {
+      case 'c': nconns = atoi(optarg); break;
+      case 'd': seconds = atoi(optarg); break;
+      case 'm': mix = optarg; break;
+      case 'a': read_addr = (int)strtol(optarg, NULL, 0); break;
+      case 'w': write_addr = (int)strtol(optarg, NULL, 0); break;
+      case 'u': unit_id = atoi(optarg); break;
+      case 'b': baud = atoi(optarg); break;
+      case 'T': timeout_ms = atoi(optarg); break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    if (n_targets == MAX_TARGETS || parse_target(&targets[n_targets], argv[i]) == -1) {
+      fprintf(stderr, "Invalid or too many targets: '%s'\n", argv[i]);
+      return 1;
+    }
+    n_targets++;
+  }
+  if (n_targets == 0 || parse_mix(mix) == -1) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (nconns == 0) nconns = n_targets;
+  if (nconns < 1 || nconns > MAX_CONNECTIONS || seconds < 1 || timeout_ms < 1 ||
+      read_addr < 0 || read_addr > 65535 || write_addr < 0 || write_addr > 65535 ||
+      unit_id < -1 || unit_id > 255) {
+    fprintf(stderr, "Invalid arguments (connections 1-%d, seconds >= 1, addresses 0-65535, unit 0-255)\n",
+            MAX_CONNECTIONS);
+    return 1;
+  }
+
+  worker_t *workers = calloc((size_t)nconns, sizeof(*workers));
+  if (workers == NULL) return 1;
+
+  /* Spread the connections over the targets, at most one per serial port */
+  for (int i = 0; i < nconns; i++) {
+    target_t *t = &targets[i % n_targets];
+    if (t->rtu && t->conns == 1) {
+      fprintf(stderr, "%s: a serial bus has one master, use one connection per serial target\n", t->spec);
+      free(workers);
+      return 1;
+    }
+    t->conns++;
+    workers[i].target = t;
+    workers[i].seed = (unsigned int)(i * 7919) ^ (unsigned int)time(NULL);
+  }
+
+  printf("Benchmarking %d connection(s) for %d s\n", nconns, seconds);
+  for (int i = 0; i < n_targets; i++) {
+    printf("  %s %s: %d connection(s)\n", targets[i].rtu ? "RTU" : "TCP", targets[i].spec, targets[i].conns);
+  }
+  printf("Mix: %s (reads at 0x%04X, writes at 0x%04X)\n\n", mix, read_addr, write_addr);
+
+  /* The clock starts once every connection is up */
+  pthread_barrier_init(&start_barrier, NULL, (unsigned int)nconns + 1);
+  for (int i = 0; i < nconns; i++) {
+    if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+      fprintf(stderr, "Cannot start thread %d\n", i);
+      return 1;
+    }
+  }
+  pthread_barrier_wait(&start_barrier);
+  uint64_t start_us = now_us();
+  deadline_us = start_us + (uint64_t)seconds * 1000000ULL;
+  pthread_barrier_wait(&start_barrier);
+
+  int ready = 0;
+  unsigned long reconnects = 0;
+  for (int i = 0; i < nconns; i++) {
+    pthread_join(workers[i].thread, NULL);
+    ready += workers[i].ready;
+    reconnects += workers[i].reconnects;
+  }
+  double elapsed = (now_us() - start_us) / 1e6;
+  pthread_barrier_destroy(&start_barrier);
+
+  printf("%-10s %9s %9s %9s %8s %8s %8s %8s %8s %7s\n",
+         "op", "ops", "ops/s", "kB/s", "p50_us", "p90_us", "p99_us", "p999_us", "max_us", "errors");
+  for (int k = 0; k < n_ops; k++) {
+    if (ops[k].weight == 0) continue;
+    summary_t s = summarize(workers, nconns, k, elapsed);
+    print_row(ops[k].name, &s);
+  }
+  summary_t total = summarize(workers, nconns, -1, elapsed);
+  print_row("total", &total);
+
+  for (int k = 0; k < n_ops; k++) {
+    for (int i = 0; i < nconns; i++) {
+      if (workers[i].samples[k].errors > 0) {
+        printf("\n%s: last error %s", ops[k].name, modbus_strerror(workers[i].samples[k].last_error));
+        break;
+      }
+    }
+  }
+  if (ready < nconns) printf("\n%d of %d connection(s) never started", nconns - ready, nconns);
+  if (reconnects > 0) printf("\nReconnections: %lu", reconnects);
+  printf("\n");
+
+  for (int i = 0; i < nconns; i++) {
+    for (int k = 0; k < n_ops; k++) free(workers[i].samples[k].lat_us);
+  }
+  free(workers);
+  return ready == nconns ? 0 : 1;
+}
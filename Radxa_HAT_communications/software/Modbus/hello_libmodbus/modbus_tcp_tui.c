@@ -12,8 +12,10 @@
 #include <stdint.h>
 #include <ncurses.h>
 #include <errno.h>
+#include <time.h>
 #include <modbus.h>
 #include <sys/param.h>
+#include "pulse.h"
 
 // Uncomment to disable real Modbus communication for debugging UI only
 // #define DEBUG_TUI
@@ -21,48 +23,74 @@
 // PLC server parameters
 #define SERVER_IP "192.168.0.52"
 
+// How a button press is sent, see pulse.h (override with -DPULSE_MODE=PULSE_AUTO_RESET)
+#ifndef PULSE_MODE
+#define PULSE_MODE PULSE_TWICE
+#endif
+
 // ==== Global State Variables ====
 // These represent the current state of the PLC as seen by the UI.
 static bool run = false;          // false = STOP, true = RUN
 static bool direction = false;    // false = FWD, true = REV
 static int frequency = 0;         // Frequency in Hz * 100 (for Modbus scaling)
+static pulse_mode_t pulse_mode = PULSE_MODE;
+static double last_cmd_ms = 0;    // Duration of the last Modbus command
+static char last_error[64] = "";  // Error of the last Modbus command, empty if it succeeded
 
 // ==== Function Prototypes ====
-void push_button(modbus_t *mb, uint8_t reg);
+int push_button(modbus_t *mb, uint8_t reg);
 void toggle_run_stop(modbus_t *mb);
 void toggle_direction(modbus_t *mb);
 void change_frequency(modbus_t *mb);
 void draw_ui(void);
 
+#ifndef DEBUG_TUI
+// ==== Error Reporting ====
+// Records the outcome of a Modbus command for draw_ui().
+static int command_result(int rc) {
+  if (rc == -1) {
+    snprintf(last_error, sizeof(last_error), "%s", modbus_strerror(errno));
+  } else {
+    last_error[0] = '\0';
+  }
+  return rc;
+}
+#endif
+
 // ==== Modbus Button Simulation ====
-// Simulates pressing a button by writing 1 then 0 to a Modbus register.
-void push_button(modbus_t *mb, uint8_t reg) {
+// Simulates pressing a button: one transaction when the PLC resets the
+// button itself, otherwise (or if the PLC rejects the coil) write 1 then 0.
+// Returns -1 with errno set if the PLC did not take the press.
+int push_button(modbus_t *mb, uint8_t reg) {
 #ifndef DEBUG_TUI
-  modbus_write_register(mb, reg, 1);
-  modbus_write_register(mb, reg, 0);
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int rc = pulse_press(mb, reg, &pulse_mode);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  last_cmd_ms = (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+  return command_result(rc);
+#else
+  (void)mb;
+  (void)reg;
+  return 0;
 #endif
 }
 
 // ==== Toggle RUN/STOP ====
-// Switches between RUN and STOP states.
+// Switches between RUN and STOP states; the state only changes if the
+// PLC took the press.
 void toggle_run_stop(modbus_t *mb) {
-  run = !run;
-#ifndef DEBUG_TUI
-  if (run) {
-    push_button(mb, 2); // RUN button
-  } else {
-    push_button(mb, 3); // STOP button
+  if (push_button(mb, run ? 3 : 2) == 0) { // STOP button : RUN button
+    run = !run;
   }
-#endif
 }
 
 // ==== Toggle FWD/REV ====
 // Switches between Forward and Reverse directions.
 void toggle_direction(modbus_t *mb) {
-  direction = !direction;
-#ifndef DEBUG_TUI
-  push_button(mb, 1); // FWD/REV button
-#endif
+  if (push_button(mb, 1) == 0) { // FWD/REV button
+    direction = !direction;
+  }
 }
 
 // ==== Change Frequency ====
@@ -81,10 +109,13 @@ void change_frequency(modbus_t *mb) {
   curs_set(0);
 
   if (sscanf(str_freq, "%d", &new_freq) == 1 && new_freq >= 0 && new_freq <= 60) {
-    frequency = new_freq * 100; // Modbus expects frequency * 100
 #ifndef DEBUG_TUI
-    modbus_write_register(mb, 0, frequency);
+    // Modbus expects frequency * 100
+    if (command_result(modbus_write_register(mb, 0, new_freq * 100)) == -1) return;
+#else
+    (void)mb;
 #endif
+    frequency = new_freq * 100;
   }
 }
 
@@ -103,6 +134,11 @@ void draw_ui(void) {
   mvprintw(3, 2, "State     : %s", run ? "RUN" : "STOP");
   mvprintw(4, 2, "Direction : %s", direction ? "REV" : "FWD");
   mvprintw(5, 2, "Frequency : %d Hz", frequency / 100);
+  mvprintw(6, 2, "Last cmd  : %.2f ms (%s)", last_cmd_ms,
+           pulse_mode == PULSE_TWICE ? "2 writes" : "1 write");
+  if (last_error[0] != '\0') {
+    mvprintw(12, 2, "Error     : %s", last_error);
+  }
 
   // Menu options
   attron(A_BOLD);
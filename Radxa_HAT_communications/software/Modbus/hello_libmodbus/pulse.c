@@ -0,0 +1,41 @@
+/**
+ * @file pulse.c
+ * @brief Button presses on a PLC over Modbus (see pulse.h).
+ */
+
+#include <string.h>
+#include <errno.h>
+#include "pulse.h"
+
+static const char *const names[] = { "twice", "auto", "coil" };
+
+int pulse_parse(const char *name, pulse_mode_t *mode) {
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *mode = (pulse_mode_t)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+const char *pulse_name(pulse_mode_t mode) {
+  return names[mode];
+}
+
+int pulse_press(modbus_t *mb, int reg, pulse_mode_t *mode) {
+  switch (*mode) {
+    case PULSE_AUTO_RESET:
+      return modbus_write_register(mb, reg, 1) == -1 ? -1 : 0;
+    case PULSE_COIL:
+      if (modbus_write_bit(mb, reg, TRUE) != -1) return 0;
+      if (errno != EMBXILFUN && errno != EMBXILADD) return -1;
+      *mode = PULSE_TWICE;
+      break;
+    case PULSE_TWICE:
+      break;
+  }
+  if (modbus_write_register(mb, reg, 1) == -1) return -1;
+  if (modbus_write_register(mb, reg, 0) == -1) return -1;
+  return 0;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file pulse.h
+ * @brief Button presses on a PLC over Modbus, in one transaction where the
+ *        PLC allows it.
+ *
+ * The PLC programs in this repository expose their buttons (FWD/REV = 1,
+ * RUN = 2, STOP = 3) as holding registers, and a press can be sent three ways:
+ *
+ *   twice   FC06 write 1, then FC06 write 0 (any PLC)
+ *   auto    one FC06 write 1, the PLC program resets the register
+ *   coil    one FC05 coil ON at the same address, the PLC program resets it
+ *
+ * A PLC that rejects the coil (illegal function or address) gets the press
+ * as two writes instead, and the caller's mode is switched to twice for good.
+ *
+ * Shared by hello_modbus, app_tui and the web server.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef PULSE_H
+#define PULSE_H
+
+#include <modbus.h>
+
+typedef enum {
+  PULSE_TWICE,        // Two FC06 transactions: press (1) and release (0)
+  PULSE_AUTO_RESET,   // One FC06 transaction, released by the PLC program
+  PULSE_COIL          // One FC05 transaction, released by the PLC program
+} pulse_mode_t;
+
+/**
+ * @brief Mode from its name ("twice", "auto" or "coil").
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int pulse_parse(const char *name, pulse_mode_t *mode);
+
+/** @brief Name of a mode, as accepted by pulse_parse(). */
+const char *pulse_name(pulse_mode_t mode);
+
+/**
+ * @brief Presses the button at a register.
+ * @param mode Mode to use; set to PULSE_TWICE if the PLC rejects the coil.
+ * @return 0 on success, -1 with errno set if a transaction fails.
+ */
+int pulse_press(modbus_t *mb, int reg, pulse_mode_t *mode);
+
+#endif // PULSE_H
@@ -0,0 +1,182 @@
+/**
+ * @file ramp.c
+ * @brief Parsing, evaluation and paced playback of setpoint ramps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "ramp.h"
+
+/* Parses "FROM:TO:SECONDS" into two waypoints */
+static int parse_endpoints(ramp_profile_t *p, char *s) {
+  char *end;
+  double v[3];
+
+  for (int i = 0; i < 3; i++) {
+    v[i] = strtod(s, &end);
+    if (end == s || *end != (i < 2 ? ':' : '\0')) return -1;
+    s = end + 1;
+  }
+  if (v[2] < 0) return -1;
+  p->n_points = 2;
+  p->t[0] = 0;    p->v[0] = v[0];
+  p->t[1] = v[2]; p->v[1] = v[1];
+  return 0;
+}
+
+/* Parses "T=V,T=V,..." */
+static int parse_points(ramp_profile_t *p, char *s) {
+  char *end;
+
+  p->n_points = 0;
+  for (char *tok = strtok(s, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    if (p->n_points == RAMP_MAX_POINTS) return -1;
+    double t = strtod(tok, &end);
+    if (end == tok || *end != '=') return -1;
+    char *val = end + 1;
+    double v = strtod(val, &end);
+    if (end == val || *end != '\0') return -1;
+    if (p->n_points == 0 ? t != 0 : t < p->t[p->n_points - 1]) return -1;
+    p->t[p->n_points] = t;
+    p->v[p->n_points] = v;
+    p->n_points++;
+  }
+  return p->n_points > 0 ? 0 : -1;
+}
+
+int ramp_parse(ramp_profile_t *p, const char *spec) {
+  char buf[512];
+
+  if (strlen(spec) >= sizeof(buf)) return -1;
+  strcpy(buf, spec);
+
+  char *rest = strchr(buf, ':');
+  if (rest == NULL) return -1;
+  *rest++ = '\0';
+
+  if (strcmp(buf, "linear") == 0) p->shape = RAMP_LINEAR;
+  else if (strcmp(buf, "scurve") == 0) p->shape = RAMP_SCURVE;
+  else return -1;
+
+  int rc = strchr(rest, '=') != NULL ? parse_points(p, rest) : parse_endpoints(p, rest);
+  return (rc == 0 && ramp_duration(p) <= RAMP_MAX_S) ? 0 : -1;
+}
+
+double ramp_duration(const ramp_profile_t *p) {
+  return p->t[p->n_points - 1];
+}
+
+void ramp_bounds(const ramp_profile_t *p, double *min, double *max) {
+  *min = *max = p->v[0];
+  for (int i = 1; i < p->n_points; i++) {
+    if (p->v[i] < *min) *min = p->v[i];
+    if (p->v[i] > *max) *max = p->v[i];
+  }
+}
+
+double ramp_value(const ramp_profile_t *p, double t) {
+  int last = p->n_points - 1;
+
+  /* Of waypoints sharing a time, the last one holds from that time on:
+     "linear:0:60:0" is one write of 60, not of 0 */
+  if (t >= p->t[last]) return p->v[last];
+  if (t < p->t[0]) return p->v[0];
+
+  int i = 0;
+  while (t >= p->t[i + 1]) i++;
+
+  double x = (t - p->t[i]) / (p->t[i + 1] - p->t[i]);
+  if (p->shape == RAMP_SCURVE) {
+    /* Smootherstep: rate and acceleration are both zero at the waypoints */
+    x = x * x * x * (x * (6 * x - 15) + 10);
+  }
+  return p->v[i] + (p->v[i + 1] - p->v[i]) * x;
+}
+
+int64_t ramp_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void ramp_sleep_until(int64_t ns) {
+  struct timespec ts = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) continue;
+}
+
+/* Offset of step k from the start; the last step lands on the end of the profile */
+static int64_t step_offset_ns(const ramp_t *r, long k) {
+  int64_t t = k * r->period_ns;
+  int64_t end = (int64_t)(ramp_duration(&r->profile) * 1e9);
+  return t < end ? t : end;
+}
+
+void ramp_start(ramp_t *r, const ramp_profile_t *p, int period_ms, int64_t now_ns) {
+  memset(r, 0, sizeof(*r));
+  r->profile = *p;
+  r->start_ns = now_ns;
+  r->end_ns = now_ns;
+  r->period_ns = (int64_t)period_ms * 1000000;
+
+  int64_t end = (int64_t)(ramp_duration(p) * 1e9);
+  r->n_steps = 1 + (end + r->period_ns - 1) / r->period_ns;
+}
+
+int64_t ramp_due_ns(const ramp_t *r) {
+  return r->step < r->n_steps ? r->start_ns + step_offset_ns(r, r->step) : -1;
+}
+
+int ramp_next(ramp_t *r, int64_t now_ns, double *value, int64_t *sched_ns) {
+  if (r->step >= r->n_steps) return -1;
+  if (now_ns < ramp_due_ns(r)) return 0;
+
+  /* Skip to the latest step already due: writing stale values only delays the ramp */
+  long k = r->step;
+  while (k + 1 < r->n_steps && r->start_ns + step_offset_ns(r, k + 1) <= now_ns) k++;
+  r->stats.missed += k - r->step;
+
+  int64_t offset = step_offset_ns(r, k);
+  double late_ms = (now_ns - r->start_ns - offset) / 1e6;
+  r->stats.late_sum_ms += late_ms;
+  if (late_ms > r->stats.late_max_ms) r->stats.late_max_ms = late_ms;
+  r->stats.steps++;
+  r->step = k + 1;
+
+  *value = ramp_value(&r->profile, offset / 1e9);
+  if (sched_ns != NULL) *sched_ns = r->start_ns + offset;
+  return 1;
+}
+
+void ramp_done(ramp_t *r, bool ok, int64_t issued_ns, int64_t now_ns) {
+  double ms = (now_ns - issued_ns) / 1e6;
+
+  r->stats.completed++;
+  if (!ok) r->stats.errors++;
+  r->stats.write_sum_ms += ms;
+  if (ms > r->stats.write_max_ms) r->stats.write_max_ms = ms;
+  if (now_ns > r->end_ns) r->end_ns = now_ns;
+}
+
+void ramp_stop(ramp_t *r) {
+  r->n_steps = r->step;
+}
+
+bool ramp_finished(const ramp_t *r) {
+  return r->step >= r->n_steps && r->stats.completed >= r->stats.steps;
+}
+
+int ramp_format(const ramp_t *r, char *buf, size_t len) {
+  const ramp_stats_t *s = &r->stats;
+  unsigned long steps = s->steps ? s->steps : 1;
+  unsigned long completed = s->completed ? s->completed : 1;
+
+  return snprintf(buf, len,
+                  "%lu writes in %.3f s (profile %.3f s), late avg %.2f ms max %.2f ms, "
+                  "%lu missed, %lu errors, write avg %.2f ms max %.2f ms",
+                  s->steps, (r->end_ns - r->start_ns) / 1e9, ramp_duration(&r->profile),
+                  s->late_sum_ms / steps, s->late_max_ms, s->missed, s->errors,
+                  s->write_sum_ms / completed, s->write_max_ms);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file ramp.h
+ * @brief Setpoint ramp profiles and a paced write schedule.
+ *
+ * A profile is a list of waypoints (time, value) and the shape of the
+ * segments between them, given as text:
+ *
+ *   SHAPE:FROM:TO:SECONDS     from FROM to TO in SECONDS
+ *   SHAPE:T=V,T=V,...         waypoints, times in seconds from 0, ascending
+ *
+ *   linear   constant rate on every segment
+ *   scurve   every segment starts and ends at rest, with the acceleration
+ *            rising and falling smoothly (peak rate 1.875 times the
+ *            average, so the segment must allow for it)
+ *
+ * e.g. "scurve:0:60:10" or "linear:0=0,5=30,20=30,25=0". Values are in the
+ * caller's unit; the tools in this repository use Hz. Waypoints at the same
+ * time make a step, so "linear:0:60:0" is a single write of 60.
+ *
+ * A ramp_t plays a profile at a fixed cadence: step k is due at
+ * start + k * period and carries the profile value at that scheduled time,
+ * and the last step lands exactly on the end of the profile. The caller owns
+ * the loop (a blocking one, a TUI or an event loop): ramp_next() says when a
+ * step is due and ramp_done() records how its write went. A step issued more
+ * than one period late skips the steps it overran, so a slow link never
+ * stretches the ramp; the skipped steps are counted as missed. The lateness
+ * of every step is the commanded-versus-achieved timing error.
+ *
+ * @author Adrián Silva Palafox
+ * @date October 2026
+ */
+
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RAMP_MAX_POINTS   32
+#define RAMP_MAX_S        3600    // Longest profile accepted
+
+typedef enum {
+  RAMP_LINEAR,
+  RAMP_SCURVE
+} ramp_shape_t;
+
+typedef struct {
+  ramp_shape_t shape;
+  int n_points;
+  double t[RAMP_MAX_POINTS];      // Seconds, t[0] = 0
+  double v[RAMP_MAX_POINTS];
+} ramp_profile_t;
+
+typedef struct {
+  unsigned long steps;            // Steps issued
+  unsigned long missed;           // Steps skipped because the loop was late
+  unsigned long completed;        // Writes finished, failed ones included
+  unsigned long errors;           // Writes that failed
+  double late_sum_ms;             // Issue time minus scheduled time
+  double late_max_ms;
+  double write_sum_ms;            // Time from issue to completion
+  double write_max_ms;
+} ramp_stats_t;
+
+typedef struct {
+  ramp_profile_t profile;
+  int64_t start_ns;
+  int64_t period_ns;
+  long step;                      // Next step to issue
+  long n_steps;
+  int64_t end_ns;                 // Completion of the latest write
+  ramp_stats_t stats;
+} ramp_t;
+
+/**
+ * @brief Parses a profile (see the file comment).
+ * @return 0 on success, -1 if the text is malformed.
+ */
+int ramp_parse(ramp_profile_t *p, const char *spec);
+
+double ramp_duration(const ramp_profile_t *p);
+
+/** @brief Lowest and highest value the profile reaches (at its waypoints). */
+void ramp_bounds(const ramp_profile_t *p, double *min, double *max);
+
+/**
+ * @brief Profile value at t seconds; held at the ends outside [0, duration].
+ *        Where waypoints share a time, the last of them applies at that time.
+ */
+double ramp_value(const ramp_profile_t *p, double t);
+
+/** @brief CLOCK_MONOTONIC in nanoseconds, the clock of every ramp_t. */
+int64_t ramp_now_ns(void);
+
+/** @brief Sleeps until an absolute ramp_now_ns() time. */
+void ramp_sleep_until(int64_t ns);
+
+/**
+ * @brief Starts playing a profile now, one step every period_ms.
+ */
+void ramp_start(ramp_t *r, const ramp_profile_t *p, int period_ms, int64_t now_ns);
+
+/**
+ * @brief Takes the step due at now_ns, if any.
+ * @param value Receives the value to write.
+ * @param sched_ns Receives the time the step was due (may be NULL).
+ * @return 1 if a step is due, 0 if not yet (see ramp_due_ns()), -1 once
+ *         every step has been issued.
+ */
+int ramp_next(ramp_t *r, int64_t now_ns, double *value, int64_t *sched_ns);
+
+/** @brief Time the next step is due, or -1 once every step has been issued. */
+int64_t ramp_due_ns(const ramp_t *r);
+
+/**
+ * @brief Records the completion of a step's write.
+ * @param issued_ns Time the write was issued.
+ */
+void ramp_done(ramp_t *r, bool ok, int64_t issued_ns, int64_t now_ns);
+
+/** @brief Issues no more steps; the ramp finishes when pending writes complete. */
+void ramp_stop(ramp_t *r);
+
+/** @brief Every step has been issued and every write has completed. */
+bool ramp_finished(const ramp_t *r);
+
+/**
+ * @brief One-line timing report, e.g. "121 writes in 6.002 s (profile 6.000 s),
+ *        late avg 0.05 ms max 0.31 ms, 0 missed, 0 errors, write avg 1.10 ms max 2.95 ms".
+ */
+int ramp_format(const ramp_t *r, char *buf, size_t len);
+
+#endif // RAMP_H
@@ -18,11 +18,13 @@
  */
 // Standard libraries
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 // External libraries
 #include <modbus.h>
 
-/* Master's parameters */
+/* Master's parameters (the device can be given as the first argument,
+   the first register to read as the second one) */
 const char *device = "/dev/ttyS4";
 const int baud = 115200;
 const char parity = 'N';
@@ -33,7 +35,11 @@ const int stop_bit = 1;
 const int REMOTE_ID = 10;
 uint16_t tab_reg[32];
 
-int main(void) {
+int main(int argc, char *argv[]) {
+    int start = 0;
+    if (argc > 1) device = argv[1];
+    if (argc > 2) start = (int)strtol(argv[2], NULL, 0);
+
     // Create a new RTU context
     modbus_t *rtu_ctx;
     rtu_ctx = modbus_new_rtu(device, baud, parity, data_bit, stop_bit);
@@ -51,11 +57,17 @@ int main(void) {
     printf("Successfully connected to %s\n", device);
 
     modbus_set_slave(rtu_ctx, REMOTE_ID);
-    // Read 2 registers from address 0 of server ID 10.
-    modbus_read_registers(rtu_ctx, 0, 2, tab_reg);
+    // Read 2 registers from address start of server ID 10.
+    int rc = 0;
+    if (modbus_read_registers(rtu_ctx, start, 2, tab_reg) == -1) {
+        fprintf(stderr, "Read failed: %s\n", modbus_strerror(errno));
+        rc = -1;
+    } else {
+        printf("Registers 0x%04X-0x%04X: 0x%04X 0x%04X\n", start, start + 1, tab_reg[0], tab_reg[1]);
+    }
 
     // Clean up
     modbus_close(rtu_ctx);
     modbus_free(rtu_ctx);
-    return 0;
+    return rc;
 }
\ No newline at end of file
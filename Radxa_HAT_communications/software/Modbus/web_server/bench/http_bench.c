@@ -0,0 +1,469 @@
+/**
+ * @file http_bench.c
+ * @brief HTTP load generator for modbus_server.
+ *
+ * Opens a number of keep-alive connections, one thread each, and sends
+ * requests back to back for a fixed time. Each request picks an endpoint at
+ * random according to a weighted mix, so the load resembles several
+ * dashboards polling /api/status while operators send commands. Latencies
+ * are recorded per request and reported as throughput and percentiles per
+ * endpoint.
+ *
+ * Results can be saved to a file and compared against a previously saved
+ * baseline: the run fails (exit code 2) if the throughput of an endpoint
+ * drops, or its p99 latency grows, by more than the tolerance.
+ *
+ * Usage:
+ *   $ ./http_bench [-H host] [-p port] [-c connections] [-d seconds]
+ *                  [-m mix] [-o results] [-b baseline] [-t tolerance_pct]
+ *   Defaults: 127.0.0.1:8000, 16 connections, 10 s,
+ *             mix status:60,registers:20,freq:10,index:10, tolerance 10 %.
+ *
+ * Endpoints available in the mix:
+ *   status, registers (poller mirror), registers_plc (always reaches the
+ *   PLC), freq, dir, devices, index (static UI).
+ *
+ * @author Adrián Silva Palafox
+ * @date   October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MAX_CONNECTIONS     256
+#define RESPONSE_BUF_LEN    16384
+#define P99_NOISE_US        100     // p99 changes below this never count as a regression
+
+typedef struct {
+    const char *name;
+    const char *method;
+    const char *path;
+    bool has_body;          // POST with a form body
+} endpoint_t;
+
+static const endpoint_t endpoints[] = {
+    { "status",        "GET",  "/api/status",                       false },
+    { "registers",     "GET",  "/api/registers?start=0&count=8",    false },
+    { "registers_plc", "GET",  "/api/registers?start=200&count=8",  false },
+    { "freq",          "POST", "/api/freq",                         true  },
+    { "dir",           "POST", "/api/dir",                          true  },
+    { "devices",       "GET",  "/api/devices",                      false },
+    { "index",         "GET",  "/",                                 false },
+};
+
+#define NUM_ENDPOINTS (sizeof(endpoints) / sizeof(endpoints[0]))
+
+typedef struct {
+    uint32_t *lat_us;       // Latency of every completed request
+    size_t n;
+    size_t cap;
+    unsigned long errors;   // Responses with status >= 400
+} samples_t;
+
+typedef struct {
+    pthread_t thread;
+    unsigned int seed;
+    samples_t samples[NUM_ENDPOINTS];
+    unsigned long io_errors;  // Failed connects, resets and malformed replies
+} worker_t;
+
+typedef struct {
+    unsigned long reqs;
+    double rps;
+    uint32_t p50, p90, p99, p999, max;
+    unsigned long errors;
+} summary_t;
+
+static const char *host = "127.0.0.1";
+static const char *port = "8000";
+static int weights[NUM_ENDPOINTS];
+static int total_weight;
+static uint64_t deadline_us;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * @brief Parses a mix such as "status:60,freq:10" into the weights table.
+ * @return 0 on success, -1 on an unknown endpoint or bad weight.
+ */
+static int parse_mix(const char *mix) {
+    char buf[256];
+    char *save = NULL;
+
+    snprintf(buf, sizeof(buf), "%s", mix);
+    memset(weights, 0, sizeof(weights));
+    total_weight = 0;
+
+    for (char *tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        char *colon = strchr(tok, ':');
+        int weight = colon != NULL ? atoi(colon + 1) : 1;
+        size_t i;
+
+        if (colon != NULL) *colon = '\0';
+        for (i = 0; i < NUM_ENDPOINTS; i++) {
+            if (strcmp(endpoints[i].name, tok) == 0) break;
+        }
+        if (i == NUM_ENDPOINTS || weight < 0) {
+            fprintf(stderr, "Unknown endpoint or weight in mix: '%s'\n", tok);
+            return -1;
+        }
+        weights[i] = weight;
+        total_weight += weight;
+    }
+    return total_weight > 0 ? 0 : -1;
+}
+
+static size_t pick_endpoint(unsigned int *seed) {
+    int r = rand_r(seed) % total_weight;
+    size_t i;
+
+    for (i = 0; i < NUM_ENDPOINTS - 1; i++) {
+        if (r < weights[i]) break;
+        r -= weights[i];
+    }
+    return i;
+}
+
+static int open_connection(void) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    int fd = -1, one = 1;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == -1) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd != -1) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads one HTTP response (headers and Content-Length body).
+ * @return The HTTP status code, or -1 if the connection failed.
+ */
+static int read_response(int fd, char *buf, size_t size) {
+    size_t len = 0;
+    char *end = NULL;
+
+    while (end == NULL) {
+        if (len == size - 1) return -1;
+        ssize_t n = recv(fd, buf + len, size - 1 - len, 0);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return -1;
+        }
+        len += (size_t)n;
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+    }
+
+    int status = 0;
+    if (sscanf(buf, "HTTP/1.%*d %d", &status) != 1) return -1;
+
+    long body_len = 0;
+    for (char *line = strstr(buf, "\r\n"); line != NULL && line < end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            body_len = strtol(line + 17, NULL, 10);
+            break;
+        }
+    }
+
+    size_t have = len - (size_t)(end + 4 - buf);
+    while ((long)have < body_len) {
+        ssize_t n = recv(fd, buf, size - 1, 0);
+        if (n <= 0) {
+            if (n == -1 && errno == EINTR) continue;
+            return -1;
+        }
+        have += (size_t)n;
+    }
+    return status;
+}
+
+static void record(samples_t *s, uint32_t lat_us, int status) {
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        uint32_t *p = realloc(s->lat_us, cap * sizeof(*p));
+        if (p == NULL) return;
+        s->lat_us = p;
+        s->cap = cap;
+    }
+    s->lat_us[s->n++] = lat_us;
+    if (status >= 400) s->errors++;
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    char req[512], resp[RESPONSE_BUF_LEN];
+    int fd = -1;
+
+    while (now_us() < deadline_us) {
+        if (fd == -1 && (fd = open_connection()) == -1) {
+            w->io_errors++;
+            usleep(1000);
+            continue;
+        }
+
+        size_t e = pick_endpoint(&w->seed);
+        char body[32] = "";
+        if (strcmp(endpoints[e].name, "freq") == 0) {
+            snprintf(body, sizeof(body), "freq=%d", rand_r(&w->seed) % 61);
+        }
+        int len = snprintf(req, sizeof(req),
+                           "%s %s HTTP/1.1\r\n"
+                           "Host: %s\r\n"
+                           "Accept-Encoding: gzip\r\n"
+                           "%s"
+                           "Content-Length: %zu\r\n\r\n%s",
+                           endpoints[e].method, endpoints[e].path, host,
+                           endpoints[e].has_body ? "Content-Type: application/x-www-form-urlencoded\r\n" : "",
+                           strlen(body), body);
+
+        uint64_t t0 = now_us();
+        int status = -1;
+        if (send_all(fd, req, (size_t)len) == 0) status = read_response(fd, resp, sizeof(resp));
+        uint64_t t1 = now_us();
+
+        if (status == -1) {
+            w->io_errors++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        record(&w->samples[e], (uint32_t)(t1 - t0), status);
+    }
+
+    if (fd != -1) close(fd);
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double q) {
+    return n == 0 ? 0 : sorted[(size_t)(q * (double)(n - 1))];
+}
+
+/**
+ * @brief Merges and sorts the samples of one endpoint (or all if e < 0).
+ */
+static summary_t summarize(worker_t *workers, int nworkers, int e, double seconds) {
+    summary_t sum = { 0 };
+    size_t n = 0;
+
+    for (int w = 0; w < nworkers; w++) {
+        for (size_t i = 0; i < NUM_ENDPOINTS; i++) {
+            if (e >= 0 && (size_t)e != i) continue;
+            n += workers[w].samples[i].n;
+            sum.errors += workers[w].samples[i].errors;
+        }
+    }
+    uint32_t *all = malloc((n ? n : 1) * sizeof(*all));
+    if (all == NULL) return sum;
+
+    size_t k = 0;
+    for (int w = 0; w < nworkers; w++) {
+        for (size_t i = 0; i < NUM_ENDPOINTS; i++) {
+            if (e >= 0 && (size_t)e != i) continue;
+            memcpy(all + k, workers[w].samples[i].lat_us, workers[w].samples[i].n * sizeof(*all));
+            k += workers[w].samples[i].n;
+        }
+    }
+    qsort(all, n, sizeof(*all), cmp_u32);
+
+    sum.reqs = n;
+    sum.rps = (double)n / seconds;
+    sum.p50 = percentile(all, n, 0.50);
+    sum.p90 = percentile(all, n, 0.90);
+    sum.p99 = percentile(all, n, 0.99);
+    sum.p999 = percentile(all, n, 0.999);
+    sum.max = n ? all[n - 1] : 0;
+    free(all);
+    return sum;
+}
+
+static void print_row(FILE *out, const char *name, const summary_t *s) {
+    fprintf(out, "%-14s %8lu %9.1f %8u %8u %8u %8u %8u %7lu\n",
+            name, s->reqs, s->rps, s->p50, s->p90, s->p99, s->p999, s->max, s->errors);
+}
+
+/**
+ * @brief Compares this run with a baseline file written by a previous run.
+ * @return Number of regressions found, or -1 if the baseline is unreadable.
+ */
+static int compare_baseline(const char *path, const char names[][16], const summary_t *cur,
+                            int count, double tolerance) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int regressions = 0;
+
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    printf("\nComparison with %s (tolerance %.0f %%):\n", path, tolerance);
+    printf("%-14s %12s %12s %8s %10s %10s %8s\n",
+           "endpoint", "base_rps", "rps", "change", "base_p99", "p99", "change");
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[16];
+        summary_t base;
+
+        if (line[0] == '#') {
+            printf("baseline %s", line + 1);
+            continue;
+        }
+        if (sscanf(line, "%15s %lu %lf %u %u %u %u %u %lu", name, &base.reqs, &base.rps,
+                   &base.p50, &base.p90, &base.p99, &base.p999, &base.max, &base.errors) != 9) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (strcmp(names[i], name) != 0) continue;
+
+            double rps_change = base.rps > 0 ? (cur[i].rps - base.rps) * 100.0 / base.rps : 0;
+            double p99_change = base.p99 > 0 ? ((double)cur[i].p99 - base.p99) * 100.0 / base.p99 : 0;
+            bool slower = rps_change < -tolerance ||
+                          (p99_change > tolerance && cur[i].p99 > base.p99 + P99_NOISE_US);
+
+            printf("%-14s %12.1f %12.1f %+7.1f%% %10u %10u %+7.1f%%%s\n",
+                   name, base.rps, cur[i].rps, rps_change, base.p99, cur[i].p99, p99_change,
+                   slower ? "  <-- REGRESSION" : "");
+            if (slower) regressions++;
+        }
+    }
+    fclose(f);
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    int nconns = 16, seconds = 10;
+    double tolerance = 10.0;
+    const char *mix = "status:60,registers:20,freq:10,index:10";
+    const char *out_path = NULL, *baseline = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:c:d:m:o:b:t:")) != -1) {
+        switch (opt) {
+            case 'H': host = optarg; break;
+            case 'p': port = optarg; break;
+            case 'c': nconns = atoi(optarg); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'm': mix = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': tolerance = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-H host] [-p port] [-c connections] [-d seconds] "
+                                "[-m mix] [-o results] [-b baseline] [-t tolerance_pct]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (nconns < 1 || nconns > MAX_CONNECTIONS || seconds < 1 || parse_mix(mix) == -1) {
+        fprintf(stderr, "Invalid arguments (connections 1-%d, seconds >= 1, non-empty mix)\n",
+                MAX_CONNECTIONS);
+        return 1;
+    }
+
+    worker_t *workers = calloc((size_t)nconns, sizeof(*workers));
+    if (workers == NULL) return 1;
+
+    printf("Benchmarking http://%s:%s with %d connections for %d s\nMix: %s\n\n",
+           host, port, nconns, seconds, mix);
+
+    deadline_us = now_us() + (uint64_t)seconds * 1000000ULL;
+    for (int i = 0; i < nconns; i++) {
+        workers[i].seed = (unsigned int)(i * 7919) ^ (unsigned int)time(NULL);
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+    unsigned long io_errors = 0;
+    for (int i = 0; i < nconns; i++) {
+        pthread_join(workers[i].thread, NULL);
+        io_errors += workers[i].io_errors;
+    }
+
+    // Rows: every endpoint in the mix, then the total
+    char names[NUM_ENDPOINTS + 1][16];
+    summary_t rows[NUM_ENDPOINTS + 1];
+    int count = 0;
+
+    printf("%-14s %8s %9s %8s %8s %8s %8s %8s %7s\n",
+           "endpoint", "reqs", "rps", "p50_us", "p90_us", "p99_us", "p999_us", "max_us", "errors");
+    for (size_t i = 0; i < NUM_ENDPOINTS; i++) {
+        if (weights[i] == 0) continue;
+        snprintf(names[count], sizeof(names[count]), "%s", endpoints[i].name);
+        rows[count] = summarize(workers, nconns, (int)i, seconds);
+        print_row(stdout, names[count], &rows[count]);
+        count++;
+    }
+    snprintf(names[count], sizeof(names[count]), "total");
+    rows[count] = summarize(workers, nconns, -1, seconds);
+    print_row(stdout, names[count], &rows[count]);
+    count++;
+    if (io_errors > 0) printf("\nConnection errors: %lu\n", io_errors);
+
+    if (out_path != NULL) {
+        FILE *f = fopen(out_path, "w");
+        if (f == NULL) {
+            fprintf(stderr, "Cannot write %s: %s\n", out_path, strerror(errno));
+        } else {
+            fprintf(f, "# connections=%d seconds=%d mix=%s\n", nconns, seconds, mix);
+            for (int i = 0; i < count; i++) print_row(f, names[i], &rows[i]);
+            fclose(f);
+            printf("\nResults saved to %s\n", out_path);
+        }
+    }
+
+    int rc = 0;
+    if (baseline != NULL) {
+        int regressions = compare_baseline(baseline, (const char (*)[16])names, rows, count, tolerance);
+        if (regressions > 0) {
+            printf("\n%d regression(s) against baseline\n", regressions);
+            rc = 2;
+        } else if (regressions == 0) {
+            printf("\nNo regressions against baseline\n");
+        }
+    }
+
+    for (int i = 0; i < nconns; i++) {
+        for (size_t e = 0; e < NUM_ENDPOINTS; e++) free(workers[i].samples[e].lat_us);
+    }
+    free(workers);
+    return rc;
+}
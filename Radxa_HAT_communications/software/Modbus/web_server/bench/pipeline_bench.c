@@ -0,0 +1,172 @@
+/**
+ * @file pipeline_bench.c
+ * @brief Throughput of the pipelined Modbus TCP client at several depths.
+ *
+ * For each pipeline depth, keeps exactly that many FC03 reads outstanding on
+ * one connection for a fixed time (every completion submits the next read)
+ * and reports transactions per second and the mean latency. Run it against
+ * plc_standin with a scan cycle (-s) to see how much of the per-transaction
+ * wait pipelining hides; 'make bench-pipeline' does exactly that.
+ *
+ * Usage:
+ *   $ ./pipeline_bench [-H host] [-p port] [-d seconds] [-D depths] [-n registers]
+ *   Defaults: 127.0.0.1:5502, 5 s per depth, depths 1,4,16, 16 registers.
+ *
+ * @author Adrián Silva Palafox
+ * @date   October 2026
+ */
+
+#include "../mb_pipeline.h"
+#include <modbus.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define MAX_DEPTHS  8
+
+typedef struct {
+    int count;                  // Registers per read
+    bool running;               // Completions submit a new read while set
+    unsigned long done;
+    unsigned long errors;
+    int last_error;
+    uint64_t latency_sum_us;
+} run_t;
+
+// One pipeline position; its read is resubmitted when it completes
+typedef struct {
+    run_t *run;
+    uint64_t sent_us;
+} slot_t;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void on_read(mbp_client_t *cli, int err, const uint16_t *regs, int count, void *userdata);
+
+static void submit(mbp_client_t *cli, slot_t *slot) {
+    slot->sent_us = now_us();
+    if (mbp_read_registers(cli, 0, slot->run->count, on_read, slot) != 0) {
+        slot->run->errors++;
+        slot->run->last_error = errno;
+        slot->run->running = false;
+    }
+}
+
+static void on_read(mbp_client_t *cli, int err, const uint16_t *regs, int count, void *userdata) {
+    slot_t *slot = (slot_t *)userdata;
+    run_t *run = slot->run;
+    (void)regs;
+    (void)count;
+
+    if (err != 0) {
+        run->errors++;
+        run->last_error = err;
+    } else {
+        run->done++;
+        run->latency_sum_us += now_us() - slot->sent_us;
+    }
+    if (run->running) submit(cli, slot);
+}
+
+/**
+ * @brief Runs one depth for the given time and prints its result line.
+ * @return 0 on success, -1 if no transaction completed.
+ */
+static int run_depth(struct mg_mgr *mgr, const char *host, int port, int depth, int seconds, int count) {
+    run_t run = { .count = count, .running = true };
+    slot_t slots[MBP_MAX_DEPTH];
+
+    mbp_client_t *cli = mbp_create(mgr, host, port, MODBUS_TCP_SLAVE, depth, 1000);
+    if (cli == NULL) {
+        fprintf(stderr, "Invalid depth %d (1-%d)\n", depth, MBP_MAX_DEPTH);
+        return -1;
+    }
+
+    // Warm up: connect and complete one read before timing
+    slots[0].run = &run;
+    run.running = false;
+    submit(cli, &slots[0]);
+    while (mbp_pending(cli) > 0) mg_mgr_poll(mgr, 10);
+    if (run.done == 0) {
+        fprintf(stderr, "Cannot read from %s:%d: %s\n", host, port, modbus_strerror(run.last_error));
+        mbp_free(cli);
+        return -1;
+    }
+
+    memset(&run, 0, sizeof(run));
+    run.count = count;
+    run.running = true;
+    uint64_t start = now_us();
+    for (int i = 0; i < depth; i++) {
+        slots[i].run = &run;
+        submit(cli, &slots[i]);
+    }
+    while (now_us() - start < (uint64_t)seconds * 1000000 && run.running) {
+        mg_mgr_poll(mgr, 10);
+    }
+    run.running = false;
+    while (mbp_pending(cli) > 0 && mbp_is_connected(cli)) mg_mgr_poll(mgr, 10);
+    double elapsed = (double)(now_us() - start) / 1e6;
+    mbp_free(cli);
+
+    printf("%5d %10lu %10.0f %10.2f %8lu\n", depth, run.done, (double)run.done / elapsed,
+           run.done > 0 ? (double)run.latency_sum_us / (double)run.done / 1000.0 : 0.0, run.errors);
+    if (run.errors > 0) {
+        printf("      last error: %s\n", modbus_strerror(run.last_error));
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = 5502;
+    int seconds = 5;
+    int count = 16;
+    char depths_arg[64] = "1,4,16";
+    int depths[MAX_DEPTHS];
+    int n_depths = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:d:D:n:")) != -1) {
+        switch (opt) {
+            case 'H': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'd': seconds = atoi(optarg); break;
+            case 'D': snprintf(depths_arg, sizeof(depths_arg), "%s", optarg); break;
+            case 'n': count = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-H host] [-p port] [-d seconds] [-D depths] [-n registers]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(depths_arg, ","); tok != NULL && n_depths < MAX_DEPTHS;
+         tok = strtok(NULL, ",")) {
+        depths[n_depths++] = atoi(tok);
+    }
+    if (seconds < 1 || count < 1 || count > MODBUS_MAX_READ_REGISTERS || n_depths == 0) {
+        fprintf(stderr, "Invalid duration, register count or depth list\n");
+        return 1;
+    }
+
+    struct mg_mgr mgr;
+    mg_log_set(MG_LL_ERROR);
+    mg_mgr_init(&mgr);
+
+    printf("FC03 x %d registers from %s:%d, %d s per depth\n", count, host, port, seconds);
+    printf("%5s %10s %10s %10s %8s\n", "depth", "requests", "req/s", "mean_ms", "errors");
+    int rc = 0;
+    for (int i = 0; i < n_depths && rc == 0; i++) {
+        rc = run_depth(&mgr, host, port, depths[i], seconds, count);
+    }
+
+    mg_mgr_free(&mgr);
+    return rc == 0 ? 0 : 1;
+}
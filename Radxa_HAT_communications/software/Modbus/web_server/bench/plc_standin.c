@@ -0,0 +1,195 @@
+/**
+ * @file plc_standin.c
+ * @brief Minimal Modbus TCP server standing in for the PLC during benchmarks.
+ *
+ * Serves holding registers and coils from a libmodbus mapping to any number
+ * of clients, multiplexed with select(). An optional per-request delay
+ * emulates the PLC scan time, so benchmark numbers include a realistic
+ * device turnaround instead of loopback speed.
+ *
+ * With -s the stand-in behaves like a PLC that services communication once
+ * per scan cycle: requests are collected as they arrive and all of them are
+ * answered at the end of the current scan. A client that keeps several
+ * transactions outstanding gets them all back in one cycle, which is what
+ * makes pipelining pay off on real PLCs.
+ *
+ * Usage:
+ *   $ ./plc_standin [-p port] [-d delay_ms] [-s scan_ms]
+ *   Defaults: port 5502, no delay, no scan cycle.
+ *
+ * @author Adrián Silva Palafox
+ * @date   October 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/select.h>
+#include <modbus.h>
+
+#define DEFAULT_PORT    5502
+#define NB_REGISTERS    1024    // Holding registers 0..1023
+#define NB_COILS        64      // Coils 0..63 (pulse mode 'coil')
+#define MAX_CLIENTS     64
+#define MAX_PENDING     1024    // Requests held until the end of the scan
+
+// A request waiting for the end of the scan cycle
+typedef struct {
+    int fd;
+    int len;
+    uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
+} pending_t;
+
+static pending_t pending[MAX_PENDING];
+static int pending_count = 0;
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void handle_shutdown(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Answers every request collected during the scan, in arrival order.
+ */
+static void end_of_scan(modbus_t *ctx, modbus_mapping_t *mapping) {
+    for (int i = 0; i < pending_count; i++) {
+        modbus_set_socket(ctx, pending[i].fd);
+        modbus_reply(ctx, pending[i].query, pending[i].len, mapping);
+    }
+    pending_count = 0;
+}
+
+/**
+ * @brief Drops the pending requests of a client that disconnected.
+ */
+static void drop_pending(int fd) {
+    int n = 0;
+    for (int i = 0; i < pending_count; i++) {
+        if (pending[i].fd != fd) pending[n++] = pending[i];
+    }
+    pending_count = n;
+}
+
+int main(int argc, char *argv[]) {
+    int port = DEFAULT_PORT;
+    int delay_ms = 0;
+    int scan_ms = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:d:s:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'd': delay_ms = atoi(optarg); break;
+            case 's': scan_ms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-d delay_ms] [-s scan_ms]\n", argv[0]);
+                return -1;
+        }
+    }
+
+    modbus_t *ctx = modbus_new_tcp("127.0.0.1", port);
+    if (ctx == NULL) {
+        fprintf(stderr, "Failed to create context: %s\n", modbus_strerror(errno));
+        return -1;
+    }
+
+    modbus_mapping_t *mapping = modbus_mapping_new(NB_COILS, 0, NB_REGISTERS, 0);
+    if (mapping == NULL) {
+        fprintf(stderr, "Failed to allocate mapping: %s\n", modbus_strerror(errno));
+        modbus_free(ctx);
+        return -1;
+    }
+
+    int server = modbus_tcp_listen(ctx, MAX_CLIENTS);
+    if (server == -1) {
+        fprintf(stderr, "Cannot listen on port %d: %s\n", port, modbus_strerror(errno));
+        modbus_mapping_free(mapping);
+        modbus_free(ctx);
+        return -1;
+    }
+
+    signal(SIGINT, handle_shutdown);
+    signal(SIGTERM, handle_shutdown);
+    printf("PLC stand-in listening on 127.0.0.1:%d (delay %d ms, scan %d ms)\n",
+           port, delay_ms, scan_ms);
+    fflush(stdout);
+
+    fd_set clients;
+    int max_fd = server;
+    FD_ZERO(&clients);
+    FD_SET(server, &clients);
+    uint64_t scan_end = now_ms() + (uint64_t)scan_ms;
+
+    while (keep_running) {
+        fd_set ready = clients;
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 200000 };
+
+        if (scan_ms > 0) {
+            uint64_t now = now_ms();
+            if (now >= scan_end) {
+                end_of_scan(ctx, mapping);
+                scan_end = now + (uint64_t)scan_ms;
+            }
+            uint64_t wait = scan_end - now;
+            tv.tv_sec = (time_t)(wait / 1000);
+            tv.tv_usec = (suseconds_t)(wait % 1000) * 1000;
+        }
+
+        if (select(max_fd + 1, &ready, NULL, NULL, &tv) == -1) {
+            if (errno == EINTR) continue;
+            perror("select");
+            break;
+        }
+
+        for (int fd = 0; fd <= max_fd; fd++) {
+            if (!FD_ISSET(fd, &ready)) continue;
+
+            if (fd == server) {
+                int client = modbus_tcp_accept(ctx, &server);
+                if (client != -1) {
+                    FD_SET(client, &clients);
+                    if (client > max_fd) max_fd = client;
+                }
+                continue;
+            }
+
+            uint8_t query[MODBUS_TCP_MAX_ADU_LENGTH];
+            modbus_set_socket(ctx, fd);
+            int rc = modbus_receive(ctx, query);
+            if (rc > 0) {
+                if (delay_ms > 0) usleep((useconds_t)delay_ms * 1000);
+                if (scan_ms > 0 && pending_count < MAX_PENDING) {
+                    pending[pending_count].fd = fd;
+                    pending[pending_count].len = rc;
+                    memcpy(pending[pending_count].query, query, (size_t)rc);
+                    pending_count++;
+                } else if (scan_ms > 0) {
+                    modbus_reply_exception(ctx, query, MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY);
+                } else {
+                    modbus_reply(ctx, query, rc, mapping);
+                }
+            } else if (rc == -1) {
+                drop_pending(fd);
+                close(fd);
+                FD_CLR(fd, &clients);
+            }
+        }
+    }
+
+    close(server);
+    modbus_mapping_free(mapping);
+    modbus_free(ctx);
+    return 0;
+}
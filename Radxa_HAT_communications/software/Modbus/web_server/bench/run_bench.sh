@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+# Runs modbus_server against the local PLC stand-in and load-tests it.
+# Normally started through 'make bench' / 'make bench-baseline'.
+#
+# Environment (defaults in brackets):
+#   BENCH_CONNS     concurrent HTTP connections              [16]
+#   BENCH_SECONDS   test duration                            [10]
+#   BENCH_MIX       endpoint mix, name:weight,...            [status:60,registers:20,freq:10,index:10]
+#   BENCH_DELAY_MS  stand-in turnaround per Modbus request   [5]
+#   BENCH_POOL      Modbus connections of the server         [1]
+#   BENCH_PORT      stand-in Modbus TCP port                 [5502]
+#   BENCH_RESULTS   where to save this run                   [build/bench_results.txt]
+#   BENCH_BASELINE  baseline to compare against, if it exists [bench/baseline.txt]
+#   BENCH_TOLERANCE allowed regression in percent             [10]
+#   BENCH_SAVE      set to 1 to store this run as the new baseline
+
+set -u
+
+BUILDDIR=${BUILDDIR:-build}
+BENCH_CONNS=${BENCH_CONNS:-16}
+BENCH_SECONDS=${BENCH_SECONDS:-10}
+BENCH_MIX=${BENCH_MIX:-status:60,registers:20,freq:10,index:10}
+BENCH_DELAY_MS=${BENCH_DELAY_MS:-5}
+BENCH_POOL=${BENCH_POOL:-1}
+BENCH_PORT=${BENCH_PORT:-5502}
+BENCH_RESULTS=${BENCH_RESULTS:-$BUILDDIR/bench_results.txt}
+BENCH_BASELINE=${BENCH_BASELINE:-bench/baseline.txt}
+BENCH_TOLERANCE=${BENCH_TOLERANCE:-10}
+BENCH_SAVE=${BENCH_SAVE:-0}
+
+STANDIN_PID=
+SERVER_PID=
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null
+    [ -n "$STANDIN_PID" ] && kill "$STANDIN_PID" 2>/dev/null
+    wait 2>/dev/null
+}
+trap cleanup EXIT INT TERM
+
+# Polls until a TCP port accepts connections (up to ~5 s)
+wait_port() {
+    for _ in $(seq 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null && return 0
+        sleep 0.1
+    done
+    echo "❌ Nothing listening on port $1" >&2
+    return 1
+}
+
+if (exec 3<>/dev/tcp/127.0.0.1/8000) 2>/dev/null; then
+    echo "❌ Port 8000 is already in use, stop the running server first" >&2
+    exit 1
+fi
+
+"$BUILDDIR/plc_standin" -p "$BENCH_PORT" -d "$BENCH_DELAY_MS" > "$BUILDDIR/plc_standin.log" 2>&1 &
+STANDIN_PID=$!
+wait_port "$BENCH_PORT" || exit 1
+
+./modbus_server "bench=127.0.0.1:$BENCH_PORT,$BENCH_POOL" > "$BUILDDIR/bench_server.log" 2>&1 &
+SERVER_PID=$!
+wait_port 8000 || exit 1
+# Let the workers connect and the poller fill its first snapshot
+sleep 1
+
+COMPARE=()
+if [ "$BENCH_SAVE" != 1 ] && [ -f "$BENCH_BASELINE" ]; then
+    COMPARE=(-b "$BENCH_BASELINE" -t "$BENCH_TOLERANCE")
+fi
+
+"$BUILDDIR/http_bench" -c "$BENCH_CONNS" -d "$BENCH_SECONDS" -m "$BENCH_MIX" \
+    -o "$BENCH_RESULTS" "${COMPARE[@]}"
+RC=$?
+
+if [ "$BENCH_SAVE" = 1 ] && [ $RC -eq 0 ]; then
+    cp "$BENCH_RESULTS" "$BENCH_BASELINE"
+    echo "📌 Baseline saved to $BENCH_BASELINE"
+fi
+exit $RC
@@ -0,0 +1,393 @@
+/**
+ * @file mb_pipeline.c
+ * @brief Non-blocking Modbus TCP client with pipelined transactions.
+ *
+ * Requests are encoded into ADUs when submitted. A fixed table of in-flight
+ * slots, one per pipeline position, remembers the transaction id, function
+ * code and deadline of every request on the wire; a ring holds the rest.
+ * MG_EV_READ cuts complete MBAP frames out of the receive buffer, finds the
+ * slot by transaction id and completes it, which frees a slot for the next
+ * queued request. MG_EV_POLL expires slots that outlive the timeout, and a
+ * closed connection fails everything still pending.
+ *
+ * @author Adrián Silva Palafox
+ * @date   October 2026
+ */
+
+#include "mb_pipeline.h"
+#include <modbus.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MBAP_HEADER_LEN     7       // Transaction, protocol, length, unit id
+#define MBP_PDU_MAX         253     // Function code plus data
+
+typedef struct {
+    bool used;
+    uint16_t tid;                   // Transaction id, valid once sent
+    uint8_t pdu[MBP_PDU_MAX];       // Request PDU, pdu[0] is the function code
+    uint8_t pdu_len;
+    uint16_t count;                 // Registers expected back by an FC03
+    uint64_t deadline_ms;           // mg_millis() after which the request times out
+    mbp_done_t done;
+    void *userdata;
+} mbp_req_t;
+
+struct mbp_client {
+    struct mg_mgr *mgr;
+    struct mg_connection *conn;     // NULL while disconnected
+    char url[80];
+    uint8_t unit_id;
+    int depth;
+    int timeout_ms;
+    bool connected;                 // TCP connect completed
+    int close_err;                  // Error reported for requests failed by a close
+    uint64_t connect_deadline_ms;
+    uint64_t next_connect_ms;       // Earliest next connect attempt
+    uint16_t next_tid;
+
+    mbp_req_t inflight[MBP_MAX_DEPTH];
+    int inflight_count;
+
+    mbp_req_t queue[MBP_QUEUE_LEN];
+    size_t queue_head;
+    size_t queue_count;
+};
+
+static void mbp_fn(struct mg_connection *c, int ev, void *ev_data);
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)(v & 0xFF);
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief Completes a request. The slot is released before the callback runs,
+ *        so the callback may submit new requests.
+ */
+static void complete(mbp_client_t *cli, mbp_req_t *req, int err, const uint16_t *regs, int count) {
+    mbp_done_t done = req->done;
+    void *userdata = req->userdata;
+
+    req->used = false;
+    if (done != NULL) done(cli, err, regs, count, userdata);
+}
+
+/**
+ * @brief Moves queued requests onto the wire while pipeline slots are free.
+ */
+static void pump(mbp_client_t *cli) {
+    if (cli->conn == NULL || !cli->connected) return;
+
+    while (cli->queue_count > 0 && cli->inflight_count < cli->depth) {
+        mbp_req_t *slot = NULL;
+        for (int i = 0; i < cli->depth; i++) {
+            if (!cli->inflight[i].used) {
+                slot = &cli->inflight[i];
+                break;
+            }
+        }
+        if (slot == NULL) break;
+
+        *slot = cli->queue[cli->queue_head];
+        cli->queue_head = (cli->queue_head + 1) % MBP_QUEUE_LEN;
+        cli->queue_count--;
+
+        // Skip ids still on the wire; only possible after 65536 requests
+        bool busy;
+        do {
+            slot->tid = cli->next_tid++;
+            busy = false;
+            for (int i = 0; i < cli->depth; i++) {
+                if (&cli->inflight[i] != slot && cli->inflight[i].used &&
+                    cli->inflight[i].tid == slot->tid) {
+                    busy = true;
+                }
+            }
+        } while (busy);
+
+        uint8_t adu[MBAP_HEADER_LEN + MBP_PDU_MAX];
+        put16(&adu[0], slot->tid);
+        put16(&adu[2], 0);                              // Protocol id: Modbus
+        put16(&adu[4], (uint16_t)(slot->pdu_len + 1));  // Unit id + PDU
+        adu[6] = cli->unit_id;
+        memcpy(&adu[MBAP_HEADER_LEN], slot->pdu, slot->pdu_len);
+
+        slot->deadline_ms = mg_millis() + (uint64_t)cli->timeout_ms;
+        cli->inflight_count++;
+        mg_send(cli->conn, adu, MBAP_HEADER_LEN + (size_t)slot->pdu_len);
+    }
+}
+
+/**
+ * @brief Fails every in-flight and queued request with the given error.
+ */
+static void fail_all(mbp_client_t *cli, int err) {
+    for (int i = 0; i < cli->depth; i++) {
+        if (!cli->inflight[i].used) continue;
+        cli->inflight_count--;
+        complete(cli, &cli->inflight[i], err, NULL, 0);
+    }
+    while (cli->queue_count > 0) {
+        mbp_req_t req = cli->queue[cli->queue_head];
+        cli->queue_head = (cli->queue_head + 1) % MBP_QUEUE_LEN;
+        cli->queue_count--;
+        complete(cli, &req, err, NULL, 0);
+    }
+}
+
+/**
+ * @brief Matches one response frame to its request and completes it.
+ *
+ * Responses with an unknown transaction id are dropped: they answer a
+ * request that already timed out.
+ */
+static void handle_frame(mbp_client_t *cli, uint16_t tid, const uint8_t *pdu, size_t len) {
+    mbp_req_t *req = NULL;
+
+    for (int i = 0; i < cli->depth; i++) {
+        if (cli->inflight[i].used && cli->inflight[i].tid == tid) {
+            req = &cli->inflight[i];
+            break;
+        }
+    }
+    if (req == NULL) return;
+    cli->inflight_count--;
+
+    uint8_t fc = req->pdu[0];
+    if (pdu[0] == (fc | 0x80)) {
+        complete(cli, req, len >= 2 ? MODBUS_ENOBASE + pdu[1] : EMBBADDATA, NULL, 0);
+    } else if (pdu[0] != fc) {
+        complete(cli, req, EMBBADDATA, NULL, 0);
+    } else if (fc == MODBUS_FC_READ_HOLDING_REGISTERS) {
+        uint16_t regs[MODBUS_MAX_READ_REGISTERS];
+        if (len < 2 || pdu[1] != req->count * 2 || len != 2 + (size_t)pdu[1]) {
+            complete(cli, req, EMBBADDATA, NULL, 0);
+            return;
+        }
+        for (int i = 0; i < req->count; i++) regs[i] = get16(&pdu[2 + 2 * i]);
+        complete(cli, req, 0, regs, req->count);
+    } else {
+        // FC06 and FC16 echo the address and value/quantity
+        complete(cli, req, len == 5 ? 0 : EMBBADDATA, NULL, 0);
+    }
+}
+
+/**
+ * @brief Cuts complete MBAP frames out of the receive buffer.
+ */
+static void handle_read(mbp_client_t *cli, struct mg_connection *c) {
+    while (c->recv.len >= MBAP_HEADER_LEN) {
+        uint16_t tid = get16(&c->recv.buf[0]);
+        uint16_t proto = get16(&c->recv.buf[2]);
+        uint16_t length = get16(&c->recv.buf[4]);
+
+        if (proto != 0 || length < 2 || length > MBP_PDU_MAX + 1) {
+            // Framing is lost, the stream cannot be resynchronised
+            cli->close_err = EMBBADDATA;
+            mg_error(c, "bad MBAP header");
+            return;
+        }
+        size_t frame = 6 + (size_t)length;
+        if (c->recv.len < frame) break;
+
+        handle_frame(cli, tid, &c->recv.buf[MBAP_HEADER_LEN], length - 1);
+        mg_iobuf_del(&c->recv, 0, frame);
+        if (c->fn_data != cli) return;  // A callback freed the client
+    }
+    pump(cli);
+}
+
+/**
+ * @brief Fails in-flight requests that passed their deadline.
+ *
+ * The connection stays open: a late response is dropped by handle_frame().
+ */
+static void expire(mbp_client_t *cli, struct mg_connection *c) {
+    uint64_t now = mg_millis();
+
+    if (!cli->connected) {
+        if (now >= cli->connect_deadline_ms) {
+            cli->close_err = ETIMEDOUT;
+            mg_error(c, "connect timeout");
+        }
+        return;
+    }
+    for (int i = 0; i < cli->depth; i++) {
+        if (cli->inflight[i].used && now >= cli->inflight[i].deadline_ms) {
+            cli->inflight_count--;
+            complete(cli, &cli->inflight[i], ETIMEDOUT, NULL, 0);
+        }
+    }
+    pump(cli);
+}
+
+static void mbp_fn(struct mg_connection *c, int ev, void *ev_data) {
+    mbp_client_t *cli = (mbp_client_t *)c->fn_data;
+    (void)ev_data;
+
+    if (cli == NULL || cli->conn != c) return;
+
+    switch (ev) {
+        case MG_EV_CONNECT:
+            cli->connected = true;
+            pump(cli);
+            break;
+        case MG_EV_READ:
+            handle_read(cli, c);
+            break;
+        case MG_EV_POLL:
+            expire(cli, c);
+            break;
+        case MG_EV_CLOSE: {
+            int err = cli->close_err != 0 ? cli->close_err : cli->connected ? ECONNRESET : ECONNREFUSED;
+            cli->conn = NULL;
+            cli->connected = false;
+            cli->close_err = 0;
+            cli->next_connect_ms = mg_millis() + MBP_RETRY_MS;
+            fail_all(cli, err);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Opens the connection if there is none and the retry delay is over.
+ * @return 0 if a connection exists or is being opened, -1 otherwise.
+ */
+static int ensure_connection(mbp_client_t *cli) {
+    if (cli->conn != NULL) return 0;
+    if (mg_millis() < cli->next_connect_ms) return -1;
+
+    cli->connected = false;
+    cli->close_err = 0;
+    cli->connect_deadline_ms = mg_millis() + (uint64_t)cli->timeout_ms;
+    cli->conn = mg_connect(cli->mgr, cli->url, mbp_fn, cli);
+    if (cli->conn == NULL) {
+        cli->next_connect_ms = mg_millis() + MBP_RETRY_MS;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends an encoded request to the queue and sends what fits.
+ */
+static int submit(mbp_client_t *cli, const uint8_t *pdu, size_t pdu_len, int count,
+                  mbp_done_t done, void *userdata) {
+    if (cli->queue_count >= MBP_QUEUE_LEN) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (ensure_connection(cli) != 0) {
+        errno = ENOTCONN;
+        return -1;
+    }
+
+    mbp_req_t *req = &cli->queue[(cli->queue_head + cli->queue_count) % MBP_QUEUE_LEN];
+    memset(req, 0, sizeof(*req));
+    req->used = true;
+    memcpy(req->pdu, pdu, pdu_len);
+    req->pdu_len = (uint8_t)pdu_len;
+    req->count = (uint16_t)count;
+    req->done = done;
+    req->userdata = userdata;
+    cli->queue_count++;
+
+    pump(cli);
+    return 0;
+}
+
+mbp_client_t *mbp_create(struct mg_mgr *mgr, const char *host, int port, int unit_id,
+                         int depth, int timeout_ms) {
+    if (depth < 1 || depth > MBP_MAX_DEPTH || port <= 0 || port > 65535 ||
+        unit_id < 0 || unit_id > 255 || timeout_ms <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mbp_client_t *cli = calloc(1, sizeof(*cli));
+    if (cli == NULL) return NULL;
+
+    cli->mgr = mgr;
+    snprintf(cli->url, sizeof(cli->url), "tcp://%s:%d", host, port);
+    cli->unit_id = (uint8_t)unit_id;
+    cli->depth = depth;
+    cli->timeout_ms = timeout_ms;
+    return cli;
+}
+
+int mbp_read_registers(mbp_client_t *cli, int addr, int count, mbp_done_t done, void *userdata) {
+    uint8_t pdu[5];
+
+    if (addr < 0 || count < 1 || count > MODBUS_MAX_READ_REGISTERS || addr + count > 65536) {
+        errno = EINVAL;
+        return -1;
+    }
+    pdu[0] = MODBUS_FC_READ_HOLDING_REGISTERS;
+    put16(&pdu[1], (uint16_t)addr);
+    put16(&pdu[3], (uint16_t)count);
+    return submit(cli, pdu, sizeof(pdu), count, done, userdata);
+}
+
+int mbp_write_register(mbp_client_t *cli, int addr, uint16_t value, mbp_done_t done, void *userdata) {
+    uint8_t pdu[5];
+
+    if (addr < 0 || addr > 65535) {
+        errno = EINVAL;
+        return -1;
+    }
+    pdu[0] = MODBUS_FC_WRITE_SINGLE_REGISTER;
+    put16(&pdu[1], (uint16_t)addr);
+    put16(&pdu[3], value);
+    return submit(cli, pdu, sizeof(pdu), 0, done, userdata);
+}
+
+int mbp_write_registers(mbp_client_t *cli, int addr, int count, const uint16_t *values,
+                        mbp_done_t done, void *userdata) {
+    uint8_t pdu[6 + MODBUS_MAX_WRITE_REGISTERS * 2];
+
+    if (addr < 0 || count < 1 || count > MODBUS_MAX_WRITE_REGISTERS || addr + count > 65536) {
+        errno = EINVAL;
+        return -1;
+    }
+    pdu[0] = MODBUS_FC_WRITE_MULTIPLE_REGISTERS;
+    put16(&pdu[1], (uint16_t)addr);
+    put16(&pdu[3], (uint16_t)count);
+    pdu[5] = (uint8_t)(count * 2);
+    for (int i = 0; i < count; i++) put16(&pdu[6 + 2 * i], values[i]);
+    return submit(cli, pdu, 6 + (size_t)count * 2, 0, done, userdata);
+}
+
+bool mbp_is_connected(const mbp_client_t *cli) {
+    return cli->conn != NULL && cli->connected;
+}
+
+int mbp_depth(const mbp_client_t *cli) {
+    return cli->depth;
+}
+
+int mbp_pending(const mbp_client_t *cli) {
+    return cli->inflight_count + (int)cli->queue_count;
+}
+
+void mbp_free(mbp_client_t *cli) {
+    if (cli == NULL) return;
+    if (cli->conn != NULL) {
+        cli->conn->fn_data = NULL;
+        cli->conn->is_closing = 1;
+        cli->conn = NULL;
+    }
+    // No reconnect from callbacks of a client being freed
+    cli->next_connect_ms = UINT64_MAX;
+    fail_all(cli, ECANCELED);
+    free(cli);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file mb_pipeline.h
+ * @brief Non-blocking Modbus TCP client with pipelined transactions.
+ *
+ * A Modbus TCP (MBAP) client driven by the Mongoose event loop instead of a
+ * blocking libmodbus context. Requests carry a transaction id and up to
+ * 'depth' of them are kept on the wire at once; responses are matched back
+ * by that id, so a PLC that accepts several outstanding transactions serves
+ * them without one round trip each. Requests beyond the depth wait in a FIFO
+ * and are sent as responses come in.
+ *
+ * Everything, including the completion callbacks, runs on the thread that
+ * calls mg_mgr_poll(). Nothing here is thread-safe.
+ *
+ * @author Adrián Silva Palafox
+ * @date   October 2026
+ */
+
+#ifndef MB_PIPELINE_H
+#define MB_PIPELINE_H
+
+#include "mongoose.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MBP_MAX_DEPTH       32      // Upper bound for the pipeline depth
+#define MBP_QUEUE_LEN       128     // Requests waiting for a free slot
+#define MBP_RETRY_MS        1000    // Minimum time between two connect attempts
+
+typedef struct mbp_client mbp_client_t;
+
+/**
+ * @brief Completion callback of a request.
+ * @param err 0 on success, otherwise an errno value or MODBUS_ENOBASE + the
+ *            Modbus exception code, both printable with modbus_strerror().
+ * @param regs Registers read (read requests only), NULL otherwise.
+ * @param count Number of registers in regs.
+ * @param userdata Pointer given when the request was submitted.
+ */
+typedef void (*mbp_done_t)(mbp_client_t *cli, int err, const uint16_t *regs, int count,
+                           void *userdata);
+
+/**
+ * @brief Creates a client. The connection is opened by the first request.
+ * @param unit_id Unit identifier put in every MBAP header (0xFF for most PLCs).
+ * @param depth Maximum transactions in flight, 1..MBP_MAX_DEPTH.
+ * @param timeout_ms Response timeout of each transaction.
+ * @return The client, or NULL if the arguments are invalid or allocation fails.
+ */
+mbp_client_t *mbp_create(struct mg_mgr *mgr, const char *host, int port, int unit_id,
+                         int depth, int timeout_ms);
+
+/**
+ * @brief Queues an FC03 read of holding registers.
+ * @return 0 if queued, -1 with errno set (EINVAL, EAGAIN if the queue is full,
+ *         ENOTCONN while waiting to reconnect).
+ */
+int mbp_read_registers(mbp_client_t *cli, int addr, int count, mbp_done_t done, void *userdata);
+
+/**
+ * @brief Queues an FC06 write of one holding register.
+ * @return 0 if queued, -1 with errno set as for mbp_read_registers().
+ */
+int mbp_write_register(mbp_client_t *cli, int addr, uint16_t value, mbp_done_t done, void *userdata);
+
+/**
+ * @brief Queues an FC16 write of a block of holding registers.
+ * @return 0 if queued, -1 with errno set as for mbp_read_registers().
+ */
+int mbp_write_registers(mbp_client_t *cli, int addr, int count, const uint16_t *values,
+                        mbp_done_t done, void *userdata);
+
+bool mbp_is_connected(const mbp_client_t *cli);
+int mbp_depth(const mbp_client_t *cli);
+
+/** @brief Transactions on the wire plus those waiting for a slot. */
+int mbp_pending(const mbp_client_t *cli);
+
+/**
+ * @brief Closes the connection and frees the client. Outstanding requests
+ *        complete with ECANCELED before this returns.
+ */
+void mbp_free(mbp_client_t *cli);
+
+#endif // MB_PIPELINE_H
@@ -3,21 +3,73 @@
  * @brief HTTP server for Modbus TCP control using Mongoose and libmodbus.
  *
  * This file implements a simple HTTP server that provides a REST API to control
- * and monitor a Modbus device (such as a VFD) over TCP. The server uses the
- * Mongoose library for HTTP handling and libmodbus for Modbus communication.
- * Thread safety is ensured using a mutex for Modbus operations.
+ * and monitor one or more Modbus devices (such as VFDs behind PLCs) over TCP.
+ * The server uses the Mongoose library for HTTP handling and libmodbus for
+ * Modbus communication.
  *
- * API Endpoints:
- *   - POST /api/run    : Toggle run/stop state of the device.
- *   - POST /api/dir    : Toggle forward/reverse direction.
- *   - POST /api/freq   : Set frequency (expects 'freq' parameter in body).
- *   - GET  /api/status : Get current frequency, run state, and direction.
+ * Every PLC is an entry in a device registry. A device owns a small pool of
+ * Modbus TCP connections and one worker thread per pooled connection. Modbus
+ * writes never run inside the Mongoose event handler: each command is queued
+ * as a job on the target device, a worker of that device performs the
+ * blocking libmodbus call and hands the result back to the event loop via
+ * mg_wakeup(). The HTTP reply is sent when that result arrives, so static
+ * files and /api/status keep being served while a PLC is slow to answer, and
+ * commands for different PLCs never wait on each other.
+ *
+ * Each pooled connection tracks its own link state. A failed transaction
+ * closes the connection and the worker reconnects with jittered exponential
+ * backoff; idle connections are probed periodically so a rebooted PLC is
+ * noticed before the next command. While a device has no live connection,
+ * commands are rejected immediately instead of waiting for TCP timeouts.
+ *
+ * The web UI is compiled into the binary (see pack_www.py and static_opts),
+ * so it is served from memory with gzip and content-based ETags.
+ *
+ * API Endpoints (all accept an optional '?dev=<id>' query parameter, the
+ * first registered device is used when it is omitted):
+ *   - POST /api/run     : Toggle run/stop state of the device.
+ *   - POST /api/dir     : Toggle forward/reverse direction.
+ *   - POST /api/freq    : Set frequency (expects 'freq' parameter in body).
+ *                         Bursts are coalesced, the newest setpoint wins.
+ *   - GET  /api/status  : Get current frequency, run state, direction and link health.
+ *   - GET  /api/devices : List the registered devices.
+ *   - GET  /api/registers : Read holding registers ('start', 'count'), as JSON
+ *                           or raw words ('format=bin'), from the poller
+ *                           mirror when fresh, else over the pipelined
+ *                           connection if the device has one.
+ *   - POST /api/registers : Write a block of holding registers with one FC16.
+ *   - GET  /api/history   : Downsampled min/max/avg history of a polled
+ *                           register ('reg', 'from', 'to', 'points').
+ *   - POST /api/ramp      : Play a frequency profile ('profile', 'period_ms',
+ *                           see ramp.h) with paced writes on the pipelined
+ *                           connection. GET reports its progress and timing
+ *                           error, DELETE stops it.
+ *
+ * Usage:
+ *   $ ./modbus_server [id=host[:port][,pool[,pulse[,depth]]] ...]
+ *   Default device: plc0=192.168.0.52:502,1,twice,0
+ *
+ * A depth greater than 0 opens one more connection to the PLC, driven by
+ * the event loop (see mb_pipeline.h), that keeps up to 'depth' register
+ * reads in flight at once. Only for PLCs that accept several outstanding
+ * transactions; with 0 every read goes through the worker queue. Ramps need
+ * that connection: their writes are sent on a fixed schedule without waiting
+ * for the previous ones to be answered.
+ *
+ * Pulse modes (how a button press is sent, see push_button()):
+ *   - twice : FC06 write 1 then FC06 write 0 (works with any PLC program).
+ *   - auto  : one FC06 write 1; the PLC program resets the register itself.
+ *   - coil  : one FC05 coil ON; the PLC program resets the coil itself.
+ *             Falls back to 'twice' if the PLC rejects the coil address.
  *
  * @author Adrián Silva Palafox
  * @date   September 2025
  */
 
 #include "mongoose.h"
+#include "mb_pipeline.h"
+#include "ramp.h"
+#include "pulse.h"
 #include <modbus.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -26,240 +78,2139 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <limits.h>
 #include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <sys/param.h>
 
 // Uncomment to disable real Modbus communication for debugging
 // #define DEBUG_WEB
 
-// PLC server parameters
+// Default PLC, used when no device is given on the command line
 #define SERVER_IP "192.168.0.52"
 
-static modbus_t *mb; /**< Global Modbus context pointer */
-static pthread_mutex_t mb_lock = PTHREAD_MUTEX_INITIALIZER; /**< Mutex for Modbus operations */
+// ==== Device Registry Limits ====
+#define MAX_DEVICES    8    // Maximum number of PLCs in the registry
+#define MAX_POOL_SIZE  4    // Maximum concurrent connections per PLC
+#define DEVICE_ID_LEN  16   // Including the terminating NUL
+#define JOB_QUEUE_LEN  32   // Pending jobs per device before new requests get a 503
+
+// ==== Link Supervision ====
+#define MODBUS_TIMEOUT_MS   1000    // Response (and connect) timeout per transaction
+#define BACKOFF_MIN_MS      250     // First reconnect delay
+#define BACKOFF_MAX_MS      10000   // Reconnect delay cap
+#define HEALTH_PROBE_MS     5000    // Idle time before a connection is probed
+#define PROBE_REGISTER      0       // Holding register read by the idle probe
+
+// ==== Register Poller ====
+// A block of holding registers is mirrored in memory so that /api/registers
+// reads inside it never reach the PLC while the copy is fresh.
+#define POLL_START          0       // First mirrored holding register
+#define POLL_COUNT          16      // Mirrored registers, read with one FC03
+#define POLL_INTERVAL_MS    500     // Refresh period of the mirror
+#define CACHE_MAX_AGE_MS    1000    // Default freshness required by /api/registers
+
+// ==== Telemetry History ====
+// Polled values of the first HISTORY_REGISTERS mirrored registers are rolled
+// up into min/max/avg buckets: one per second for the last hour and one per
+// minute for the last day. /api/history downsamples them to a bounded size.
+#define HISTORY_REGISTERS   4       // Registers POLL_START.. with a history
+#define HISTORY_SECONDS     3600    // Per-second buckets kept (1 hour)
+#define HISTORY_MINUTES     1440    // Per-minute buckets kept (1 day)
+#define HISTORY_MAX_POINTS  2000    // Upper bound for the 'points' parameter
+
+// ==== Frequency Setpoint Coalescing ====
+// Setpoints are not queued: each one replaces the pending value of its device
+// and a worker writes only the newest one, at most once per FREQ_FLUSH_MS.
+#define FREQ_FLUSH_MS       100     // Minimum time between two frequency writes
+#define FREQ_WAITERS        64      // Requests that can wait on one pending setpoint
+
+// ==== Reply Deadline ====
+// A request waiting for a worker result is answered with 504 if no result
+// arrives in time (e.g. the wakeup datagram was lost under load). The deadline
+// covers every job queued ahead of it at its slowest, see reply_timeout_ms().
+#define JOB_MAX_TRANSACTIONS 2      // Most Modbus transactions in one job (a PULSE_TWICE press)
+#define REPLY_SLACK_MS      1000    // Thread and event loop wake-up latency
+
+// ==== Frequency Ramps ====
+// A ramp writes the frequency register once per period on the pipelined
+// connection. The event loop wakes up for every step, so the cadence does
+// not depend on how fast the PLC answers.
+#define RAMP_PERIOD_MS      50      // Default time between two ramp writes
+#define RAMP_PERIOD_MIN_MS  5
+#define RAMP_PERIOD_MAX_MS  10000
+#define POLL_MAX_MS         1000    // Longest mg_mgr_poll() wait
+
+// ==== Modbus Worker Queue ====
+// Jobs are produced by the event loop and consumed by modbus_worker().
+typedef enum {
+    JOB_RUN_TOGGLE,
+    JOB_DIR_TOGGLE,
+    JOB_FREQ_SET,
+    JOB_READ_REGS,
+    JOB_WRITE_REGS
+} job_op_t;
+
+typedef struct {
+    unsigned long conn_id;  // Mongoose connection waiting for the reply
+    job_op_t op;
+    uint16_t start;         // First register for JOB_READ_REGS/JOB_WRITE_REGS
+    uint16_t count;         // Number of registers
+    bool binary;            // Reply as application/octet-stream
+    uint16_t values[MODBUS_MAX_WRITE_REGISTERS];  // Data for JOB_WRITE_REGS
+} mb_job_t;
+
+// Sent back through mg_wakeup(), so it must stay a flat POD struct
+typedef struct {
+    int dev;                // Index in the device registry
+    job_op_t op;
+    int rc;                 // 0 on success, -1 on failure
+    int err;                // errno of the failure, 0 if the device was offline
+    bool run;
+    bool direction;
+    int freq;               // Frequency in Hz
+    long latency_us;        // Time spent on the Modbus transaction(s)
+    uint16_t start;         // Register range of JOB_READ_REGS/JOB_WRITE_REGS
+    uint16_t count;
+    bool binary;
+    int requested;          // JOB_FREQ_SET: frequency this request asked for
+    int coalesced;          // JOB_FREQ_SET: requests answered by the same write
+    uint16_t regs[MODBUS_MAX_READ_REGISTERS];     // Data read by JOB_READ_REGS
+} mb_result_t;
+
+// One rollup bucket of a register's history
+typedef struct {
+    uint32_t t;             // Bucket start in Unix seconds, 0 if never filled
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint32_t count;
+} hist_bucket_t;
+
+typedef struct {
+    hist_bucket_t sec[HISTORY_SECONDS];     // Ring indexed by t % HISTORY_SECONDS
+    hist_bucket_t min[HISTORY_MINUTES];     // Ring indexed by (t / 60) % HISTORY_MINUTES
+} reg_history_t;
+
+// A rolled-up sample returned by /api/history
+typedef struct {
+    uint32_t t;
+    uint16_t min;
+    uint16_t max;
+    double avg;
+    uint32_t count;
+} hist_point_t;
+
+// A /api/freq request waiting for the next setpoint write
+typedef struct {
+    unsigned long conn_id;
+    int requested;          // Frequency in Hz
+} freq_waiter_t;
+
+// Stored in c->data of a connection waiting for a worker result
+typedef struct {
+    uint64_t deadline_ms;   // mg_millis() when a 504 is sent, 0 if nothing is pending
+    uint32_t timeout_ms;    // Time the request was given
+    int dev;                // Device the request went to
+} pending_reply_t;
+
+struct plc_device;
+
+/**
+ * @brief One pooled Modbus TCP connection and the worker thread that owns it.
+ *
+ * Link fields are written by the owning worker under the device job_lock.
+ */
+typedef struct {
+    struct plc_device *dev;     // Owning device
+    modbus_t *mb;               // Only ever touched by the owning worker
+    pthread_t thread;
+    bool connected;             // Link state of this connection
+    bool was_up;                // Has been connected at least once
+    uint32_t backoff_ms;        // Next reconnect delay before jitter
+    uint64_t next_attempt_ms;   // mg_millis() of the next reconnect attempt
+    uint64_t next_probe_ms;     // mg_millis() of the next idle probe
+    unsigned int seed;          // rand_r() state for backoff jitter
+} plc_conn_t;
+
+/**
+ * @brief One PLC in the device registry.
+ *
+ * Each pooled connection is driven by its own worker, so a device with a pool
+ * of N connections can have N transactions in flight. Devices share nothing
+ * but the Mongoose manager, so requests to different PLCs run in parallel.
+ */
+typedef struct plc_device {
+    int index;                          // Position in the registry
+    char id[DEVICE_ID_LEN];             // Name used in '?dev=' queries
+    char ip[64];                        // PLC address
+    int port;                           // PLC Modbus TCP port
+    int pool_size;                      // Number of connections in use
+    plc_conn_t pool[MAX_POOL_SIZE];
+
+    // Job queue shared by this device's workers
+    mb_job_t jobs[JOB_QUEUE_LEN];
+    size_t job_head;
+    size_t job_count;
+    pthread_mutex_t job_lock;
+    pthread_cond_t job_cond;            // Uses CLOCK_MONOTONIC for timed waits
+
+    // Link health, protected by job_lock
+    int conns_up;                       // Pooled connections currently connected
+    unsigned long reconnects;           // Successful reconnections since start
+    char last_error[64];                // Last link error, empty if none
+    uint64_t next_poll_ms;              // mg_millis() of the next register poll
+
+    // Frequency setpoint coalescing, protected by job_lock
+    int freq_pending;                   // Newest requested frequency in Hz, -1 if none
+    freq_waiter_t freq_waiters[FREQ_WAITERS];
+    int freq_waiter_count;
+    bool freq_inflight;                 // A worker is writing a setpoint
+    uint64_t next_freq_ms;              // mg_millis() of the earliest next write
+
+    // Held from reading run/direction to storing the toggled value, so two
+    // workers cannot both push the same button
+    pthread_mutex_t cmd_lock;
+
+    // Current state of the PLC as seen by the web interface
+    pthread_mutex_t state_lock;
+    bool run;                           // false = STOP, true = RUN
+    bool direction;                     // false = FWD, true = REV
+    int frequency;                      // Frequency in Hz * 100 (for Modbus scaling)
+    pulse_mode_t pulse;                 // How button presses are sent
+    long last_cmd_us;                   // Duration of the last successful command
+    uint16_t regs[POLL_COUNT];          // Mirror of registers POLL_START..
+    uint64_t regs_ms;                   // mg_millis() of the last poll, 0 = never
+
+    // Rollups of polled values, protected by hist_lock
+    pthread_mutex_t hist_lock;
+    reg_history_t *history;             // HISTORY_REGISTERS entries
+
+    // Pipelined reads, only touched by the event loop
+    int pipeline_depth;                 // 0 = reads go through the job queue
+    mbp_client_t *pipe;
+
+    // Frequency ramp, only touched by the event loop
+    ramp_t ramp;                        // n_steps = 0 until the first ramp
+    bool ramp_active;                   // Steps left to issue
+    bool ramp_stopped;                  // Cut short by DELETE /api/ramp
+    unsigned int ramp_gen;              // Completions of a replaced ramp are ignored
+
+    unsigned long lost_replies;         // Requests answered with 504, only touched by the event loop
+} plc_device_t;
+
+static struct mg_mgr mgr;
+static plc_device_t devices[MAX_DEVICES];
+static int device_count = 0;
+
+/**
+ * @brief Updates the part of the register mirror covered by a write or read.
+ *
+ * Keeps the mirror consistent with what this server wrote without touching
+ * its timestamp: only a full poll makes the mirror fresh.
+ */
+static void cache_store(plc_device_t *dev, int start, int count, const uint16_t *values) {
+    pthread_mutex_lock(&dev->state_lock);
+    for (int i = 0; i < count; i++) {
+        int r = start + i - POLL_START;
+        if (r >= 0 && r < POLL_COUNT) dev->regs[r] = values[i];
+    }
+    pthread_mutex_unlock(&dev->state_lock);
+}
+
+/**
+ * @brief Adds one sample to a rollup bucket, restarting it if it is stale.
+ */
+static void bucket_add(hist_bucket_t *b, uint32_t t, uint16_t value) {
+    if (b->t != t) {
+        b->t = t;
+        b->min = b->max = value;
+        b->sum = 0;
+        b->count = 0;
+    }
+    if (value < b->min) b->min = value;
+    if (value > b->max) b->max = value;
+    b->sum += value;
+    b->count++;
+}
+
+/**
+ * @brief Records freshly polled registers in the per-second and per-minute rollups.
+ */
+static void history_add(plc_device_t *dev, const uint16_t *regs, time_t now) {
+    uint32_t sec = (uint32_t)now;
+    uint32_t minute = sec - sec % 60;
+
+    pthread_mutex_lock(&dev->hist_lock);
+    for (int r = 0; r < HISTORY_REGISTERS && r < POLL_COUNT; r++) {
+        reg_history_t *h = &dev->history[r];
+        bucket_add(&h->sec[sec % HISTORY_SECONDS], sec, regs[r]);
+        bucket_add(&h->min[(minute / 60) % HISTORY_MINUTES], minute, regs[r]);
+    }
+    pthread_mutex_unlock(&dev->hist_lock);
+}
+
+/**
+ * @brief Copies the filled buckets of [from, to] out of a rollup ring.
+ * @param ring Per-second or per-minute ring.
+ * @param len Number of buckets in the ring.
+ * @param width Bucket width in seconds (1 or 60).
+ * @param out Receives at most len points, oldest first.
+ * @return Number of points copied. Empty buckets (no poll) are skipped.
+ */
+static size_t history_collect(const hist_bucket_t *ring, size_t len, uint32_t width,
+                              uint32_t from, uint32_t to, hist_point_t *out) {
+    size_t n = 0;
+
+    from -= from % width;
+    if ((uint64_t)to - from >= (uint64_t)len * width) from = to - to % width - (uint32_t)(len - 1) * width;
+    for (uint64_t t = from; t <= to; t += width) {
+        const hist_bucket_t *b = &ring[(t / width) % len];
+        if (b->t != t || b->count == 0) continue;
+        out[n].t = b->t;
+        out[n].min = b->min;
+        out[n].max = b->max;
+        out[n].avg = (double)b->sum / b->count;
+        out[n].count = b->count;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Largest-Triangle-Three-Buckets downsampling of the averages.
+ *
+ * Keeps the first and last point and, from each of the points - 2 buckets in
+ * between, the point forming the largest triangle with the previously kept
+ * point and the average of the next bucket. The visual shape of the series
+ * survives with far fewer points; each kept point carries its own min/max.
+ * @return Number of points written to out (at most points).
+ */
+static size_t downsample_lttb(const hist_point_t *in, size_t n, size_t points, hist_point_t *out) {
+    if (n <= points) {
+        memcpy(out, in, n * sizeof(*out));
+        return n;
+    }
+    if (points < 3) {
+        // No bucket in between: just the ends of the range
+        size_t k = 0;
+        if (points == 2) out[k++] = in[0];
+        out[k++] = in[n - 1];
+        return k;
+    }
+
+    double every = (double)(n - 2) / (double)(points - 2);
+    size_t a = 0, k = 0;
+
+    out[k++] = in[0];
+    for (size_t i = 0; i < points - 2; i++) {
+        // Average of the next bucket
+        size_t avg_start = (size_t)((double)(i + 1) * every) + 1;
+        size_t avg_end = (size_t)((double)(i + 2) * every) + 1;
+        if (avg_end > n) avg_end = n;
+        double avg_x = 0, avg_y = 0;
+        for (size_t j = avg_start; j < avg_end; j++) {
+            avg_x += in[j].t;
+            avg_y += in[j].avg;
+        }
+        avg_x /= (double)(avg_end - avg_start);
+        avg_y /= (double)(avg_end - avg_start);
+
+        // Point of the current bucket with the largest triangle
+        size_t range_start = (size_t)((double)i * every) + 1;
+        size_t range_end = (size_t)((double)(i + 1) * every) + 1;
+        double ax = in[a].t, ay = in[a].avg, max_area = -1;
+        size_t next = range_start;
+        for (size_t j = range_start; j < range_end; j++) {
+            double area = (ax - avg_x) * (in[j].avg - ay) - (ax - in[j].t) * (avg_y - ay);
+            if (area < 0) area = -area;
+            if (area > max_area) {
+                max_area = area;
+                next = j;
+            }
+        }
+        out[k++] = in[next];
+        a = next;
+    }
+    out[k++] = in[n - 1];
+    return k;
+}
+
+/**
+ * @brief Min-max decimation: merges the points into at most 'points' bins.
+ *
+ * Each bin keeps the extremes and the sample-weighted average of the points
+ * it covers, so short spikes are never lost.
+ * @return Number of points written to out.
+ */
+static size_t downsample_minmax(const hist_point_t *in, size_t n, size_t points, hist_point_t *out) {
+    if (n <= points) {
+        memcpy(out, in, n * sizeof(*out));
+        return n;
+    }
+    for (size_t b = 0; b < points; b++) {
+        size_t start = b * n / points, end = (b + 1) * n / points;
+        double sum = 0;
 
-// ==== Global State Variables ====
-// These represent the current state of the PLC as seen by the web interface.
-static bool run = false;          // false = STOP, true = RUN
-static bool direction = false;    // false = FWD, true = REV
-static int frequency = 0;         // Frequency in Hz * 100 (for Modbus scaling)
+        out[b] = in[start];
+        out[b].count = 0;
+        for (size_t j = start; j < end; j++) {
+            if (in[j].min < out[b].min) out[b].min = in[j].min;
+            if (in[j].max > out[b].max) out[b].max = in[j].max;
+            sum += in[j].avg * in[j].count;
+            out[b].count += in[j].count;
+        }
+        out[b].avg = sum / out[b].count;
+    }
+    return points;
+}
 
 // ==== Modbus Button Simulation ====
-// Simulates pressing a button by writing 1 then 0 to a Modbus register.
-void push_button(modbus_t *mb, uint8_t reg) {
+// Simulates pressing a button on a Modbus register, in one transaction when
+// the device's pulse mode allows it and as a 1-then-0 write pair otherwise.
+// A device whose PLC rejects the coil is switched to PULSE_TWICE for good.
+// The connection is owned by the calling worker, so no locking is needed.
+// Returns 0 on success, -1 with errno set if a write fails.
+int push_button(plc_device_t *dev, modbus_t *mb, uint8_t reg) {
 #ifndef DEBUG_WEB
-    pthread_mutex_lock(&mb_lock);
-    modbus_write_register(mb, reg, 1);
-    modbus_write_register(mb, reg, 0);
-    pthread_mutex_unlock(&mb_lock);
+    pthread_mutex_lock(&dev->state_lock);
+    pulse_mode_t mode = dev->pulse;
+    pthread_mutex_unlock(&dev->state_lock);
+
+    pulse_mode_t used = mode;
+    int rc = pulse_press(mb, reg, &used);
+    if (used == mode) return rc;
+
+    fprintf(stderr, "[%s] Coil %u rejected, falling back to two writes\n", dev->id, reg);
+    pthread_mutex_lock(&dev->state_lock);
+    dev->pulse = PULSE_TWICE;
+    pthread_mutex_unlock(&dev->state_lock);
+    return rc;
 #else
+    (void)dev;  // Suppress unused parameter warning
     (void)mb;   // Suppress unused parameter warning
     (void)reg;  // Suppress unused parameter warning
 #endif
+    return 0;
 }
 
 /**
  * @brief Toggles the run/stop state of the Modbus device.
+ *
+ * Toggles of one device are serialized by cmd_lock: with a pool of several
+ * workers, two of them would otherwise both read STOP and both press RUN.
+ * @param dev Target device.
  * @param mb Pointer to the Modbus context.
+ * @return 0 on success, -1 with errno set on Modbus failure (state unchanged).
  */
-void run_stop(modbus_t *mb) {
-    run = !run;
-#ifndef DEBUG_WEB
-    if (run) {
-        push_button(mb, 2); // RUN button
-    } else {
-        push_button(mb, 3); // STOP button
+int run_stop(plc_device_t *dev, modbus_t *mb) {
+    pthread_mutex_lock(&dev->cmd_lock);
+    pthread_mutex_lock(&dev->state_lock);
+    bool now_running = !dev->run;
+    pthread_mutex_unlock(&dev->state_lock);
+
+    // RUN button = 2, STOP button = 3
+    if (push_button(dev, mb, now_running ? 2 : 3) == -1) {
+        pthread_mutex_unlock(&dev->cmd_lock);
+        return -1;
     }
-#else
-    (void)mb;  // Suppress unused parameter warning
-#endif
-    printf("Estado cambiado a: %s\n", run ? "RUN" : "STOP");
+
+    pthread_mutex_lock(&dev->state_lock);
+    dev->run = now_running;
+    pthread_mutex_unlock(&dev->state_lock);
+    pthread_mutex_unlock(&dev->cmd_lock);
+    printf("[%s] Estado cambiado a: %s\n", dev->id, now_running ? "RUN" : "STOP");
+    return 0;
 }
 
 /**
  * @brief Toggles the forward/reverse direction of the Modbus device.
+ *
+ * Serialized with the other toggles of the device by cmd_lock, so the
+ * reported direction follows the order in which the button was pressed.
+ * @param dev Target device.
+ * @param mb Pointer to the Modbus context.
+ * @return 0 on success, -1 with errno set on Modbus failure (state unchanged).
+ */
+int fwd_rev(plc_device_t *dev, modbus_t *mb) {
+    pthread_mutex_lock(&dev->cmd_lock);
+    if (push_button(dev, mb, 1) == -1) { // FWD/REV button
+        pthread_mutex_unlock(&dev->cmd_lock);
+        return -1;
+    }
+
+    pthread_mutex_lock(&dev->state_lock);
+    dev->direction = !dev->direction;
+    bool now_reverse = dev->direction;
+    pthread_mutex_unlock(&dev->state_lock);
+    pthread_mutex_unlock(&dev->cmd_lock);
+    printf("[%s] Dirección cambiada a: %s\n", dev->id, now_reverse ? "REV" : "FWD");
+    return 0;
+}
+
+/**
+ * @brief Changes the frequency of the Modbus device.
+ * @param dev Target device.
  * @param mb Pointer to the Modbus context.
+ * @param freq Frequency value to set.
+ * @return 0 on success, -1 with errno set on Modbus failure (state unchanged).
  */
-void fwd_rev(modbus_t *mb) {
-    direction = !direction;
+int cambiar_frecuencia(plc_device_t *dev, modbus_t *mb, int freq) {
+    if (freq < 0 || freq > 60) {
+        errno = EINVAL;
+        return -1;
+    }
 #ifndef DEBUG_WEB
-    push_button(mb, 1); // FWD/REV button
+    if (modbus_write_register(mb, 0, freq * 100) == -1) return -1; // Modbus expects frequency * 100
 #else
     (void)mb;  // Suppress unused parameter warning
 #endif
-    printf("Dirección cambiada a: %s\n", direction ? "REV" : "FWD");
+    uint16_t value = (uint16_t)(freq * 100);
+    cache_store(dev, 0, 1, &value);
+    pthread_mutex_lock(&dev->state_lock);
+    dev->frequency = freq * 100;
+    pthread_mutex_unlock(&dev->state_lock);
+    printf("[%s] Frecuencia cambiada a: %d Hz\n", dev->id, freq);
+    return 0;
 }
 
 /**
- * @brief Changes the frequency of the Modbus device.
+ * @brief Writes a block of holding registers with one FC16 request.
+ * @param dev Target device.
  * @param mb Pointer to the Modbus context.
- * @param freq Frequency value to set.
+ * @param start First register.
+ * @param count Number of registers (1-MODBUS_MAX_WRITE_REGISTERS).
+ * @param values Values to write.
+ * @return 0 on success, -1 with errno set on Modbus failure.
  */
-void cambiar_frecuencia(modbus_t *mb, int freq) {
-    if (freq >= 0 && freq <= 60) {
-        frequency = freq * 100; // Modbus expects frequency * 100
+int write_registers(plc_device_t *dev, modbus_t *mb, int start, int count, const uint16_t *values) {
 #ifndef DEBUG_WEB
-        pthread_mutex_lock(&mb_lock);
-        modbus_write_register(mb, 0, frequency);
-        pthread_mutex_unlock(&mb_lock);
+    if (modbus_write_registers(mb, start, count, values) == -1) return -1;
 #else
-        (void)mb;  // Suppress unused parameter warning
+    (void)mb;  // Suppress unused parameter warning
 #endif
-        printf("Frecuencia cambiada a: %d Hz\n", freq);
+    cache_store(dev, start, count, values);
+    // Register 0 is the frequency setpoint, keep /api/status in step
+    if (start == 0) {
+        pthread_mutex_lock(&dev->state_lock);
+        dev->frequency = values[0];
+        pthread_mutex_unlock(&dev->state_lock);
     }
+    return 0;
 }
 
 /**
  * @brief Retrieves the status of the Modbus device.
- * @param mb Pointer to the Modbus context.
+ * @param dev Target device.
  * @param freq Pointer to store the current frequency.
  * @param run_state Pointer to store the run state.
  * @param dir Pointer to store the direction.
  * @return 0 on success, non-zero on failure.
  */
-int get_status(modbus_t *mb, int *freq, int *run_state, int *dir) {
+int get_status(plc_device_t *dev, int *freq, int *run_state, int *dir) {
     // Return current state (in a real implementation, you might read from Modbus)
-    *freq = frequency / 100;  // Convert back from Modbus scaling
-    *run_state = run ? 1 : 0;
-    *dir = direction ? 1 : 0; // 0 = FWD, 1 = REV
-    
-#ifdef DEBUG_WEB
-    (void)mb;  // Suppress unused parameter warning
-#endif
-    
+    pthread_mutex_lock(&dev->state_lock);
+    *freq = dev->frequency / 100;  // Convert back from Modbus scaling
+    *run_state = dev->run ? 1 : 0;
+    *dir = dev->direction ? 1 : 0; // 0 = FWD, 1 = REV
+    pthread_mutex_unlock(&dev->state_lock);
+
     return 0;
 }
 
 /**
- * @brief HTTP handler for /api/run endpoint.
+ * @brief Adds a device to the registry from an 'id=host[:port][,pool[,pulse[,depth]]]' spec.
+ * @param spec Device specification, typically a command-line argument.
+ * @return 0 on success, -1 if the spec is malformed or the registry is full.
  */
-static void handle_run(struct mg_connection *c) {
-    run_stop(mb);
-    mg_http_reply(c, 200, "Content-Type: application/json\r\n", 
-                 "{\"status\":\"ok\",\"action\":\"run_toggle\",\"state\":\"%s\"}", 
-                 run ? "RUN" : "STOP");
+static int register_device(const char *spec) {
+    const char *eq = strchr(spec, '=');
+    long port = MODBUS_TCP_DEFAULT_PORT;
+    long pool = 1;
+    long depth = 0;
+    pulse_mode_t pulse = PULSE_TWICE;
+    char *end;
+
+    if (device_count >= MAX_DEVICES) {
+        fprintf(stderr, "Too many devices (max %d)\n", MAX_DEVICES);
+        return -1;
+    }
+    if (eq == NULL || eq == spec || (size_t)(eq - spec) >= DEVICE_ID_LEN) {
+        fprintf(stderr, "Invalid device '%s', expected id=host[:port][,pool[,pulse[,depth]]]\n", spec);
+        return -1;
+    }
+
+    const char *host = eq + 1;
+    size_t host_len = strcspn(host, ":,");
+    end = (char *)host + host_len;
+    if (host_len == 0 || host_len >= sizeof(devices[0].ip)) {
+        fprintf(stderr, "Invalid device address in '%s'\n", spec);
+        return -1;
+    }
+    if (*end == ':') port = strtol(end + 1, &end, 10);
+    if (*end == ',') pool = strtol(end + 1, &end, 10);
+    if (*end == ',') {
+        char name[8] = "";
+        size_t len = strcspn(end + 1, ",");
+        if (len < sizeof(name)) memcpy(name, end + 1, len);
+        if (pulse_parse(name, &pulse) == -1) {
+            fprintf(stderr, "Invalid pulse mode in '%s' (twice, auto or coil)\n", spec);
+            return -1;
+        }
+        end += 1 + len;
+    }
+    if (*end == ',') depth = strtol(end + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535 || pool < 1 || pool > MAX_POOL_SIZE) {
+        fprintf(stderr, "Invalid port or pool size in '%s' (pool 1-%d)\n", spec, MAX_POOL_SIZE);
+        return -1;
+    }
+    if (depth < 0 || depth > MBP_MAX_DEPTH) {
+        fprintf(stderr, "Invalid pipeline depth in '%s' (0-%d)\n", spec, MBP_MAX_DEPTH);
+        return -1;
+    }
+
+    plc_device_t *dev = &devices[device_count];
+    memset(dev, 0, sizeof(*dev));
+    dev->index = device_count;
+    memcpy(dev->id, spec, (size_t)(eq - spec));
+    memcpy(dev->ip, host, host_len);
+    dev->port = (int)port;
+    dev->pool_size = (int)pool;
+    dev->pulse = pulse;
+    dev->pipeline_depth = (int)depth;
+    dev->freq_pending = -1;
+    pthread_mutex_init(&dev->job_lock, NULL);
+    pthread_mutex_init(&dev->cmd_lock, NULL);
+    pthread_mutex_init(&dev->state_lock, NULL);
+    pthread_mutex_init(&dev->hist_lock, NULL);
+    dev->history = calloc(HISTORY_REGISTERS, sizeof(reg_history_t));
+    if (dev->history == NULL) {
+        fprintf(stderr, "[%s] Failed to allocate history\n", dev->id);
+        return -1;
+    }
+
+    // Reconnect deadlines are monotonic, so the condition variable must be too
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&dev->job_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    for (int i = 0; i < pool; i++) {
+        dev->pool[i].dev = dev;
+        dev->pool[i].backoff_ms = BACKOFF_MIN_MS;
+        dev->pool[i].seed = (unsigned int)(device_count * MAX_POOL_SIZE + i) ^ (unsigned int)time(NULL);
+    }
+
+    device_count++;
+    return 0;
 }
 
 /**
- * @brief HTTP handler for /api/dir endpoint.
+ * @brief Looks up the device addressed by a request's '?dev=' parameter.
+ * @return The device, the default one if no id is given, or NULL if unknown.
  */
-static void handle_dir(struct mg_connection *c) {
-    fwd_rev(mb);
-    mg_http_reply(c, 200, "Content-Type: application/json\r\n", 
-                 "{\"status\":\"ok\",\"action\":\"dir_toggle\",\"direction\":\"%s\"}", 
-                 direction ? "REV" : "FWD");
+static plc_device_t *find_device(struct mg_http_message *hm) {
+    char id[DEVICE_ID_LEN];
+
+    if (mg_http_get_var(&hm->query, "dev", id, sizeof(id)) <= 0) {
+        return &devices[0];
+    }
+    for (int i = 0; i < device_count; i++) {
+        if (strcmp(devices[i].id, id) == 0) return &devices[i];
+    }
+    return NULL;
 }
 
+#ifndef DEBUG_WEB
 /**
- * @brief HTTP handler for /api/freq endpoint.
+ * @brief Allocates the libmodbus contexts of a device's connection pool,
+ *        plus its pipelined client if the device has a pipeline depth.
+ *
+ * No connection is opened here; each worker connects its own context and the
+ * pipelined client connects on its first read, so an unreachable PLC does
+ * not prevent the server from starting.
+ * @return 0 on success, -1 if a context could not be allocated.
  */
-static void handle_freq(struct mg_connection *c, struct mg_http_message *hm) {
-    char freq_str[32];
-    
-    if (mg_http_get_var(&hm->body, "freq", freq_str, sizeof(freq_str)) > 0) {
-        int freq = atoi(freq_str);
-        if (freq >= 0 && freq <= 60) {
-            cambiar_frecuencia(mb, freq);
-            mg_http_reply(c, 200, "Content-Type: application/json\r\n", 
-                         "{\"status\":\"ok\",\"action\":\"freq_set\",\"frequency\":%d}", freq);
-        } else {
-            mg_http_reply(c, 400, "Content-Type: application/json\r\n", 
-                         "{\"status\":\"error\",\"message\":\"Invalid frequency range (0-60 Hz)\"}");
+static int create_device_pool(plc_device_t *dev) {
+    for (int i = 0; i < dev->pool_size; i++) {
+        modbus_t *mb = modbus_new_tcp(dev->ip, dev->port);
+        if (mb == NULL) {
+            fprintf(stderr, "[%s] Failed to allocate libmodbus context\n", dev->id);
+            return -1;
+        }
+        modbus_set_response_timeout(mb, MODBUS_TIMEOUT_MS / 1000, (MODBUS_TIMEOUT_MS % 1000) * 1000);
+        dev->pool[i].mb = mb;
+    }
+    if (dev->pipeline_depth > 0) {
+        dev->pipe = mbp_create(&mgr, dev->ip, dev->port, MODBUS_TCP_SLAVE,
+                               dev->pipeline_depth, MODBUS_TIMEOUT_MS);
+        if (dev->pipe == NULL) {
+            fprintf(stderr, "[%s] Failed to create pipelined client\n", dev->id);
+            return -1;
         }
-    } else {
-        mg_http_reply(c, 400, "Content-Type: application/json\r\n", 
-                     "{\"status\":\"error\",\"message\":\"Missing freq parameter\"}");
     }
+    return 0;
 }
+#endif
 
 /**
- * @brief HTTP handler for /api/status endpoint.
+ * @brief Tells whether a libmodbus failure means the link must be re-established.
+ *
+ * Exception responses prove the PLC is alive and keep the connection; socket
+ * errors, timeouts and framing errors drop it.
  */
-static void handle_status(struct mg_connection *c) {
-    int freq, run_state, dir;
-    
-    if (get_status(mb, &freq, &run_state, &dir) == 0) {
-        mg_http_reply(c, 200, "Content-Type: application/json\r\n", 
-                     "{\"frequency\":%d,\"running\":%s,\"direction\":\"%s\",\"state\":\"%s\"}", 
-                     freq, 
-                     run_state ? "true" : "false", 
-                     dir ? "REV" : "FWD",
-                     run_state ? "RUN" : "STOP");
-    } else {
-        mg_http_reply(c, 500, "Content-Type: application/json\r\n", 
-                     "{\"status\":\"error\",\"message\":\"Failed to read device status\"}");
-    }
+static bool is_link_error(int err) {
+    return !(err > MODBUS_ENOBASE && err < MODBUS_ENOBASE + MODBUS_EXCEPTION_MAX);
 }
 
 /**
- * @brief Mongoose event handler and HTTP dispatcher.
+ * @brief Schedules the next reconnect attempt with jittered exponential backoff.
+ *
+ * The delay is drawn uniformly from [backoff/2, backoff] so that several
+ * connections to a rebooting PLC do not reconnect in lockstep. Caller holds
+ * the device job_lock.
  */
-static void fn(struct mg_connection *c, int ev, void *ev_data) {
-    if (ev == MG_EV_HTTP_MSG) {
-        struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+static void schedule_reconnect(plc_conn_t *conn) {
+    uint32_t half = conn->backoff_ms / 2;
+    uint32_t delay = half + (uint32_t)rand_r(&conn->seed) % (half + 1);
 
-        if (mg_match(hm->uri, mg_str("/api/run"), NULL)) {
-            handle_run(c);
-        } else if (mg_match(hm->uri, mg_str("/api/dir"), NULL)) {
-            handle_dir(c);
-        } else if (mg_match(hm->uri, mg_str("/api/freq"), NULL)) {
-            handle_freq(c, hm);
-        } else if (mg_match(hm->uri, mg_str("/api/status"), NULL)) {
-            handle_status(c);
-        } else {
-            struct mg_http_serve_opts opts = {.root_dir = "www"};
-            mg_http_serve_dir(c, hm, &opts);
-        }
-    }
+    conn->next_attempt_ms = mg_millis() + delay;
+    conn->backoff_ms = conn->backoff_ms * 2 > BACKOFF_MAX_MS ? BACKOFF_MAX_MS : conn->backoff_ms * 2;
 }
 
 /**
- * @brief Main entry point. Initializes Modbus and HTTP server.
+ * @brief Marks a connection as up after a successful connect.
  */
-int main(void) {
-    struct mg_mgr mgr;
-    mg_mgr_init(&mgr);
+static void link_up(plc_conn_t *conn) {
+    plc_device_t *dev = conn->dev;
 
+    pthread_mutex_lock(&dev->job_lock);
+    conn->connected = true;
+    conn->backoff_ms = BACKOFF_MIN_MS;
+    conn->next_probe_ms = mg_millis() + HEALTH_PROBE_MS;
+    int up = ++dev->conns_up;
+    if (conn->was_up) dev->reconnects++;
+    conn->was_up = true;
+    pthread_mutex_unlock(&dev->job_lock);
+
+    printf("[%s] Connected to Modbus server %s:%d (%d/%d)\n",
+           dev->id, dev->ip, dev->port, up, dev->pool_size);
+}
+
+/**
+ * @brief Records a link failure and schedules a reconnect.
+ * @param conn Connection that failed.
+ * @param err errno of the failure.
+ */
+static void link_down(plc_conn_t *conn, int err) {
+    plc_device_t *dev = conn->dev;
+
+    modbus_close(conn->mb);
+
+    pthread_mutex_lock(&dev->job_lock);
+    if (conn->connected) {
+        conn->connected = false;
+        dev->conns_up--;
+        fprintf(stderr, "[%s] Link lost: %s\n", dev->id, modbus_strerror(err));
+    }
+    snprintf(dev->last_error, sizeof(dev->last_error), "%s", modbus_strerror(err));
+    schedule_reconnect(conn);
+    pthread_mutex_unlock(&dev->job_lock);
+}
+
+/**
+ * @brief Attempts to (re)open a pooled connection.
+ * @param conn Connection to open.
+ */
+static void try_connect(plc_conn_t *conn) {
 #ifndef DEBUG_WEB
-    // Initialize Modbus TCP connection
-    mb = modbus_new_tcp(SERVER_IP, MODBUS_TCP_DEFAULT_PORT);
-    if (mb == NULL) {
-        fprintf(stderr, "Failed to allocate libmodbus context\n");
-        return -1;
+    if (modbus_connect(conn->mb) == -1) {
+        link_down(conn, errno);
+        return;
     }
-    if (modbus_connect(mb) == -1) {
-        fprintf(stderr, "Connection failed: %s\n", modbus_strerror(errno));
-        modbus_free(mb);
-        return -1;
-    } else {
-        printf("Connected to Modbus server %s successfully\n", SERVER_IP);
+#endif
+    link_up(conn);
+}
+
+/**
+ * @brief Reads one register to check that an idle connection is still alive.
+ */
+static void probe_link(plc_conn_t *conn) {
+#ifndef DEBUG_WEB
+    uint16_t value;
+    if (modbus_read_registers(conn->mb, PROBE_REGISTER, 1, &value) == -1 && is_link_error(errno)) {
+        link_down(conn, errno);
+        return;
     }
-#else
-    printf("Running in DEBUG mode - no real Modbus communication\n");
 #endif
+    pthread_mutex_lock(&conn->dev->job_lock);
+    conn->next_probe_ms = mg_millis() + HEALTH_PROBE_MS;
+    pthread_mutex_unlock(&conn->dev->job_lock);
+}
+
+/**
+ * @brief Refreshes the register mirror of a device with one FC03 request.
+ *
+ * A successful poll also proves the link, so it postpones the idle probe of
+ * the connection that performed it.
+ */
+static void poll_registers(plc_conn_t *conn) {
+    plc_device_t *dev = conn->dev;
+    uint16_t regs[POLL_COUNT];
 
-    // Levantar servidor HTTP en puerto 8000
-    if (mg_http_listen(&mgr, "http://0.0.0.0:8000", fn, NULL) == NULL) {
-        fprintf(stderr, "Error iniciando servidor web\n");
 #ifndef DEBUG_WEB
-        modbus_close(mb);
-        modbus_free(mb);
+    if (modbus_read_registers(conn->mb, POLL_START, POLL_COUNT, regs) == -1) {
+        if (is_link_error(errno)) link_down(conn, errno);
+        return;
+    }
+#else
+    pthread_mutex_lock(&dev->state_lock);
+    memcpy(regs, dev->regs, sizeof(regs));
+    pthread_mutex_unlock(&dev->state_lock);
 #endif
-        return 1;
+    pthread_mutex_lock(&dev->state_lock);
+    memcpy(dev->regs, regs, sizeof(regs));
+    dev->regs_ms = mg_millis();
+    pthread_mutex_unlock(&dev->state_lock);
+    history_add(dev, regs, time(NULL));
+
+    pthread_mutex_lock(&dev->job_lock);
+    conn->next_probe_ms = mg_millis() + HEALTH_PROBE_MS;
+    pthread_mutex_unlock(&dev->job_lock);
+}
+
+/**
+ * @brief Waits on the device condition variable until a monotonic deadline.
+ */
+static void wait_until(plc_device_t *dev, uint64_t deadline_ms) {
+    struct timespec now, ts;
+    uint64_t now_ms = mg_millis();
+    uint64_t delay_ms = deadline_ms > now_ms ? deadline_ms - now_ms : 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ts.tv_sec = now.tv_sec + (time_t)(delay_ms / 1000);
+    ts.tv_nsec = now.tv_nsec + (long)(delay_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
     }
+    pthread_cond_timedwait(&dev->job_cond, &dev->job_lock, &ts);
+}
 
-    printf("Servidor web corriendo en http://localhost:8000\n");
-    printf("Presiona Ctrl+C para salir\n");
+typedef enum {
+    ENQ_OK,
+    ENQ_FULL,
+    ENQ_OFFLINE
+} enqueue_rc_t;
 
-    // Event loop
-    for (;;) {
-        mg_mgr_poll(&mgr, 1000);
+/**
+ * @brief Longest a request may wait for its result on a slow but healthy link.
+ *
+ * Every job ahead of it, and the request itself, may take JOB_MAX_TRANSACTIONS
+ * timeouts, plus one for the poll or setpoint write that can go first.
+ * @param ahead Jobs queued before the request.
+ */
+static uint32_t reply_timeout_ms(size_t ahead) {
+    return (uint32_t)(ahead + 1) * (JOB_MAX_TRANSACTIONS + 1) * MODBUS_TIMEOUT_MS + REPLY_SLACK_MS;
+}
+
+/**
+ * @brief Arms the reply deadline of a request handed to a worker.
+ * @param ahead Jobs the request has to wait for.
+ */
+static void await_result(struct mg_connection *c, plc_device_t *dev, size_t ahead) {
+    pending_reply_t *p = (pending_reply_t *) c->data;
+    p->timeout_ms = reply_timeout_ms(ahead);
+    p->deadline_ms = mg_millis() + p->timeout_ms;
+    p->dev = dev->index;
+}
+
+/**
+ * @brief Queues a Modbus job on a device for its workers.
+ * @param dev Target device.
+ * @param c Connection that will receive the reply once the job completes.
+ * @param job Operation and its arguments; conn_id is filled in here.
+ * @return ENQ_OK if queued, ENQ_FULL if the queue is full, ENQ_OFFLINE if the
+ *         device has no live connection.
+ */
+static enqueue_rc_t enqueue_job(plc_device_t *dev, struct mg_connection *c, const mb_job_t *job) {
+    enqueue_rc_t rc = ENQ_OK;
+
+    pthread_mutex_lock(&dev->job_lock);
+    if (dev->conns_up == 0) {
+        rc = ENQ_OFFLINE;
+    } else if (dev->job_count >= JOB_QUEUE_LEN) {
+        rc = ENQ_FULL;
+    } else {
+        mb_job_t *slot = &dev->jobs[(dev->job_head + dev->job_count) % JOB_QUEUE_LEN];
+        *slot = *job;
+        slot->conn_id = c->id;
+        await_result(c, dev, dev->job_count);
+        dev->job_count++;
+        // Wake every worker: a disconnected one must not swallow the signal
+        pthread_cond_broadcast(&dev->job_cond);
     }
+    pthread_mutex_unlock(&dev->job_lock);
 
-    // Cleanup (nunca se alcanza con el loop infinito, pero está para completitud)
-#ifndef DEBUG_WEB
-    modbus_close(mb);
-    modbus_free(mb);
-#endif
-    mg_mgr_free(&mgr);
-    return 0;
-}
\ No newline at end of file
+    return rc;
+}
+
+/**
+ * @brief Stores a frequency setpoint in the device's pending slot.
+ *
+ * A setpoint that is still pending is overwritten (last writer wins); the
+ * request joins the waiters that are all answered by the next write.
+ * @return ENQ_OK if stored, ENQ_FULL if too many requests are waiting,
+ *         ENQ_OFFLINE if the device has no live connection.
+ */
+static enqueue_rc_t enqueue_freq(plc_device_t *dev, struct mg_connection *c, int freq) {
+    enqueue_rc_t rc = ENQ_OK;
+
+    pthread_mutex_lock(&dev->job_lock);
+    if (dev->conns_up == 0) {
+        rc = ENQ_OFFLINE;
+    } else if (dev->freq_waiter_count >= FREQ_WAITERS) {
+        rc = ENQ_FULL;
+    } else {
+        dev->freq_pending = freq;
+        dev->freq_waiters[dev->freq_waiter_count].conn_id = c->id;
+        dev->freq_waiters[dev->freq_waiter_count].requested = freq;
+        dev->freq_waiter_count++;
+        // The setpoint goes ahead of queued jobs: it only waits for a job in
+        // progress, or for the previous setpoint write
+        await_result(c, dev, 1);
+        pthread_cond_broadcast(&dev->job_cond);
+    }
+    pthread_mutex_unlock(&dev->job_lock);
+
+    return rc;
+}
+
+/**
+ * @brief Withdraws the queued job or pending setpoint of a request that was
+ *        answered with 504, so it never reaches the PLC.
+ *
+ * Every setpoint waiter gets the same timeout, so waiters expire in the order
+ * they arrived and the pending value is dropped with the last one. A job a
+ * worker has already taken can no longer be withdrawn.
+ * @return true if the request was withdrawn.
+ */
+static bool cancel_request(plc_device_t *dev, unsigned long conn_id) {
+    bool found = false;
+    size_t kept = 0;
+    int waiters = 0;
+
+    pthread_mutex_lock(&dev->job_lock);
+    for (size_t i = 0; i < dev->job_count; i++) {
+        const mb_job_t *job = &dev->jobs[(dev->job_head + i) % JOB_QUEUE_LEN];
+        if (job->conn_id == conn_id) {
+            found = true;
+        } else {
+            if (kept != i) dev->jobs[(dev->job_head + kept) % JOB_QUEUE_LEN] = *job;
+            kept++;
+        }
+    }
+    dev->job_count = kept;
+
+    for (int i = 0; i < dev->freq_waiter_count; i++) {
+        if (dev->freq_waiters[i].conn_id == conn_id) {
+            found = true;
+        } else {
+            dev->freq_waiters[waiters++] = dev->freq_waiters[i];
+        }
+    }
+    dev->freq_waiter_count = waiters;
+    if (waiters == 0) dev->freq_pending = -1;
+    pthread_mutex_unlock(&dev->job_lock);
+
+    return found;
+}
+
+/**
+ * @brief Pops the next job, merging queued register reads into one request.
+ *
+ * Consecutive JOB_READ_REGS jobs at the head of the queue are taken together
+ * as long as their combined span fits in one FC03 request. Merging stops at
+ * the first other job, so a read never overtakes an earlier write. Caller
+ * holds the device job_lock and has checked that the queue is not empty.
+ * @param dev Device whose queue is consumed.
+ * @param batch Receives the popped jobs.
+ * @return Number of jobs stored in batch.
+ */
+static size_t take_jobs(plc_device_t *dev, mb_job_t *batch) {
+    size_t n = 0;
+    int lo = 0, hi = 0;
+
+    while (dev->job_count > 0) {
+        const mb_job_t *job = &dev->jobs[dev->job_head];
+        if (n > 0) {
+            if (batch[0].op != JOB_READ_REGS || job->op != JOB_READ_REGS) break;
+            int new_lo = MIN(lo, job->start);
+            int new_hi = MAX(hi, job->start + job->count);
+            if (new_hi - new_lo > MODBUS_MAX_READ_REGISTERS) break;
+            lo = new_lo;
+            hi = new_hi;
+        } else {
+            lo = job->start;
+            hi = job->start + job->count;
+        }
+        batch[n++] = *job;
+        dev->job_head = (dev->job_head + 1) % JOB_QUEUE_LEN;
+        dev->job_count--;
+    }
+    return n;
+}
+
+/**
+ * @brief Completes a job: snapshots the drive state into its result and
+ *        hands it back to the event loop.
+ */
+static void finish_job(plc_device_t *dev, unsigned long conn_id, mb_result_t *res) {
+    pthread_mutex_lock(&dev->state_lock);
+    if (res->rc == 0) dev->last_cmd_us = res->latency_us;
+    res->run = dev->run;
+    res->direction = dev->direction;
+    res->freq = dev->frequency / 100;
+    pthread_mutex_unlock(&dev->state_lock);
+
+    // If the client went away meanwhile, Mongoose silently drops this. A
+    // datagram lost in a full socketpair is not reported either: the reply
+    // deadline answers that request
+    mg_wakeup(&mgr, conn_id, res, sizeof(*res));
+}
+
+/**
+ * @brief Postpones the idle probe after a successful transaction.
+ */
+static void job_succeeded(plc_conn_t *conn) {
+    pthread_mutex_lock(&conn->dev->job_lock);
+    conn->next_probe_ms = mg_millis() + HEALTH_PROBE_MS;
+    pthread_mutex_unlock(&conn->dev->job_lock);
+}
+
+/**
+ * @brief Serves a batch of register reads with a single FC03 request.
+ * @param conn Connection of the calling worker.
+ * @param batch Read jobs returned by take_jobs().
+ * @param n Number of jobs in the batch.
+ * @param connected Whether the connection was up when the jobs were taken.
+ */
+static void execute_reads(plc_conn_t *conn, const mb_job_t *batch, size_t n, bool connected) {
+    plc_device_t *dev = conn->dev;
+    uint16_t regs[MODBUS_MAX_READ_REGISTERS] = { 0 };
+    int lo = batch[0].start, hi = batch[0].start + batch[0].count;
+    int rc = -1, err = 0;
+    long latency_us = 0;
+
+    for (size_t i = 1; i < n; i++) {
+        lo = MIN(lo, batch[i].start);
+        hi = MAX(hi, batch[i].start + batch[i].count);
+    }
+
+    if (connected) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+#ifndef DEBUG_WEB
+        rc = modbus_read_registers(conn->mb, lo, hi - lo, regs) == -1 ? -1 : 0;
+#else
+        pthread_mutex_lock(&dev->state_lock);
+        for (int r = lo; r < hi; r++) {
+            if (r >= POLL_START && r < POLL_START + POLL_COUNT) regs[r - lo] = dev->regs[r - POLL_START];
+        }
+        pthread_mutex_unlock(&dev->state_lock);
+        rc = 0;
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        latency_us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000L;
+        if (rc == -1) {
+            err = errno;
+            if (is_link_error(err)) link_down(conn, err);
+        } else {
+            job_succeeded(conn);
+            cache_store(dev, lo, hi - lo, regs);
+        }
+    }
+    if (n > 1) printf("[%s] %zu register reads served by one FC03 (%d..%d)\n", dev->id, n, lo, hi - 1);
+
+    for (size_t i = 0; i < n; i++) {
+        mb_result_t res = {
+            .dev = dev->index, .op = JOB_READ_REGS, .rc = rc, .err = err,
+            .latency_us = latency_us, .start = batch[i].start,
+            .count = batch[i].count, .binary = batch[i].binary
+        };
+        memcpy(res.regs, &regs[batch[i].start - lo], batch[i].count * sizeof(uint16_t));
+        finish_job(dev, batch[i].conn_id, &res);
+    }
+}
+
+/**
+ * @brief Executes a drive command or register write job.
+ * @param conn Connection of the calling worker.
+ * @param job Job to execute.
+ * @param connected Whether the connection was up when the job was taken.
+ */
+static void execute_job(plc_conn_t *conn, const mb_job_t *job, bool connected) {
+    plc_device_t *dev = conn->dev;
+    mb_result_t res = {
+        .dev = dev->index, .op = job->op, .rc = -1, .err = 0,
+        .start = job->start, .count = job->count
+    };
+
+    if (connected) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        switch (job->op) {
+            case JOB_RUN_TOGGLE: res.rc = run_stop(dev, conn->mb); break;
+            case JOB_DIR_TOGGLE: res.rc = fwd_rev(dev, conn->mb); break;
+            case JOB_WRITE_REGS: res.rc = write_registers(dev, conn->mb, job->start, job->count, job->values); break;
+            case JOB_FREQ_SET:   break;  // Handled by flush_freq()
+            case JOB_READ_REGS:  break;  // Handled by execute_reads()
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        res.latency_us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000L;
+        if (res.rc == -1) {
+            res.err = errno;
+            if (is_link_error(res.err)) link_down(conn, res.err);
+        } else {
+            job_succeeded(conn);
+        }
+    }
+    finish_job(dev, job->conn_id, &res);
+}
+
+/**
+ * @brief Writes the newest pending frequency and answers every waiting request.
+ *
+ * The caller has moved the pending setpoint and its waiters out of the device
+ * and set freq_inflight, so only one setpoint per device is on the wire and
+ * an older value can never land after a newer one.
+ * @param conn Connection of the calling worker.
+ * @param freq Setpoint to write, in Hz.
+ * @param waiters Requests to answer with the applied value.
+ * @param n Number of waiters.
+ * @param connected Whether the connection was up when the setpoint was taken.
+ */
+static void flush_freq(plc_conn_t *conn, int freq, const freq_waiter_t *waiters, int n, bool connected) {
+    plc_device_t *dev = conn->dev;
+    mb_result_t res = { .dev = dev->index, .op = JOB_FREQ_SET, .rc = -1, .err = 0, .coalesced = n };
+
+    if (connected) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        res.rc = cambiar_frecuencia(dev, conn->mb, freq);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        res.latency_us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000L;
+        if (res.rc == -1) {
+            res.err = errno;
+            if (is_link_error(res.err)) link_down(conn, res.err);
+        } else {
+            job_succeeded(conn);
+        }
+    }
+    if (n > 1) printf("[%s] %d frequency requests coalesced into one write (%d Hz)\n", dev->id, n, freq);
+
+    // Answer before releasing the slot, so the reported frequency is this write's
+    for (int i = 0; i < n; i++) {
+        res.requested = waiters[i].requested;
+        finish_job(dev, waiters[i].conn_id, &res);
+    }
+
+    pthread_mutex_lock(&dev->job_lock);
+    dev->freq_inflight = false;
+    // A newer setpoint may be waiting for this write to finish
+    pthread_cond_broadcast(&dev->job_cond);
+    pthread_mutex_unlock(&dev->job_lock);
+}
+
+/**
+ * @brief Worker thread that owns one pooled connection of a device.
+ *
+ * While connected, pops jobs from the device queue in FIFO order, executes
+ * them and posts the result back to the originating connection with
+ * mg_wakeup(). Every POLL_INTERVAL_MS one worker (whichever is free first)
+ * refreshes the device's register mirror ahead of queued jobs, and idle
+ * connections are probed every HEALTH_PROBE_MS. While disconnected, reconnects
+ * on the backoff schedule and fails queued jobs at once if no other
+ * connection of the device is up to take them.
+ */
+static void *modbus_worker(void *arg) {
+    plc_conn_t *conn = (plc_conn_t *)arg;
+    plc_device_t *dev = conn->dev;
+    mb_job_t batch[JOB_QUEUE_LEN];
+    freq_waiter_t waiters[FREQ_WAITERS];
+
+    try_connect(conn);
+
+    for (;;) {
+        size_t n = 0;
+        int nwaiters = 0, freq = 0;
+        bool poll = false;
+
+        pthread_mutex_lock(&dev->job_lock);
+        for (;;) {
+            uint64_t now = mg_millis();
+            // A due poll goes first, or a busy queue would let the mirror go stale
+            if (conn->connected && now >= dev->next_poll_ms) {
+                dev->next_poll_ms = now + POLL_INTERVAL_MS;
+                poll = true;
+                break;
+            }
+            // The newest setpoint goes ahead of queued jobs, at most every FREQ_FLUSH_MS
+            bool freq_ready = dev->freq_pending >= 0 && !dev->freq_inflight;
+            if (freq_ready && (conn->connected ? now >= dev->next_freq_ms : dev->conns_up == 0)) {
+                freq = dev->freq_pending;
+                nwaiters = dev->freq_waiter_count;
+                memcpy(waiters, dev->freq_waiters, (size_t)nwaiters * sizeof(waiters[0]));
+                dev->freq_pending = -1;
+                dev->freq_waiter_count = 0;
+                dev->freq_inflight = true;
+                dev->next_freq_ms = now + FREQ_FLUSH_MS;
+                break;
+            }
+            if (dev->job_count > 0 && (conn->connected || dev->conns_up == 0)) {
+                n = take_jobs(dev, batch);
+                break;
+            }
+            if (!conn->connected && now >= conn->next_attempt_ms) break;
+            if (conn->connected && now >= conn->next_probe_ms) break;
+            uint64_t deadline = MIN(conn->next_probe_ms, dev->next_poll_ms);
+            if (freq_ready) deadline = MIN(deadline, dev->next_freq_ms);
+            wait_until(dev, conn->connected ? deadline : conn->next_attempt_ms);
+        }
+        bool connected = conn->connected;
+        pthread_mutex_unlock(&dev->job_lock);
+
+        if (nwaiters > 0) {
+            flush_freq(conn, freq, waiters, nwaiters, connected);
+        } else if (n == 0) {
+            if (poll) {
+                poll_registers(conn);
+            } else if (connected) {
+                probe_link(conn);
+            } else {
+                try_connect(conn);
+            }
+        } else if (batch[0].op == JOB_READ_REGS) {
+            execute_reads(conn, batch, n, connected);
+        } else {
+            execute_job(conn, &batch[0], connected);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Milliseconds until the earliest reconnect attempt of a device.
+ *
+ * Caller holds the device job_lock.
+ */
+static uint64_t retry_in_ms(const plc_device_t *dev) {
+    uint64_t now = mg_millis();
+    uint64_t next = UINT64_MAX;
+
+    for (int i = 0; i < dev->pool_size; i++) {
+        if (!dev->pool[i].connected && dev->pool[i].next_attempt_ms < next) {
+            next = dev->pool[i].next_attempt_ms;
+        }
+    }
+    if (next == UINT64_MAX) return 0;
+    return next > now ? next - now : 0;
+}
+
+/**
+ * @brief Replies 503 immediately for a device without a live connection.
+ */
+static void reply_offline(struct mg_connection *c, plc_device_t *dev) {
+    pthread_mutex_lock(&dev->job_lock);
+    uint64_t retry = retry_in_ms(dev);
+    pthread_mutex_unlock(&dev->job_lock);
+
+    mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                 "{\"status\":\"error\",\"device\":%m,\"message\":\"PLC offline\",\"retry_in_ms\":%llu}",
+                 MG_ESC(dev->id), (unsigned long long)retry);
+}
+
+/**
+ * @brief Replies 503 when a device's worker queue is saturated.
+ */
+static void reply_busy(struct mg_connection *c, const plc_device_t *dev) {
+    mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                 "{\"status\":\"error\",\"device\":%m,\"message\":\"Modbus queue full\"}",
+                 MG_ESC(dev->id));
+}
+
+/**
+ * @brief Queues a job and answers right away if that is not possible.
+ */
+static void submit_job(struct mg_connection *c, plc_device_t *dev, const mb_job_t *job) {
+    switch (enqueue_job(dev, c, job)) {
+        case ENQ_OK:      break;
+        case ENQ_FULL:    reply_busy(c, dev); break;
+        case ENQ_OFFLINE: reply_offline(c, dev); break;
+    }
+}
+
+/**
+ * @brief HTTP handler for /api/run endpoint.
+ */
+static void handle_run(struct mg_connection *c, plc_device_t *dev) {
+    mb_job_t job = { .op = JOB_RUN_TOGGLE };
+    submit_job(c, dev, &job);
+}
+
+/**
+ * @brief HTTP handler for /api/dir endpoint.
+ */
+static void handle_dir(struct mg_connection *c, plc_device_t *dev) {
+    mb_job_t job = { .op = JOB_DIR_TOGGLE };
+    submit_job(c, dev, &job);
+}
+
+/**
+ * @brief Logs the timing report of a ramp once its last write has completed.
+ */
+static void log_ramp_end(const plc_device_t *dev) {
+    char report[256];
+
+    if (!ramp_finished(&dev->ramp)) return;
+    ramp_format(&dev->ramp, report, sizeof(report));
+    printf("[%s] Rampa %s: %s\n", dev->id, dev->ramp_stopped ? "detenida" : "terminada", report);
+}
+
+/**
+ * @brief Issues no more steps of the device's ramp, if one is running.
+ *
+ * Writes already sent still complete; the ramp then reports "stopped".
+ */
+static void stop_ramp(plc_device_t *dev) {
+    if (!dev->ramp_active) return;
+    ramp_stop(&dev->ramp);
+    dev->ramp_active = false;
+    dev->ramp_stopped = true;
+    log_ramp_end(dev);
+}
+
+/**
+ * @brief HTTP handler for /api/freq endpoint.
+ *
+ * A manual setpoint stops a running ramp, which would overwrite it on its
+ * next step.
+ */
+static void handle_freq(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    char freq_str[32];
+
+    if (mg_http_get_var(&hm->body, "freq", freq_str, sizeof(freq_str)) > 0) {
+        int freq = atoi(freq_str);
+        if (freq >= 0 && freq <= 60) {
+            switch (enqueue_freq(dev, c, freq)) {
+                case ENQ_OK:      stop_ramp(dev); break;
+                case ENQ_FULL:    reply_busy(c, dev); break;
+                case ENQ_OFFLINE: reply_offline(c, dev); break;
+            }
+        } else {
+            mg_http_reply(c, 400, "Content-Type: application/json\r\n",
+                         "{\"status\":\"error\",\"message\":\"Invalid frequency range (0-60 Hz)\"}");
+        }
+    } else {
+        mg_http_reply(c, 400, "Content-Type: application/json\r\n",
+                     "{\"status\":\"error\",\"message\":\"Missing freq parameter\"}");
+    }
+}
+
+/**
+ * @brief Prints a block of registers as comma-separated numbers (mg_print_func_t).
+ */
+static size_t print_registers(void (*out)(char, void *), void *ptr, va_list *ap) {
+    int count = va_arg(*ap, int);
+    const uint16_t *regs = va_arg(*ap, const uint16_t *);
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        n += mg_xprintf(out, ptr, "%s%u", i == 0 ? "" : ",", (unsigned)regs[i]);
+    }
+    return n;
+}
+
+/**
+ * @brief Sends a block of registers as JSON or as raw big-endian words.
+ * @param source "cache" if served from the poller mirror, "device" otherwise.
+ * @param age_ms Age of the data in milliseconds.
+ */
+static void reply_registers(struct mg_connection *c, const plc_device_t *dev, int start, int count,
+                            const uint16_t *regs, bool binary, const char *source, uint64_t age_ms) {
+    if (binary) {
+        uint8_t buf[MODBUS_MAX_READ_REGISTERS * 2];
+        for (int i = 0; i < count; i++) {
+            buf[2 * i] = (uint8_t)(regs[i] >> 8);
+            buf[2 * i + 1] = (uint8_t)(regs[i] & 0xFF);
+        }
+        mg_printf(c, "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/octet-stream\r\n"
+                     "X-Register-Start: %d\r\n"
+                     "X-Register-Source: %s\r\n"
+                     "X-Register-Age-Ms: %llu\r\n"
+                     "Content-Length: %d\r\n\r\n",
+                  start, source, (unsigned long long)age_ms, count * 2);
+        mg_send(c, buf, (size_t)count * 2);
+        c->is_resp = 0;
+    } else {
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                     "{\"device\":%m,\"start\":%d,\"count\":%d,\"source\":\"%s\",\"age_ms\":%llu,\"values\":[%M]}",
+                     MG_ESC(dev->id), start, count, source, (unsigned long long)age_ms,
+                     print_registers, count, regs);
+    }
+}
+
+/**
+ * @brief Reads an integer request variable and checks its range.
+ * @return true if the variable is present, numeric and within [min, max].
+ */
+static bool get_int_var(const struct mg_str *buf, const char *name, long min, long max, long *out) {
+    char str[16];
+    char *end;
+
+    if (mg_http_get_var(buf, name, str, sizeof(str)) <= 0) return false;
+    *out = strtol(str, &end, 10);
+    return *end == '\0' && *out >= min && *out <= max;
+}
+
+static void reply_bad_request(struct mg_connection *c, const char *message) {
+    mg_http_reply(c, 400, "Content-Type: application/json\r\n",
+                 "{\"status\":\"error\",\"message\":%m}", MG_ESC(message));
+}
+
+// A register read waiting on the pipelined connection
+typedef struct {
+    unsigned long conn_id;
+    int dev;
+    int start;
+    bool binary;
+} pipe_read_t;
+
+/**
+ * @brief Completion of a pipelined read (mbp_done_t), runs on the event loop.
+ */
+static void pipe_read_done(mbp_client_t *cli, int err, const uint16_t *regs, int count, void *userdata) {
+    pipe_read_t *rd = (pipe_read_t *)userdata;
+    plc_device_t *dev = &devices[rd->dev];
+    struct mg_connection *c;
+    (void)cli;
+
+    if (err == 0) cache_store(dev, rd->start, count, regs);
+    for (c = mgr.conns; c != NULL && c->id != rd->conn_id; c = c->next) continue;
+    if (c != NULL) {
+        if (err == 0) {
+            reply_registers(c, dev, rd->start, count, regs, rd->binary, "device", 0);
+        } else {
+            mg_http_reply(c, 502, "Content-Type: application/json\r\n",
+                         "{\"status\":\"error\",\"device\":%m,\"message\":%m}",
+                         MG_ESC(dev->id), MG_ESC(modbus_strerror(err)));
+        }
+    }
+    free(rd);
+}
+
+/**
+ * @brief Reads registers over the device's pipelined connection.
+ */
+static void submit_pipe_read(struct mg_connection *c, plc_device_t *dev, int start, int count, bool binary) {
+    pipe_read_t *rd = malloc(sizeof(*rd));
+
+    if (rd == NULL) {
+        reply_busy(c, dev);
+        return;
+    }
+    rd->conn_id = c->id;
+    rd->dev = dev->index;
+    rd->start = start;
+    rd->binary = binary;
+    if (mbp_read_registers(dev->pipe, start, count, pipe_read_done, rd) != 0) {
+        if (errno == EAGAIN) {
+            reply_busy(c, dev);
+        } else {
+            reply_offline(c, dev);
+        }
+        free(rd);
+    }
+}
+
+/**
+ * @brief GET /api/registers?start=&count=[&format=bin][&max_age_ms=]
+ *
+ * Served from the poller mirror when the range lies inside it and the mirror
+ * is at most max_age_ms old (CACHE_MAX_AGE_MS by default, 0 forces a PLC
+ * read). Otherwise the read goes out on the pipelined connection if the
+ * device has one, or is queued and merged with other pending reads into one
+ * FC03 request.
+ */
+static void handle_read_registers(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    long start, count, max_age = CACHE_MAX_AGE_MS;
+    char format[8] = "";
+    struct mg_str *accept = mg_http_get_header(hm, "Accept");
+
+    if (!get_int_var(&hm->query, "start", 0, 65535, &start) ||
+        !get_int_var(&hm->query, "count", 1, MODBUS_MAX_READ_REGISTERS, &count) ||
+        start + count > 65536) {
+        reply_bad_request(c, "Expected start (0-65535) and count (1-125)");
+        return;
+    }
+    if (mg_http_var(hm->query, mg_str("max_age_ms")).len > 0 &&
+        !get_int_var(&hm->query, "max_age_ms", 0, 3600000, &max_age)) {
+        reply_bad_request(c, "Invalid max_age_ms");
+        return;
+    }
+    mg_http_get_var(&hm->query, "format", format, sizeof(format));
+    bool binary = strcmp(format, "bin") == 0 ||
+                  (accept != NULL && mg_match(*accept, mg_str("*application/octet-stream*"), NULL));
+
+    uint16_t regs[MODBUS_MAX_READ_REGISTERS];
+    pthread_mutex_lock(&dev->state_lock);
+    uint64_t age = mg_millis() - dev->regs_ms;
+    bool hit = dev->regs_ms != 0 && age <= (uint64_t)max_age &&
+               start >= POLL_START && start + count <= POLL_START + POLL_COUNT;
+    if (hit) memcpy(regs, &dev->regs[start - POLL_START], (size_t)count * sizeof(uint16_t));
+    pthread_mutex_unlock(&dev->state_lock);
+
+    if (hit) {
+        reply_registers(c, dev, (int)start, (int)count, regs, binary, "cache", age);
+    } else if (dev->pipe != NULL) {
+        submit_pipe_read(c, dev, (int)start, (int)count, binary);
+    } else {
+        mb_job_t job = { .op = JOB_READ_REGS, .start = (uint16_t)start,
+                         .count = (uint16_t)count, .binary = binary };
+        submit_job(c, dev, &job);
+    }
+}
+
+/**
+ * @brief POST /api/registers: writes a block of registers with one FC16.
+ *
+ * The body is either JSON, {"start":10,"values":[1,2,3]}, or raw big-endian
+ * words sent as application/octet-stream with the start in the query string.
+ */
+static void handle_write_registers(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    struct mg_str *type = mg_http_get_header(hm, "Content-Type");
+    mb_job_t job = { .op = JOB_WRITE_REGS };
+    long start;
+
+    if (type != NULL && mg_match(*type, mg_str("application/octet-stream*"), NULL)) {
+        if (!get_int_var(&hm->query, "start", 0, 65535, &start)) {
+            reply_bad_request(c, "Expected start (0-65535) in the query string");
+            return;
+        }
+        if (hm->body.len == 0 || hm->body.len % 2 != 0 ||
+            hm->body.len > MODBUS_MAX_WRITE_REGISTERS * 2) {
+            reply_bad_request(c, "Body must hold 1-123 big-endian 16-bit words");
+            return;
+        }
+        const uint8_t *p = (const uint8_t *)hm->body.buf;
+        for (size_t i = 0; i < hm->body.len / 2; i++) {
+            job.values[job.count++] = (uint16_t)(p[2 * i] << 8 | p[2 * i + 1]);
+        }
+    } else {
+        struct mg_str values = mg_json_get_tok(hm->body, "$.values");
+        struct mg_str key, val;
+        size_t ofs = 0;
+
+        start = mg_json_get_long(hm->body, "$.start", -1);
+        if (start < 0 || start > 65535 || values.len == 0 || values.buf[0] != '[') {
+            reply_bad_request(c, "Expected {\"start\":N,\"values\":[...]}");
+            return;
+        }
+        while ((ofs = mg_json_next(values, ofs, &key, &val)) > 0) {
+            long v = mg_json_get_long(val, "$", -1);
+            if (job.count >= MODBUS_MAX_WRITE_REGISTERS || v < 0 || v > 65535) {
+                reply_bad_request(c, "Expected 1-123 values in 0-65535");
+                return;
+            }
+            job.values[job.count++] = (uint16_t)v;
+        }
+        if (job.count == 0) {
+            reply_bad_request(c, "Expected 1-123 values in 0-65535");
+            return;
+        }
+    }
+    if (start + job.count > 65536) {
+        reply_bad_request(c, "Register range exceeds 65535");
+        return;
+    }
+    job.start = (uint16_t)start;
+    submit_job(c, dev, &job);
+}
+
+/**
+ * @brief Prints history points as [t_ms,avg,min,max] arrays (mg_print_func_t).
+ */
+static size_t print_history(void (*out)(char, void *), void *ptr, va_list *ap) {
+    const hist_point_t *pts = va_arg(*ap, const hist_point_t *);
+    size_t count = va_arg(*ap, size_t);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        n += mg_xprintf(out, ptr, "%s[%llu,%.2f,%u,%u]", i == 0 ? "" : ",",
+                        (unsigned long long)pts[i].t * 1000ULL, pts[i].avg,
+                        (unsigned)pts[i].min, (unsigned)pts[i].max);
+    }
+    return n;
+}
+
+/**
+ * @brief GET /api/history?reg=&from=&to=&points=[&mode=lttb|minmax]
+ *
+ * 'from' and 'to' are Unix seconds (default: the last hour). Ranges that
+ * start within the last hour use the per-second rollups, older ones the
+ * per-minute rollups. The series is then downsampled to at most 'points'
+ * entries (default 300), so the reply size does not depend on the range.
+ */
+static void handle_history(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    long reg = POLL_START, points = 300, from, to;
+    long now = (long)time(NULL);
+    char mode[8];
+
+    if (mg_http_var(hm->query, mg_str("reg")).len > 0 &&
+        !get_int_var(&hm->query, "reg", POLL_START, POLL_START + HISTORY_REGISTERS - 1, &reg)) {
+        reply_bad_request(c, "reg has no history");
+        return;
+    }
+    to = now;
+    if (mg_http_var(hm->query, mg_str("to")).len > 0 &&
+        !get_int_var(&hm->query, "to", 1, LONG_MAX, &to)) {
+        reply_bad_request(c, "to must be a Unix time in seconds");
+        return;
+    }
+    if (to > now) to = now;     // Nothing recorded yet, and client clocks may run ahead
+    from = to - 3600;
+    if (mg_http_var(hm->query, mg_str("from")).len > 0 &&
+        !get_int_var(&hm->query, "from", 1, to, &from)) {
+        reply_bad_request(c, "from must be a Unix time in seconds, not after to");
+        return;
+    }
+    if (mg_http_var(hm->query, mg_str("points")).len > 0 &&
+        !get_int_var(&hm->query, "points", 2, HISTORY_MAX_POINTS, &points)) {
+        reply_bad_request(c, "points must be 2-2000");
+        return;
+    }
+    if (mg_http_get_var(&hm->query, "mode", mode, sizeof(mode)) <= 0) snprintf(mode, sizeof(mode), "lttb");
+    bool minmax = strcmp(mode, "minmax") == 0;
+    if (!minmax && strcmp(mode, "lttb") != 0) {
+        reply_bad_request(c, "mode must be lttb or minmax");
+        return;
+    }
+
+    bool fine = from >= now - HISTORY_SECONDS;
+    size_t len = fine ? HISTORY_SECONDS : HISTORY_MINUTES;
+    hist_point_t *series = malloc(len * sizeof(*series));
+    hist_point_t *result = malloc((size_t)points * sizeof(*result));
+    if (series == NULL || result == NULL) {
+        free(series);
+        free(result);
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+                     "{\"status\":\"error\",\"message\":\"Out of memory\"}");
+        return;
+    }
+
+    const reg_history_t *h = &dev->history[reg - POLL_START];
+    pthread_mutex_lock(&dev->hist_lock);
+    size_t n = history_collect(fine ? h->sec : h->min, len, fine ? 1 : 60,
+                               (uint32_t)from, (uint32_t)to, series);
+    pthread_mutex_unlock(&dev->hist_lock);
+
+    size_t k = minmax ? downsample_minmax(series, n, (size_t)points, result)
+                      : downsample_lttb(series, n, (size_t)points, result);
+
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                 "{\"device\":%m,\"reg\":%ld,\"from\":%ld,\"to\":%ld,\"resolution_s\":%d,"
+                 "\"mode\":\"%s\",\"samples\":%lu,\"points\":[%M]}",
+                 MG_ESC(dev->id), reg, from, to, fine ? 1 : 60, minmax ? "minmax" : "lttb",
+                 (unsigned long)n, print_history, result, k);
+    free(series);
+    free(result);
+}
+
+/**
+ * @brief HTTP handler for /api/registers endpoint.
+ */
+static void handle_registers(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    if (mg_strcasecmp(hm->method, mg_str("GET")) == 0) {
+        handle_read_registers(c, hm, dev);
+    } else if (mg_strcasecmp(hm->method, mg_str("POST")) == 0) {
+        handle_write_registers(c, hm, dev);
+    } else {
+        mg_http_reply(c, 405, "Content-Type: application/json\r\nAllow: GET, POST\r\n",
+                     "{\"status\":\"error\",\"message\":\"Method not allowed\"}");
+    }
+}
+
+// A ramp write waiting on the pipelined connection
+typedef struct {
+    int dev;
+    unsigned int gen;       // ramp_gen of the ramp that issued it
+    int64_t issued_ns;
+    uint16_t value;         // Frequency in Hz * 100
+} ramp_write_t;
+
+/**
+ * @brief Completion of a ramp write (mbp_done_t), runs on the event loop.
+ */
+static void ramp_write_done(mbp_client_t *cli, int err, const uint16_t *regs, int count, void *userdata) {
+    ramp_write_t *wr = (ramp_write_t *)userdata;
+    plc_device_t *dev = &devices[wr->dev];
+    (void)cli;
+    (void)regs;
+    (void)count;
+
+    if (err == 0) {
+        cache_store(dev, 0, 1, &wr->value);
+        pthread_mutex_lock(&dev->state_lock);
+        dev->frequency = wr->value;
+        pthread_mutex_unlock(&dev->state_lock);
+    }
+    if (wr->gen == dev->ramp_gen) {
+        ramp_done(&dev->ramp, err == 0, wr->issued_ns, ramp_now_ns());
+        if (!dev->ramp_active) log_ramp_end(dev);
+    }
+    free(wr);
+}
+
+/**
+ * @brief Issues the ramp steps that are due. Called after every mg_mgr_poll().
+ */
+static void service_ramps(void) {
+    for (int d = 0; d < device_count; d++) {
+        plc_device_t *dev = &devices[d];
+        int64_t now = ramp_now_ns();
+        double hz;
+
+        if (!dev->ramp_active) continue;
+        int rc = ramp_next(&dev->ramp, now, &hz, NULL);
+        if (rc == -1) dev->ramp_active = false;
+        if (rc != 1) continue;
+
+        ramp_write_t *wr = malloc(sizeof(*wr));
+        if (wr == NULL) {
+            ramp_done(&dev->ramp, false, now, now);
+            continue;
+        }
+        wr->dev = d;
+        wr->gen = dev->ramp_gen;
+        wr->issued_ns = now;
+        wr->value = (uint16_t)lround(hz * 100);
+        if (mbp_write_register(dev->pipe, 0, wr->value, ramp_write_done, wr) != 0) {
+            ramp_done(&dev->ramp, false, now, now);
+            free(wr);
+        }
+        // The last step is issued: the ramp is over once its write completes
+        if (ramp_due_ns(&dev->ramp) == -1) dev->ramp_active = false;
+    }
+}
+
+/**
+ * @brief mg_mgr_poll() timeout that wakes the loop for the next ramp step.
+ */
+static int poll_timeout_ms(void) {
+    int64_t now = ramp_now_ns();
+    int64_t wait = (int64_t)POLL_MAX_MS * 1000000;
+
+    for (int d = 0; d < device_count; d++) {
+        if (!devices[d].ramp_active) continue;
+        int64_t due = ramp_due_ns(&devices[d].ramp) - now;
+        if (due < wait) wait = due;
+    }
+    // epoll waits in whole milliseconds: round up rather than wake early and spin
+    return wait <= 0 ? 0 : (int)((wait + 999999) / 1000000);
+}
+
+/**
+ * @brief Prints the progress and timing error of a device's ramp (mg_print_func_t).
+ */
+static size_t print_ramp(void (*out)(char, void *), void *ptr, va_list *ap) {
+    const plc_device_t *dev = va_arg(*ap, const plc_device_t *);
+    const ramp_t *r = &dev->ramp;
+    const ramp_stats_t *st = &r->stats;
+    const char *state = r->n_steps == 0 ? "idle" :
+                        (dev->ramp_active || !ramp_finished(r)) ? "running" :
+                        dev->ramp_stopped ? "stopped" : "done";
+    int64_t until = dev->ramp_active ? ramp_now_ns() : r->end_ns;
+
+    return mg_xprintf(out, ptr,
+                      "{\"device\":%m,\"state\":\"%s\",\"profile_s\":%.3f,\"elapsed_s\":%.3f,"
+                      "\"period_ms\":%d,\"steps\":%ld,\"issued\":%lu,\"completed\":%lu,\"missed\":%lu,"
+                      "\"errors\":%lu,\"late_avg_ms\":%.2f,\"late_max_ms\":%.2f,"
+                      "\"write_avg_ms\":%.2f,\"write_max_ms\":%.2f}",
+                      MG_ESC(dev->id), state, r->n_steps ? ramp_duration(&r->profile) : 0.0,
+                      (until - r->start_ns) / 1e9, (int)(r->period_ns / 1000000), r->n_steps,
+                      st->steps, st->completed, st->missed, st->errors,
+                      st->steps ? st->late_sum_ms / st->steps : 0.0, st->late_max_ms,
+                      st->completed ? st->write_sum_ms / st->completed : 0.0, st->write_max_ms);
+}
+
+/**
+ * @brief POST /api/ramp: starts a frequency ramp, replacing a running one.
+ *
+ * 'profile' is a ramp.h profile in Hz (0-60), 'period_ms' the time between
+ * two writes (RAMP_PERIOD_MS by default). The reply is sent right away;
+ * GET /api/ramp follows the ramp.
+ */
+static void handle_start_ramp(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    char spec[512];
+    ramp_profile_t profile;
+    long period = RAMP_PERIOD_MS;
+    double min_hz, max_hz;
+
+    if (dev->pipe == NULL) {
+        mg_http_reply(c, 409, "Content-Type: application/json\r\n",
+                     "{\"status\":\"error\",\"device\":%m,\"message\":\"Ramps need a pipelined connection (depth > 0)\"}",
+                     MG_ESC(dev->id));
+        return;
+    }
+    if (mg_http_get_var(&hm->body, "profile", spec, sizeof(spec)) <= 0 || ramp_parse(&profile, spec) != 0) {
+        reply_bad_request(c, "Expected profile=linear|scurve:FROM:TO:SECONDS or linear|scurve:T=HZ,...");
+        return;
+    }
+    ramp_bounds(&profile, &min_hz, &max_hz);
+    if (min_hz < 0 || max_hz > 60) {
+        reply_bad_request(c, "Invalid frequency range (0-60 Hz)");
+        return;
+    }
+    if (mg_http_var(hm->body, mg_str("period_ms")).len > 0 &&
+        !get_int_var(&hm->body, "period_ms", RAMP_PERIOD_MIN_MS, RAMP_PERIOD_MAX_MS, &period)) {
+        reply_bad_request(c, "Invalid period_ms (5-10000)");
+        return;
+    }
+
+    bool replaced = dev->ramp_active;
+    dev->ramp_gen++;
+    ramp_start(&dev->ramp, &profile, (int)period, ramp_now_ns());
+    dev->ramp_active = true;
+    dev->ramp_stopped = false;
+    printf("[%s] Rampa %s cada %ld ms\n", dev->id, spec, period);
+
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                 "{\"status\":\"ok\",\"device\":%m,\"action\":\"ramp\",\"profile_s\":%.3f,"
+                 "\"period_ms\":%ld,\"steps\":%ld,\"replaced\":%s}",
+                 MG_ESC(dev->id), ramp_duration(&profile), period, dev->ramp.n_steps,
+                 replaced ? "true" : "false");
+}
+
+/**
+ * @brief HTTP handler for /api/ramp endpoint.
+ */
+static void handle_ramp(struct mg_connection *c, struct mg_http_message *hm, plc_device_t *dev) {
+    if (mg_strcasecmp(hm->method, mg_str("POST")) == 0) {
+        handle_start_ramp(c, hm, dev);
+    } else if (mg_strcasecmp(hm->method, mg_str("GET")) == 0) {
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%M", print_ramp, dev);
+    } else if (mg_strcasecmp(hm->method, mg_str("DELETE")) == 0) {
+        stop_ramp(dev);
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%M", print_ramp, dev);
+    } else {
+        mg_http_reply(c, 405, "Content-Type: application/json\r\nAllow: GET, POST, DELETE\r\n",
+                     "{\"status\":\"error\",\"message\":\"Method not allowed\"}");
+    }
+}
+
+/**
+ * @brief Sends the HTTP reply for a completed Modbus job.
+ * @param c Connection that issued the request.
+ * @param data Raw mb_result_t delivered by mg_wakeup().
+ */
+static void handle_job_result(struct mg_connection *c, struct mg_str *data) {
+    pending_reply_t *pending = (pending_reply_t *) c->data;
+    mb_result_t res;
+
+    if (data->len != sizeof(res)) return;
+    if (pending->deadline_ms == 0) return;      // Already answered with 504
+    pending->deadline_ms = 0;
+    memcpy(&res, data->buf, sizeof(res));
+    if (res.dev < 0 || res.dev >= device_count) return;
+    plc_device_t *dev = &devices[res.dev];
+    const char *id = dev->id;
+
+    if (res.rc != 0) {
+        if (res.err == 0) {
+            reply_offline(c, dev);
+        } else {
+            mg_http_reply(c, 502, "Content-Type: application/json\r\n",
+                         "{\"status\":\"error\",\"device\":%m,\"message\":%m}",
+                         MG_ESC(id), MG_ESC(modbus_strerror(res.err)));
+        }
+        return;
+    }
+
+    switch (res.op) {
+        case JOB_RUN_TOGGLE:
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                         "{\"status\":\"ok\",\"device\":%m,\"action\":\"run_toggle\",\"state\":\"%s\",\"latency_us\":%ld}",
+                         MG_ESC(id), res.run ? "RUN" : "STOP", res.latency_us);
+            break;
+        case JOB_DIR_TOGGLE:
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                         "{\"status\":\"ok\",\"device\":%m,\"action\":\"dir_toggle\",\"direction\":\"%s\",\"latency_us\":%ld}",
+                         MG_ESC(id), res.direction ? "REV" : "FWD", res.latency_us);
+            break;
+        case JOB_FREQ_SET:
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                         "{\"status\":\"ok\",\"device\":%m,\"action\":\"freq_set\",\"frequency\":%d,"
+                         "\"requested\":%d,\"coalesced\":%d,\"latency_us\":%ld}",
+                         MG_ESC(id), res.freq, res.requested, res.coalesced, res.latency_us);
+            break;
+        case JOB_READ_REGS:
+            reply_registers(c, dev, res.start, res.count, res.regs, res.binary, "device", 0);
+            break;
+        case JOB_WRITE_REGS:
+            mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                         "{\"status\":\"ok\",\"device\":%m,\"action\":\"write_registers\",\"start\":%u,\"count\":%u,\"latency_us\":%ld}",
+                         MG_ESC(id), (unsigned)res.start, (unsigned)res.count, res.latency_us);
+            break;
+    }
+}
+
+/**
+ * @brief HTTP handler for /api/status endpoint.
+ *
+ * Besides the cached drive state, reports the link health of the device:
+ * "online" (all pooled connections up), "degraded" (some up) or "offline".
+ */
+static void handle_status(struct mg_connection *c, plc_device_t *dev) {
+    int freq, run_state, dir;
+
+    if (get_status(dev, &freq, &run_state, &dir) == 0) {
+        char last_error[sizeof(dev->last_error)];
+
+        pthread_mutex_lock(&dev->job_lock);
+        int up = dev->conns_up;
+        unsigned long reconnects = dev->reconnects;
+        uint64_t retry = retry_in_ms(dev);
+        memcpy(last_error, dev->last_error, sizeof(last_error));
+        pthread_mutex_unlock(&dev->job_lock);
+
+        const char *link = up == dev->pool_size ? "online" : up > 0 ? "degraded" : "offline";
+
+        pthread_mutex_lock(&dev->state_lock);
+        pulse_mode_t pulse = dev->pulse;
+        long last_cmd_us = dev->last_cmd_us;
+        pthread_mutex_unlock(&dev->state_lock);
+
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                     "{\"device\":%m,\"frequency\":%d,\"running\":%s,\"direction\":\"%s\",\"state\":\"%s\","
+                     "\"pulse\":\"%s\",\"last_cmd_us\":%ld,"
+                     "\"link\":{\"state\":\"%s\",\"connections\":%d,\"pool\":%d,\"reconnects\":%lu,"
+                     "\"retry_in_ms\":%llu,\"last_error\":%m},"
+                     "\"replies\":{\"lost\":%lu}}",
+                     MG_ESC(dev->id),
+                     freq,
+                     run_state ? "true" : "false",
+                     dir ? "REV" : "FWD",
+                     run_state ? "RUN" : "STOP",
+                     pulse_name(pulse), last_cmd_us,
+                     link, up, dev->pool_size, reconnects,
+                     (unsigned long long)retry, MG_ESC(last_error),
+                     dev->lost_replies);
+    } else {
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+                     "{\"status\":\"error\",\"message\":\"Failed to read device status\"}");
+    }
+}
+
+/**
+ * @brief Prints one registry entry as a JSON object (mg_print_func_t).
+ */
+static size_t print_device(void (*out)(char, void *), void *ptr, va_list *ap) {
+    const plc_device_t *dev = va_arg(*ap, const plc_device_t *);
+    return mg_xprintf(out, ptr, "{%m:%m,%m:%m,%m:%d,%m:%d,%m:%d}",
+                      MG_ESC("id"), MG_ESC(dev->id),
+                      MG_ESC("ip"), MG_ESC(dev->ip),
+                      MG_ESC("port"), dev->port,
+                      MG_ESC("pool"), dev->pool_size,
+                      MG_ESC("pipeline_depth"), dev->pipeline_depth);
+}
+
+/**
+ * @brief Prints the whole registry as a JSON array (mg_print_func_t).
+ */
+static size_t print_devices(void (*out)(char, void *), void *ptr, va_list *ap) {
+    size_t n = 0;
+    (void)ap;
+    for (int i = 0; i < device_count; i++) {
+        n += mg_xprintf(out, ptr, "%s%M", i == 0 ? "" : ",", print_device, &devices[i]);
+    }
+    return n;
+}
+
+/**
+ * @brief HTTP handler for /api/devices endpoint.
+ */
+static void handle_devices(struct mg_connection *c) {
+    mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                 "{\"devices\":[%M]}", print_devices);
+}
+
+/**
+ * @brief Options for serving the web UI.
+ *
+ * With MG_ENABLE_PACKED_FS (the Makefile default) the files in www/ are
+ * compiled into the binary by pack_www.py, including gzip variants, so pages
+ * are served from memory. The packer stores a content hash where Mongoose
+ * expects the file mtime, which makes every ETag change only when the file
+ * changes; "no-cache" then has browsers revalidate and get a 304 instead of
+ * the page. Without it, files are read from the www directory as before.
+ */
+static const struct mg_http_serve_opts static_opts = {
+#if MG_ENABLE_PACKED_FS
+    .root_dir = "/www",
+    .fs = &mg_fs_packed,
+    .extra_headers = "Cache-Control: no-cache\r\nVary: Accept-Encoding\r\n",
+#else
+    .root_dir = "www",
+#endif
+};
+
+/**
+ * @brief Answers a request with 504 once its worker result is overdue.
+ *
+ * A request still waiting in the queue is withdrawn, so a command reported
+ * as failed cannot switch the drive later; "cancelled" tells the client
+ * whether that was still possible. The connection is closed after the reply,
+ * so a result that still arrives later cannot be taken for the answer to a
+ * newer request.
+ */
+static void check_reply_deadline(struct mg_connection *c) {
+    pending_reply_t *pending = (pending_reply_t *) c->data;
+
+    if (pending->deadline_ms == 0 || mg_millis() < pending->deadline_ms) return;
+    pending->deadline_ms = 0;
+
+    plc_device_t *dev = &devices[pending->dev];
+    bool cancelled = cancel_request(dev, c->id);
+    dev->lost_replies++;
+    mg_http_reply(c, 504, "Content-Type: application/json\r\n",
+                 "{\"status\":\"error\",\"device\":%m,\"message\":\"No Modbus result within %lu ms\","
+                 "\"cancelled\":%s}",
+                 MG_ESC(dev->id), (unsigned long)pending->timeout_ms, cancelled ? "true" : "false");
+    c->is_draining = 1;
+}
+
+/**
+ * @brief Mongoose event handler and HTTP dispatcher.
+ */
+static void fn(struct mg_connection *c, int ev, void *ev_data) {
+    if (ev == MG_EV_WAKEUP) {
+        handle_job_result(c, (struct mg_str *) ev_data);
+    } else if (ev == MG_EV_POLL) {
+        check_reply_deadline(c);
+    } else if (ev == MG_EV_HTTP_MSG) {
+        struct mg_http_message *hm = (struct mg_http_message *) ev_data;
+
+        if (mg_match(hm->uri, mg_str("/api/devices"), NULL)) {
+            handle_devices(c);
+        } else if (mg_match(hm->uri, mg_str("/api/*"), NULL)) {
+            plc_device_t *dev = find_device(hm);
+
+            if (dev == NULL) {
+                mg_http_reply(c, 404, "Content-Type: application/json\r\n",
+                             "{\"status\":\"error\",\"message\":\"Unknown device\"}");
+            } else if (mg_match(hm->uri, mg_str("/api/run"), NULL)) {
+                handle_run(c, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/dir"), NULL)) {
+                handle_dir(c, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/freq"), NULL)) {
+                handle_freq(c, hm, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/status"), NULL)) {
+                handle_status(c, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/registers"), NULL)) {
+                handle_registers(c, hm, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/history"), NULL)) {
+                handle_history(c, hm, dev);
+            } else if (mg_match(hm->uri, mg_str("/api/ramp"), NULL)) {
+                handle_ramp(c, hm, dev);
+            } else {
+                mg_http_reply(c, 404, "Content-Type: application/json\r\n",
+                             "{\"status\":\"error\",\"message\":\"Unknown endpoint\"}");
+            }
+        } else {
+            mg_http_serve_dir(c, hm, &static_opts);
+        }
+    }
+}
+
+/**
+ * @brief Closes and frees every pooled connection of every device.
+ */
+static void disconnect_all(void) {
+    for (int d = 0; d < device_count; d++) {
+        mbp_free(devices[d].pipe);
+        devices[d].pipe = NULL;
+        for (int i = 0; i < devices[d].pool_size; i++) {
+            if (devices[d].pool[i].mb != NULL) {
+                modbus_close(devices[d].pool[i].mb);
+                modbus_free(devices[d].pool[i].mb);
+                devices[d].pool[i].mb = NULL;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Main entry point. Initializes the device registry, Modbus and HTTP server.
+ */
+int main(int argc, char *argv[]) {
+    // Build the device registry from the command line
+    for (int i = 1; i < argc; i++) {
+        if (register_device(argv[i]) != 0) return 1;
+    }
+    if (device_count == 0) {
+        register_device("plc0=" SERVER_IP);
+    }
+
+    mg_mgr_init(&mgr);
+    if (!mg_wakeup_init(&mgr)) {
+        fprintf(stderr, "Failed to initialise mg_wakeup\n");
+        return 1;
+    }
+
+#ifndef DEBUG_WEB
+    // Allocate the Modbus TCP connection pools; workers connect them
+    for (int d = 0; d < device_count; d++) {
+        if (create_device_pool(&devices[d]) != 0) {
+            disconnect_all();
+            return -1;
+        }
+    }
+#else
+    printf("Running in DEBUG mode - no real Modbus communication\n");
+#endif
+
+    // Levantar servidor HTTP en puerto 8000
+    if (mg_http_listen(&mgr, "http://0.0.0.0:8000", fn, NULL) == NULL) {
+        fprintf(stderr, "Error iniciando servidor web\n");
+        disconnect_all();
+        return 1;
+    }
+
+    // Start one worker per pooled connection; they connect and perform the blocking Modbus I/O
+    for (int d = 0; d < device_count; d++) {
+        for (int i = 0; i < devices[d].pool_size; i++) {
+            plc_conn_t *conn = &devices[d].pool[i];
+            if (pthread_create(&conn->thread, NULL, modbus_worker, conn) != 0) {
+                fprintf(stderr, "[%s] Failed to start Modbus worker thread\n", devices[d].id);
+                return 1;
+            }
+            pthread_detach(conn->thread);
+        }
+    }
+
+    printf("Servidor web corriendo en http://localhost:8000\n");
+    printf("Presiona Ctrl+C para salir\n");
+
+    // Event loop
+    for (;;) {
+        mg_mgr_poll(&mgr, poll_timeout_ms());
+        service_ramps();
+    }
+
+    // Cleanup (nunca se alcanza con el loop infinito, pero está para completitud)
+    disconnect_all();
+    mg_mgr_free(&mgr);
+    return 0;
+}
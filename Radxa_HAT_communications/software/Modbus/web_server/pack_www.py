@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+Empaqueta el directorio www/ en un archivo C para el packed FS de Mongoose.
+
+Genera las funciones mg_unpack() y mg_unlist() que Mongoose usa cuando se
+compila con MG_ENABLE_PACKED_FS=1, de modo que el servidor sirve la interfaz
+web desde memoria, sin leer el disco.
+
+- Cada archivo se guarda como "/www/<ruta>". Si la versión gzip es más
+  pequeña se añade también "/www/<ruta>.gz"; mg_http_serve_dir() la envía
+  con "Content-Encoding: gzip" a los navegadores que la aceptan.
+- Mongoose calcula el ETag como "<mtime>.<tamaño>". En lugar de la fecha del
+  archivo se guarda un hash del contenido en el campo mtime, así el ETag
+  cambia sólo cuando cambia el contenido y es el mismo entre compilaciones.
+
+Uso: python3 pack_www.py www > build/packed_fs.c
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+
+def content_tag(data):
+    """Hash de 31 bits del contenido, usado como mtime (y por tanto ETag)."""
+    return int.from_bytes(hashlib.sha256(data).digest()[:4], "big") & 0x7FFFFFFF
+
+
+def collect(root):
+    """Devuelve [(nombre_empaquetado, datos)] ordenado, con variantes .gz."""
+    entries = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in sorted(filenames):
+            if name.endswith(".gz"):
+                continue
+            path = os.path.join(dirpath, name)
+            rel = os.path.relpath(path, root).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                data = f.read()
+            packed = "/www/" + rel
+            entries.append((packed, data))
+            # mtime=0 para que la salida sea reproducible
+            gz = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(gz) < len(data):
+                entries.append((packed + ".gz", gz))
+    return entries
+
+
+def emit(entries, out):
+    out.write("// Generated by pack_www.py - do not edit\n")
+    out.write("#include <stddef.h>\n#include <string.h>\n#include <time.h>\n\n")
+    for i, (name, data) in enumerate(entries):
+        out.write("// %s (%d bytes)\n" % (name, len(data)))
+        out.write("static const unsigned char v%d[] = {\n" % i)
+        for off in range(0, len(data), 16):
+            chunk = data[off:off + 16]
+            out.write("  " + ",".join("%d" % b for b in chunk) + ",\n")
+        out.write("  0 // trailing NUL\n};\n\n")
+
+    out.write("static const struct packed_file {\n"
+              "  const char *name;\n"
+              "  const unsigned char *data;\n"
+              "  size_t size;\n"
+              "  time_t mtime;\n"
+              "} packed_files[] = {\n")
+    for i, (name, data) in enumerate(entries):
+        out.write("  {\"%s\", v%d, sizeof(v%d) - 1, %d},\n"
+                  % (name, i, i, content_tag(data)))
+    out.write("  {NULL, NULL, 0, 0}\n};\n\n")
+
+    out.write("const char *mg_unlist(size_t no);\n"
+              "const char *mg_unlist(size_t no) {\n"
+              "  return packed_files[no].name;\n"
+              "}\n\n"
+              "const char *mg_unpack(const char *name, size_t *size, time_t *mtime);\n"
+              "const char *mg_unpack(const char *name, size_t *size, time_t *mtime) {\n"
+              "  const struct packed_file *p;\n"
+              "  for (p = packed_files; p->name != NULL; p++) {\n"
+              "    if (strcmp(p->name, name) != 0) continue;\n"
+              "    if (size != NULL) *size = p->size;\n"
+              "    if (mtime != NULL) *mtime = p->mtime;\n"
+              "    return (const char *) p->data;\n"
+              "  }\n"
+              "  return NULL;\n"
+              "}\n")
+
+
+def main():
+    root = sys.argv[1] if len(sys.argv) > 1 else "www"
+    if not os.path.isdir(root):
+        sys.exit("pack_www.py: directorio '%s' no encontrado" % root)
+    emit(collect(root), sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
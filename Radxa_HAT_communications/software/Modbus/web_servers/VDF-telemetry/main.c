@@ -40,7 +40,7 @@ void handle_shutdown(int signum);
 // Global flag to control the main loop
 volatile sig_atomic_t keep_running = 1;
 
-int main() {
+int main(int argc, char *argv[]) {
     modbus_config_t modbus_conf;
     vdf_t MS_300_controller;
 
@@ -49,7 +49,7 @@ int main() {
     signal(SIGTERM, handle_shutdown);
 
     // Initialize Modbus connection
-    modbus_conf.device = "/dev/ttyS4";
+    modbus_conf.device = (argc > 1) ? argv[1] : "/dev/ttyS4";
     modbus_conf.baud = 38400;
     modbus_conf.parity = 'N';
     modbus_conf.data_bit = 8;